@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+#include "xrmg.hpp"
+
+#include "Matrix.hpp"
+#include "VulkanImageResource.hpp"
+
+#include <unordered_map>
+
+namespace xrmg {
+class Renderer;
+
+// Composes the images of all physical devices into the swapchain image on the main physical device. Each image is
+// resampled with a projective transform read from a host visible buffer, so it can still be updated after the command
+// buffer has been recorded.
+class Compositor {
+public:
+  struct Layer {
+    uint32_t sourceIndex;
+    // Frame whose source image is read; older than the composed frame if its device skipped the latter.
+    uint64_t sourceFrameIndex;
+    // Part of the source image the layer is read from, relative to its size.
+    Rect2Df sourceRect;
+    vk::Rect2D destRect;
+  };
+
+  // Transform from the [0, 1] texture coordinates of an image seen from p_displayView to the ones of the same image
+  // rendered from p_renderView. Only the rotational part of the pose difference is taken into account.
+  static Mat4x4f createReprojection(const Mat4x4f &p_projection, const Rect2Df &p_relativeViewport,
+                                    const Mat4x4f &p_renderView, const Mat4x4f &p_displayView);
+
+  Compositor(const Renderer &p_renderer, const std::vector<vk::Extent2D> &p_sourceExtents, uint32_t p_maxLayerCount);
+
+  VulkanImageResource &getSourceResource(uint64_t p_frameIndex, uint32_t p_sourceIndex);
+  void setLayerTransform(uint64_t p_frameIndex, uint32_t p_layerIndex, const Mat4x4f &p_destToSource);
+  void compose(vk::CommandBuffer p_cmdBuffer, uint64_t p_frameIndex, vk::Image p_dest, const vk::Rect2D &p_renderArea,
+               const std::vector<Layer> &p_layers);
+
+private:
+  const Renderer &m_renderer;
+  uint32_t m_sourceCount;
+  uint32_t m_maxLayerCount;
+  std::vector<VulkanImageResource> m_sourceResources;
+  vk::UniqueSampler m_sampler;
+  vk::UniqueDescriptorSetLayout m_descriptorSetLayout;
+  vk::UniquePipelineLayout m_pipelineLayout;
+  vk::UniquePipeline m_pipeline;
+  vk::UniqueDeviceMemory m_transformMemory;
+  vk::UniqueBuffer m_transformBuffer;
+  char *m_mappedTransforms = nullptr;
+  vk::DeviceSize m_transformStride = 0;
+  vk::UniqueDescriptorPool m_descriptorPool;
+  std::vector<vk::DescriptorSet> m_descriptorSets;
+  std::unordered_map<VkImage, vk::UniqueImageView> m_destImageViews;
+
+  uint32_t getSourceSlot(uint64_t p_frameIndex, uint32_t p_sourceIndex) const;
+  uint32_t getTransformSlot(uint64_t p_frameIndex, uint32_t p_layerIndex) const;
+  vk::ImageView getDestImageView(vk::Image p_dest);
+};
+} // namespace xrmg
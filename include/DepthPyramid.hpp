@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+#include "xrmg.hpp"
+
+#include "DeviceMemoryAllocator.hpp"
+
+#include <unordered_map>
+
+namespace xrmg {
+class Renderer;
+
+// Mip chain of the farthest depth of a render target, used for occlusion culling. Level 0 covers 2 x 2 pixels per
+// texel and each further level halves the extent, rounded up. Each physical device reduces its own depth into its own
+// instance of the image, which stays in the general layout.
+class DepthPyramid {
+public:
+  DepthPyramid(const Renderer &p_renderer);
+
+  const vk::Extent2D &getDepthExtent() const { return m_depthExtent; }
+  uint32_t getLevelCount() const { return static_cast<uint32_t>(m_levelExtents.size()); }
+  vk::ImageView getImageView() const { return m_imageView.get(); }
+  // The depth image is expected in the depth attachment layout with its writes still pending and is returned to it.
+  // The pyramid is ready to be read by compute shaders afterwards.
+  void build(vk::CommandBuffer p_cmdBuffer, vk::Image p_depthImage, vk::ImageView p_depthView);
+
+private:
+  const Renderer &m_renderer;
+  vk::Extent2D m_depthExtent;
+  std::vector<vk::Extent2D> m_levelExtents;
+  vk::UniqueImage m_image;
+  DeviceMemoryAllocator::Allocation m_memory;
+  vk::UniqueImageView m_imageView;
+  std::vector<vk::UniqueImageView> m_levelViews;
+  vk::UniqueDescriptorSetLayout m_descriptorSetLayout;
+  vk::UniquePipelineLayout m_pipelineLayout;
+  vk::UniquePipeline m_pipeline;
+  vk::UniqueDescriptorPool m_descriptorPool;
+  // Level l is reduced from level l - 1 with set l; set 0 is created per depth view on first use.
+  std::vector<vk::DescriptorSet> m_levelDescriptorSets;
+  std::unordered_map<VkImageView, vk::DescriptorSet> m_depthDescriptorSets;
+
+  vk::DescriptorSet getDepthDescriptorSet(vk::ImageView p_depthView);
+};
+} // namespace xrmg
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+#include "xrmg.hpp"
+
+#include <map>
+
+namespace xrmg {
+class Renderer;
+
+// Sub-allocates buffers and images from blocks of device memory, one set of blocks per memory type, device mask, and
+// kind of resource; buffers and images never share a block, so their offsets needn't respect the buffer image
+// granularity. Resources the driver prefers a dedicated allocation for, or that would fill most of a block, get their
+// own memory.
+class DeviceMemoryAllocator {
+  struct Block;
+
+public:
+  static constexpr vk::DeviceSize BLOCK_SIZE = 64 << 20;
+
+  // Memory bound to a single resource, which is returned to its block when destroyed.
+  class Allocation {
+  public:
+    Allocation() = default;
+    Allocation(Allocation &&p_other) noexcept { *this = std::move(p_other); }
+    Allocation &operator=(Allocation &&p_other) noexcept;
+    ~Allocation() { this->release(); }
+
+    vk::DeviceMemory getMemory() const { return m_memory; }
+    vk::DeviceSize getOffset() const { return m_offset; }
+
+  private:
+    friend class DeviceMemoryAllocator;
+
+    DeviceMemoryAllocator *m_allocator = nullptr;
+    Block *m_block = nullptr;
+    vk::DeviceMemory m_memory;
+    vk::UniqueDeviceMemory m_dedicatedMemory;
+    vk::DeviceSize m_offset = 0;
+    vk::DeviceSize m_size = 0;
+
+    void release();
+  };
+
+  DeviceMemoryAllocator(const Renderer &p_renderer);
+
+  // Allocates memory of the given type for the resource on the physical devices of the mask and binds it.
+  Allocation allocateBufferMemory(vk::Buffer p_buffer, uint32_t p_memTypeIndex, uint32_t p_deviceMask);
+  Allocation allocateImageMemory(vk::Image p_image, uint32_t p_memTypeIndex, uint32_t p_deviceMask);
+  // Live and peak size of the allocations, the memory objects holding them, and the fragmentation of the blocks' free
+  // memory, i.e. the part of it outside of the largest free range.
+  void logStatistics() const;
+
+private:
+  // Memory type index, device mask, and whether the block holds images.
+  typedef std::tuple<uint32_t, uint32_t, bool> PoolKey;
+
+  struct Block {
+    PoolKey key;
+    vk::UniqueDeviceMemory memory;
+    // Free ranges by offset, never adjacent to each other.
+    std::map<vk::DeviceSize, vk::DeviceSize> freeRanges;
+  };
+
+  const Renderer &m_renderer;
+  std::map<PoolKey, std::vector<std::unique_ptr<Block>>> m_pools;
+  vk::DeviceSize m_liveSize = 0;
+  vk::DeviceSize m_peakLiveSize = 0;
+  vk::DeviceSize m_memoryObjectSize = 0;
+  uint32_t m_memoryObjectCount = 0;
+  uint32_t m_allocationCount = 0;
+
+  Allocation allocate(const vk::MemoryRequirements &p_memReqs, bool p_dedicated, const PoolKey &p_key,
+                      vk::Buffer p_buffer, vk::Image p_image);
+  vk::UniqueDeviceMemory allocateMemoryObject(vk::DeviceSize p_size, const PoolKey &p_key, vk::Buffer p_buffer,
+                                              vk::Image p_image);
+  void free(Allocation &p_allocation);
+};
+} // namespace xrmg
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+#include "xrmg.hpp"
+
+#include <deque>
+
+namespace xrmg {
+class Renderer;
+
+// Linear ring of host visible memory for data uploaded anew every frame. The allocations of a frame are reclaimed once
+// it has finished on all physical devices. When the frames in flight need more than its capacity, the ring continues in
+// a buffer of twice the size, so it settles at the peak usage; the replaced buffer is kept until the frames using it
+// have finished.
+class FrameUploadRing {
+public:
+  struct Allocation {
+    vk::Buffer buffer;
+    vk::DeviceSize offset;
+    char *mapped;
+  };
+
+  static constexpr vk::DeviceSize MIN_CAPACITY = 1 << 20;
+
+  FrameUploadRing(const Renderer &p_renderer, uint32_t p_memTypeIndex, vk::BufferUsageFlags p_usage);
+
+  vk::DeviceSize getCapacity() const { return m_current.capacity; }
+  Allocation allocate(uint64_t p_frameIndex, vk::DeviceSize p_size, vk::DeviceSize p_alignment);
+  void release(uint64_t p_finishedFrameIndex);
+
+private:
+  struct RingBuffer {
+    vk::DeviceSize capacity = 0;
+    vk::UniqueDeviceMemory memory;
+    vk::UniqueBuffer buffer;
+    char *mapped = nullptr;
+  };
+
+  const Renderer &m_renderer;
+  uint32_t m_memTypeIndex;
+  vk::BufferUsageFlags m_usage;
+  RingBuffer m_current;
+  // The frames in flight own the ring from the tail up to the head, possibly wrapping around; along with the end of
+  // each frame's allocations. The head never catches up with the tail, so they only coincide with an empty ring.
+  vk::DeviceSize m_head = 0;
+  vk::DeviceSize m_tail = 0;
+  std::deque<std::pair<uint64_t, vk::DeviceSize>> m_frameEnds;
+  // Replaced buffers along with the last frame that allocated from them.
+  std::vector<std::pair<uint64_t, RingBuffer>> m_retiredBuffers;
+
+  RingBuffer createRingBuffer(vk::DeviceSize p_capacity) const;
+  std::optional<vk::DeviceSize> findSpace(vk::DeviceSize p_size, vk::DeviceSize p_alignment) const;
+};
+} // namespace xrmg
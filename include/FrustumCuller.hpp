@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+#include "xrmg.hpp"
+
+#include "Matrix.hpp"
+
+#include <array>
+
+namespace xrmg {
+// Bounding spheres in structure of arrays layout, so they can be tested against the planes of a view frustum four at a
+// time.
+class FrustumCuller {
+public:
+  typedef std::array<Vec4f, 6> Planes;
+
+  struct Frustum {
+    // Normalized and facing inwards, in the order left, right, top, bottom, near, far.
+    Planes planes;
+    std::array<Vec3f, 8> corners;
+  };
+
+  // World space frustum of the part of the normalized device coordinates given by p_clipBounds (min x, min y, max x,
+  // max y).
+  static Frustum createFrustum(const Mat4x4f &p_viewProjection, const Vec4f &p_clipBounds);
+  // Conservative frustum containing all of p_frusta. For each side, the plane of the frustum that has to be moved the
+  // least to contain all corners is used, so the union of two eyes that only differ in position is exact.
+  static Planes createUnion(const std::vector<Frustum> &p_frusta);
+
+  void clear();
+  void pushSphere(const Vec3f &p_center, float p_radius);
+  uint32_t getSphereCount() const { return m_sphereCount; }
+  // Appends the indices of all spheres intersecting the frustum to p_visibleIndices in ascending order.
+  void cull(const Planes &p_planes, std::vector<uint32_t> &p_visibleIndices) const;
+
+private:
+  // Padded to a multiple of four with spheres of negative infinite radius, which are never visible.
+  std::vector<float> m_centerX;
+  std::vector<float> m_centerY;
+  std::vector<float> m_centerZ;
+  std::vector<float> m_radius;
+  uint32_t m_sphereCount = 0;
+};
+} // namespace xrmg
@@ -22,13 +22,16 @@
 #include "Matrix.hpp"
 
 namespace xrmg {
+// Tightly packed into 60 bytes, since it is uploaded and fetched per instance every frame. The vertex shader derives
+// the normal transform from the affine model to world transform.
 struct Instance {
-  Mat4x4f modelToWorld = Mat4x4f::IDENTITY;
-  Mat4x4f modelToWorldIT = Mat4x4f::IDENTITY;
+  // The first three rows of the model to world transform; the last one is always (0, 0, 0, 1).
+  Vec4f modelToWorld[3] = {{1.0f, 0.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 1.0f, 0.0f}};
   uint32_t colorHint = 0;
   float relativeExtrusion = 0.0f;
   float absoluteExtrusion = 0.0f;
 
+  Mat4x4f getTransform() const;
   void setTransform(const Mat4x4f &p_modelToWorld);
 };
 } // namespace xrmg
\ No newline at end of file
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+#include "xrmg.hpp"
+
+#include "DepthPyramid.hpp"
+#include "TriangleMesh.hpp"
+
+namespace xrmg {
+class Renderer;
+
+// Tests the instances of each triangle mesh against the part of the view frustum covered by a physical device and
+// compacts the visible ones into a buffer of their own, along with an indirect draw command. Triangle meshes sharing an
+// instance arena share that buffer as well, each compacting into the range of its instances. Each physical device
+// writes its own instance of these buffers, so its vertex work only covers what it actually sees.
+//
+// With occlusion culling, the early phase also tests the instances against the depth pyramid of an earlier frame. The
+// ones it finds occluded become candidates for the late phase, which tests them against the pyramid of the current
+// frame's early depth and appends the visible ones behind the early ones with a draw command of their own.
+class InstanceCuller {
+public:
+  static constexpr uint32_t MAX_TRIANGLE_MESH_COUNT = 64;
+  // Byte offset of the late draw command in the draw commands of a triangle mesh.
+  static constexpr vk::DeviceSize LATE_DRAW_COMMAND_OFFSET = 20;
+
+  enum class Phase { FRUSTUM, EARLY, LATE };
+
+  // The camera buffer is bound with a dynamic offset, like in the scene's pipeline.
+  InstanceCuller(const Renderer &p_renderer, vk::Buffer p_cameraBuffer, vk::DeviceSize p_cameraSize);
+
+  struct Batch {
+    uint32_t triMeshIndex;
+    const TriangleMesh *triMesh;
+    uint32_t arenaIndex;
+    // Range of the triangle mesh's instances in the instance buffer of its arena.
+    uint32_t firstInstance;
+    uint32_t instanceCount;
+  };
+
+  // Instance arenas must be added in the order of their indices in the scene.
+  void addInstanceArena();
+  // Must follow each resize of the arena's instance buffer, at most once per frame and before the frame is recorded.
+  // The replaced culling results are kept until that frame is finished.
+  void resizeInstanceArena(uint32_t p_arenaIndex, vk::Buffer p_instanceBuffer, uint32_t p_capacity);
+  // The frame must be finished on all physical devices.
+  void releaseRetiredArenas(uint64_t p_finishedFrameIndex);
+  // Must be recorded after the instances have been uploaded and outside of rendering. The results are visible to the
+  // indirect draws and vertex input following it. The early and late phases test against the depth pyramid rendered
+  // with the camera at p_occlusionCameraOffset; the late phase must follow an early one with the same batches.
+  void cull(vk::CommandBuffer p_cmdBuffer, Phase p_phase, uint32_t p_cameraOffset, uint32_t p_occlusionCameraOffset,
+            const std::vector<Batch> &p_batches) const;
+  DepthPyramid &getDepthPyramid() { return *m_depthPyramid; }
+  vk::Buffer getVisibleInstanceBuffer(uint32_t p_arenaIndex) const {
+    return m_culledArenas[p_arenaIndex].visibleInstanceBuffer.get();
+  }
+  // The draw commands of all triangle meshes share a buffer.
+  vk::Buffer getDrawCommandBuffer() const { return m_drawCommandBuffer.get(); }
+  vk::DeviceSize getDrawCommandOffset(uint32_t p_triMeshIndex) const;
+  // Copies the draw commands of the batches to the host once all phases of the frame have been culled.
+  void writeStatistics(vk::CommandBuffer p_cmdBuffer, uint64_t p_frameIndex, uint32_t p_physicalDeviceIndex,
+                       const std::vector<Batch> &p_batches);
+  // Emits the culled instance counts of each physical device as trace events; the frame must be finished.
+  void logStatistics(uint64_t p_frameIndex) const;
+
+private:
+  struct CulledArena {
+    vk::UniqueBuffer visibleInstanceBuffer;
+    vk::UniqueBuffer candidateBuffer;
+    vk::UniqueDeviceMemory memory;
+    vk::UniqueDescriptorSet descriptorSet;
+  };
+
+  const Renderer &m_renderer;
+  vk::Buffer m_cameraBuffer;
+  vk::DeviceSize m_cameraSize;
+  vk::UniqueDescriptorSetLayout m_descriptorSetLayout;
+  vk::UniquePipelineLayout m_pipelineLayout;
+  vk::UniquePipeline m_pipeline;
+  vk::UniqueDescriptorPool m_descriptorPool;
+  vk::UniqueDeviceMemory m_drawCommandMemory;
+  vk::UniqueBuffer m_drawCommandBuffer;
+  std::vector<CulledArena> m_culledArenas;
+  // Culling results replaced by a resize, along with the frame they were replaced before.
+  std::vector<std::pair<uint64_t, CulledArena>> m_retiredArenas;
+  std::unique_ptr<DepthPyramid> m_depthPyramid;
+  vk::UniqueDeviceMemory m_statisticsMemory;
+  vk::UniqueBuffer m_statisticsBuffer;
+  const char *m_mappedStatistics = nullptr;
+  // Frame along with the triangle mesh index and instance count of each batch whose draw commands have been copied to
+  // a frame slot and physical device.
+  std::vector<std::pair<uint64_t, std::vector<std::pair<uint32_t, uint32_t>>>> m_statisticsBatches;
+
+  vk::DeviceSize getStatisticsOffset(uint64_t p_frameIndex, uint32_t p_physicalDeviceIndex) const;
+};
+} // namespace xrmg
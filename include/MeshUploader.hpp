@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+#include "xrmg.hpp"
+
+#include <deque>
+
+namespace xrmg {
+class Renderer;
+
+// Streams data from host memory into buffers of all physical devices on the transfer queue, through a persistent
+// staging ring. Each copy is its own submission signaling the next value of a timeline semaphore, so uploads finish in
+// the order they were requested. Only waits for earlier uploads when the ring is full.
+class MeshUploader {
+public:
+  static constexpr vk::DeviceSize STAGING_SIZE = 32 << 20;
+  // Larger uploads are split into copies of this size, so the ring never has to hold all of them at once.
+  static constexpr vk::DeviceSize MAX_COPY_SIZE = STAGING_SIZE / 4;
+
+  MeshUploader(const Renderer &p_renderer, uint32_t p_queueFamilyIndex, vk::Queue p_queue);
+  ~MeshUploader();
+
+  // Returns the semaphore value signaled once the buffer holds the data on all physical devices.
+  uint64_t upload(vk::Buffer p_buffer, const void *p_data, vk::DeviceSize p_size);
+  // Polls the semaphore and releases the staging memory of the finished uploads. The finished value only changes here,
+  // so all checks within a frame agree with the value its submissions wait for.
+  void update();
+  bool isFinished(uint64_t p_value) const { return p_value <= m_finishedValue; }
+  vk::Semaphore getSemaphore() const { return m_semaphore.get(); }
+  uint64_t getFinishedValue() const { return m_finishedValue; }
+
+private:
+  // Staging memory from offset to end, read by the copy of the submission signaling the value.
+  struct PendingCopy {
+    uint64_t value;
+    vk::DeviceSize offset;
+    vk::DeviceSize end;
+    vk::UniqueCommandBuffer cmdBuffer;
+  };
+
+  const Renderer &m_renderer;
+  vk::Queue m_queue;
+  vk::UniqueSemaphore m_semaphore;
+  uint64_t m_submittedValue = 0;
+  uint64_t m_finishedValue = 0;
+  vk::UniqueDeviceMemory m_stagingMemory;
+  vk::UniqueBuffer m_stagingBuffer;
+  char *m_mappedStaging = nullptr;
+  vk::DeviceSize m_stagingHead = 0;
+  vk::UniqueCommandPool m_cmdPool;
+  std::deque<PendingCopy> m_pendingCopies;
+
+  vk::DeviceSize allocateStaging(vk::DeviceSize p_size);
+  void releaseFinishedCopies(uint64_t p_finishedValue);
+};
+} // namespace xrmg
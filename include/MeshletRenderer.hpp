@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+#include "xrmg.hpp"
+
+#include "TriangleMesh.hpp"
+
+namespace xrmg {
+class Renderer;
+
+// Draws triangle meshes as meshlets with task and mesh shaders instead of the vertex pipeline. Each task shader
+// workgroup tests a range of meshlets of one instance against the part of the view frustum covered by the physical
+// device and against their normal cones, so meshlets outside of the view or facing away never reach the rasterizer.
+//
+// The instances are bound per arena and the meshlets per triangle mesh, in descriptor sets following the camera's.
+class MeshletRenderer {
+public:
+  static constexpr uint32_t MAX_TRIANGLE_MESH_COUNT = 64;
+  // Index of the first descriptor set of the renderer in the pipeline layout; set 0 holds the camera.
+  static constexpr uint32_t FIRST_DESCRIPTOR_SET = 1;
+
+  MeshletRenderer(const Renderer &p_renderer);
+
+  std::vector<vk::DescriptorSetLayout> getDescriptorSetLayouts() const;
+  vk::PushConstantRange getPushConstantRange() const;
+  // Instance arenas and triangle meshes must be added in the order of their indices in the scene.
+  void addInstanceArena();
+  void addTriangleMesh(const TriangleMesh &p_triMesh);
+  // Must follow each resize of the arena's instance buffer, at most once per frame and before the frame is recorded.
+  // The replaced descriptor set is kept until that frame is finished.
+  void resizeInstanceArena(uint32_t p_arenaIndex, vk::Buffer p_instanceBuffer, uint32_t p_capacity);
+  // The frame must be finished on all physical devices.
+  void releaseRetiredArenas(uint64_t p_finishedFrameIndex);
+  // Must be recorded within rendering, with the mesh shading pipeline and the camera bound.
+  void draw(vk::CommandBuffer p_cmdBuffer, vk::PipelineLayout p_pipelineLayout, uint32_t p_triMeshIndex,
+            const TriangleMesh &p_triMesh, uint32_t p_arenaIndex, uint32_t p_firstInstance,
+            uint32_t p_instanceCount) const;
+
+private:
+  const Renderer &m_renderer;
+  vk::UniqueDescriptorSetLayout m_arenaDescriptorSetLayout;
+  vk::UniqueDescriptorSetLayout m_meshDescriptorSetLayout;
+  vk::UniqueDescriptorPool m_descriptorPool;
+  std::vector<vk::UniqueDescriptorSet> m_arenaDescriptorSets;
+  // Descriptor sets replaced by a resize, along with the frame they were replaced before.
+  std::vector<std::pair<uint64_t, vk::UniqueDescriptorSet>> m_retiredArenaDescriptorSets;
+  std::vector<vk::UniqueDescriptorSet> m_meshDescriptorSets;
+  uint32_t m_maxTaskWorkGroupCountY;
+  uint32_t m_maxTaskWorkGroupTotalCount;
+};
+} // namespace xrmg
@@ -23,6 +23,10 @@
 
 namespace xrmg {
 struct Options {
+  enum class FoveationCenter { LENS, MOCK_GAZE };
+  enum class CullingFrustum { VIEW, STEREO };
+  enum class TriangleOrder { VERTEX_CACHE, OVERDRAW };
+
   std::optional<uint32_t> devGroupIndex;
   std::optional<uint32_t> simulatedPhysicalDeviceCount;
   std::optional<vk::Extent2D> windowClientAreaSize;
@@ -41,6 +45,24 @@ struct Options {
   vk::Format swapchainFormat = vk::Format::eR8G8B8A8Srgb;
   uint32_t swapchainImageCount = 3;
   bool swapEyes = false;
+  bool lateLatching = false;
+  bool timewarp = false;
+  bool quadViews = false;
+  std::optional<FoveationCenter> foveation;
+  bool dynamicResolution = false;
+  vk::SampleCountFlagBits sampleCount = vk::SampleCountFlagBits::e1;
+  // Full rate radius around the lens center and full rate extrusion of fur layers, both in percent.
+  std::optional<std::pair<uint32_t, uint32_t>> variableRateShading;
+  bool halfRatePeriphery = false;
+  bool gpuCulling = false;
+  bool occlusionCulling = false;
+  std::optional<CullingFrustum> cpuCulling;
+  // Minimum projected length of a torus segment in pixels.
+  std::optional<uint32_t> lodSegmentPixels;
+  bool meshShading = false;
+  bool compactVertices = false;
+  std::optional<TriangleOrder> triangleLists;
+  bool pipelineStatistics = false;
 
   Options(const std::vector<std::string> &p_args);
 
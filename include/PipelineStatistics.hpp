@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+#include "xrmg.hpp"
+
+namespace xrmg {
+class Renderer;
+
+// Counts the input assembly primitives and vertex shader invocations of each physical device's rendering with a
+// pipeline statistics query and logs their averages per frame, e.g. to compare the triangle layouts of the meshes.
+// Also times the instance uploads of each physical device and logs their average size and GPU time per frame.
+class PipelineStatistics {
+public:
+  // Number of frames each logged average covers.
+  static constexpr uint32_t LOG_INTERVAL = 100;
+
+  PipelineStatistics(const Renderer &p_renderer);
+
+  // Must be recorded outside of rendering.
+  void writeRenderBegin(vk::CommandBuffer p_cmdBuffer, uint64_t p_frameIndex, uint32_t p_physicalDeviceIndex);
+  void writeRenderEnd(vk::CommandBuffer p_cmdBuffer, uint64_t p_frameIndex, uint32_t p_physicalDeviceIndex);
+  void writeInstanceUploadBegin(vk::CommandBuffer p_cmdBuffer, uint64_t p_frameIndex, uint32_t p_physicalDeviceIndex);
+  void writeInstanceUploadEnd(vk::CommandBuffer p_cmdBuffer, uint64_t p_frameIndex, uint32_t p_physicalDeviceIndex,
+                              vk::DeviceSize p_uploadSize);
+  // Must only be called once the rendering of frame p_frameIndex has finished on all devices.
+  void update(uint64_t p_frameIndex);
+
+private:
+  struct Sums {
+    uint64_t primitiveCount = 0;
+    uint64_t vertexShaderInvocationCount = 0;
+    double uploadNanos = 0.0;
+    vk::DeviceSize uploadSize = 0;
+    uint32_t frameCount = 0;
+  };
+
+  const Renderer &m_renderer;
+  float m_timestampPeriod;
+  vk::UniqueQueryPool m_queryPool;
+  vk::UniqueQueryPool m_uploadQueryPool;
+  // Bytes uploaded per frame slot and physical device.
+  std::vector<vk::DeviceSize> m_uploadSizes;
+  std::vector<Sums> m_sums;
+
+  uint32_t getQueryIndex(uint64_t p_frameIndex, uint32_t p_physicalDeviceIndex) const;
+};
+} // namespace xrmg
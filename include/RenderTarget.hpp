@@ -32,9 +32,14 @@ public:
   const VulkanImageResource &getColorResource(uint64_t p_frameIndex) const;
   VulkanImageResource &getDepthResource(uint64_t p_frameIndex);
   const VulkanImageResource &getDepthResource(uint64_t p_frameIndex) const;
+  // Only present with multisampling; resolved into the color and depth resources of the current frame.
+  const std::optional<VulkanImageResource> &getMultisampleColorResource() const { return m_multisampleColorResource; }
+  const std::optional<VulkanImageResource> &getMultisampleDepthResource() const { return m_multisampleDepthResource; }
 
 private:
   std::vector<VulkanImageResource> m_colorResources;
   std::vector<VulkanImageResource> m_depthResources;
+  std::optional<VulkanImageResource> m_multisampleColorResource;
+  std::optional<VulkanImageResource> m_multisampleDepthResource;
 };
 } // namespace xrmg
@@ -23,8 +23,14 @@
 #include "VulkanQueueFamily.hpp"
 
 namespace xrmg {
+class Compositor;
+class DeviceMemoryAllocator;
+class MeshUploader;
+class PipelineStatistics;
 class RenderTarget;
+class ResolutionGovernor;
 class Scene;
+class ShadingRateMap;
 
 class Renderer {
 public:
@@ -41,16 +47,48 @@ public:
   uint32_t getDeviceMaskFirst() const { return m_deviceMaskFirst; }
   const vk::Extent2D &getResolutionPerPhysicalDevice() const { return m_resolutionPerPhysicalDevice; }
   uint32_t getGraphicsQueueFamilyIndex() const { return m_graphicsQueueFamily->getIndex(); }
+  uint32_t getTransferQueueFamilyIndex() const { return m_transferQueueFamily->getIndex(); }
+  MeshUploader &getMeshUploader() const { return *m_meshUploader; }
+  DeviceMemoryAllocator &getMemoryAllocator() const { return *m_memoryAllocator; }
+  // Only available with --pipeline-statistics.
+  PipelineStatistics *getPipelineStatistics() const { return m_pipelineStatistics.get(); }
   std::optional<uint32_t> queryCompatibleMemoryTypeIndex(uint32_t p_physicalDeviceIndex,
                                                          vk::MemoryPropertyFlags p_propertyFlags,
                                                          std::optional<uint32_t> p_filterMemTypeBits = {}) const;
   float getRuntimeMillis() const { return m_runtimeMillis; }
   uint64_t getCurrentFrameIndex() const { return m_frameIndex; }
+  bool isDeviceRenderingFrame(uint32_t p_physicalDeviceIndex, uint64_t p_frameIndex) const {
+    return p_frameIndex % m_deviceLayouts[p_physicalDeviceIndex].updateInterval == 0;
+  }
   void nextFrame(Scene &p_scene);
   void waitIdle() const { m_vkDevice->waitIdle(); }
 
 private:
+  // With foveated rendering, the periphery is rendered at this fraction of the resolution and an inset of this fraction
+  // of the view size at full resolution.
+  static constexpr float FOVEATION_PERIPHERY_SCALE = 0.5f;
+  static constexpr float FOVEATION_INSET_SIZE = 0.4f;
+  // Devices covering only the periphery render every this many frames. A source image of the compositor is then read
+  // by two frames before the same frame slot is written again, which the frame slot synchronization relies on.
+  static constexpr uint32_t PERIPHERY_UPDATE_INTERVAL = 2;
+
+  struct DeviceLayout {
+    uint32_t viewIndex;
+    uint32_t updateInterval;
+    Rect2Df viewport;
+    vk::Rect2D imageRect;
+  };
+
+  // Part of a device's image, rendered to renderArea of its render target and ending up at destRect in the swapchain
+  // image.
+  struct DeviceRegion {
+    vk::Rect2D renderArea;
+    vk::Rect2D destRect;
+  };
+
   vk::Extent2D m_resolutionPerPhysicalDevice;
+  std::vector<DeviceLayout> m_deviceLayouts;
+  std::vector<std::vector<DeviceRegion>> m_deviceRegions;
 
   vk::UniqueInstance m_vkInstance;
   std::vector<vk::PhysicalDevice> m_vkPhysicalDevices;
@@ -63,17 +101,28 @@ private:
   vk::Queue m_transferQueue;
   vk::Queue m_presentQueue;
   vk::UniquePipelineCache m_pipelineCache;
+  // Outlives all resources whose memory it holds.
+  std::unique_ptr<DeviceMemoryAllocator> m_memoryAllocator;
 
   uint64_t m_frameIndex = 0;
   vk::UniqueSemaphore m_frameIndexSem;
   std::vector<vk::UniqueSemaphore> m_renderDoneSemaphores;
   vk::UniqueSemaphore m_swapchainImageReadySemaphore;
   vk::UniqueSemaphore m_transferDoneSemaphore;
+  vk::UniqueSemaphore m_poseLatchedSemaphore;
+  vk::UniqueSemaphore m_instanceBroadcastSemaphore;
 
   std::unique_ptr<UserInterface> m_userInterface;
   float m_runtimeMillis = 0.0f;
   std::optional<uint64_t> m_lastPredictedDisplayTimeNanos;
   std::vector<RenderTarget> m_renderTargets;
+  std::vector<Mat4x4f> m_renderViews;
+  std::unique_ptr<Compositor> m_compositor;
+  std::unique_ptr<ResolutionGovernor> m_resolutionGovernor;
+  std::unique_ptr<PipelineStatistics> m_pipelineStatistics;
+  std::unique_ptr<ShadingRateMap> m_shadingRateMap;
+  // Streams meshes on the transfer queue; render submissions wait for the uploads finished before the frame.
+  std::unique_ptr<MeshUploader> m_meshUploader;
 
   void fillPhysicalDevices();
   void createQueueFamilies();
@@ -84,9 +133,14 @@ private:
   void createMainRenderTargets();
 
   void renderFrame(Scene &p_scene);
-  void buildFinalFrame(const UserInterface::FrameRenderTargets &p_renderTargets);
+  void latchPose(Scene &p_scene);
+  // Returns whether the depth image was written.
+  bool buildFinalFrame(const UserInterface::FrameRenderTargets &p_renderTargets);
+  void latchComposition();
 
   void printVulkanMemoryProps() const;
-  Rect2Df getDeviceViewport(std::uint32_t p_physicalDeviceIndex) const;
+  Rect2Df getDeviceRelativeViewport(uint32_t p_physicalDeviceIndex, const Rect2Df &p_viewViewport) const;
+  std::vector<DeviceRegion> computeDeviceRegions(uint32_t p_physicalDeviceIndex, const StereoProjection &p_projection,
+                                                 const Rect2Df &p_deviceViewport) const;
 };
 } // namespace xrmg
\ No newline at end of file
@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+#include "xrmg.hpp"
+
+namespace xrmg {
+class Renderer;
+
+// Scales the render area of each physical device so its GPU time stays within the display period. The render targets
+// keep their maximum size; only the part of them that is rendered to changes.
+class ResolutionGovernor {
+public:
+  static constexpr float MIN_SCALE = 0.5f;
+  // Fraction of the display period the rendering of a device may take.
+  static constexpr float BUDGET_FRACTION = 0.85f;
+  // Used when the user interface doesn't predict a display period.
+  static constexpr uint64_t DEFAULT_DISPLAY_PERIOD_NANOS = 11'111'111;
+
+  ResolutionGovernor(const Renderer &p_renderer);
+
+  float getScale(uint32_t p_physicalDeviceIndex) const { return m_scales[p_physicalDeviceIndex]; }
+  void writeRenderBegin(vk::CommandBuffer p_cmdBuffer, uint64_t p_frameIndex, uint32_t p_physicalDeviceIndex);
+  void writeRenderEnd(vk::CommandBuffer p_cmdBuffer, uint64_t p_frameIndex, uint32_t p_physicalDeviceIndex);
+  // Must only be called once the rendering of frame p_frameIndex has finished on all devices.
+  void update(uint64_t p_frameIndex, std::optional<uint64_t> p_displayPeriodNanos);
+
+private:
+  const Renderer &m_renderer;
+  vk::UniqueQueryPool m_queryPool;
+  float m_timestampPeriod;
+  std::vector<float> m_scales;
+
+  uint32_t getQueryIndex(uint64_t p_frameIndex, uint32_t p_physicalDeviceIndex) const;
+};
+} // namespace xrmg
@@ -19,35 +19,72 @@
 #pragma once
 #include "xrmg.hpp"
 
+#include "FrameUploadRing.hpp"
+#include "FrustumCuller.hpp"
 #include "Instance.hpp"
+#include "InstanceCuller.hpp"
+#include "MeshletRenderer.hpp"
 #include "Renderer.hpp"
 #include "TriangleMesh.hpp"
 
 #include <functional>
+#include <future>
 
 namespace xrmg {
 class Scene {
 public:
-  typedef std::function<TriangleMesh(const Renderer &p_renderer, uint32_t p_maxInstances, size_t p_sizePerInstance)>
-      TriangleMeshCreator;
+  typedef std::function<TriangleMesh(const Renderer &p_renderer)> TriangleMeshCreator;
   typedef uint16_t TriangleMeshIndex;
   typedef uint32_t TriangleMeshInstanceIndex;
 
+  // Part of the render target drawn with its own viewport; all regions of a device share its camera.
+  struct RenderRegion {
+    vk::Rect2D renderArea;
+    vk::Viewport viewport;
+  };
+
+  // With multisampling, the multisampled views are rendered to and resolved into color and depth. The shading rate
+  // view is optional. Occlusion culling reduces the image of the depth view into a depth pyramid.
+  struct RenderAttachments {
+    vk::ImageView color;
+    vk::ImageView depth;
+    vk::ImageView multisampleColor;
+    vk::ImageView multisampleDepth;
+    vk::ImageView shadingRate;
+    vk::Extent2D shadingRateTexelSize;
+    vk::Image depthImage;
+  };
+
   static const uint32_t MAX_BASE_TORUS_COUNT = 64;
   static const uint32_t MAX_TORUS_LAYER_COUNT = 16;
 
   Scene(const Renderer &p_renderer);
 
   void update(float p_millis);
-  void render(uint32_t p_physicalDeviceIndex, vk::CommandBuffer p_cmdBuffer, vk::ImageView p_colorDest,
-              vk::ImageView p_depthDest, const vk::Rect2D &p_renderArea, const vk::Viewport &p_viewport,
-              const Mat4x4f &p_view, const Mat4x4f &p_projection);
+  void setCamera(uint64_t p_frameIndex, uint32_t p_physicalDeviceIndex, const Mat4x4f &p_view,
+                 const Mat4x4f &p_projection, const Vec4f &p_clipBounds);
+  void setCameraView(uint64_t p_frameIndex, uint32_t p_physicalDeviceIndex, const Mat4x4f &p_view);
+  void render(uint32_t p_physicalDeviceIndex, vk::CommandBuffer p_cmdBuffer, const RenderAttachments &p_attachments,
+              const std::vector<RenderRegion> &p_regions);
+  // With several physical devices, the first one reads the instances from host memory once per frame, so the others
+  // copy them over the peer links. Must be submitted before and on the first physical device only, with the render
+  // submissions waiting for its transfers.
+  bool isBroadcastingInstances() const { return m_broadcastingInstances; }
+  void broadcastInstances(vk::CommandBuffer p_cmdBuffer, const std::vector<uint32_t> &p_physicalDeviceIndices);
+  // The frame must be finished on all physical devices.
+  void logCullingStatistics(uint64_t p_frameIndex) const;
+  // Releases the instance storage and buffers replaced before the frame, along with the visible instances uploaded up
+  // to it; the frame must be finished on all physical devices.
+  void releaseRetiredInstanceStorage(uint64_t p_finishedFrameIndex);
 
+  // The triangle mesh gets an instance arena of its own for up to p_maxInstances instances.
   TriangleMeshIndex pushTriangleMesh(TriangleMeshCreator p_creator, uint32_t p_maxInstances);
+  // Instances can only be pushed to the triangle mesh whose instances are the last ones of its arena.
   TriangleMeshInstanceIndex pushTriangleMeshInstance(TriangleMeshIndex p_triangleMeshIndex,
                                                      const Mat4x4f &p_modelToWorld = Mat4x4f::IDENTITY);
   void pushFurryTriangleMeshInstances(TriangleMeshIndex p_triangleMeshIndex, uint32_t p_layerCount,
                                       float p_maxExtrusion, const Mat4x4f &p_modelToWorld = Mat4x4f::IDENTITY);
+  // The instance is considered modified, so it's carried over to the following frames and uploaded again.
   Instance &getTriangleMeshIntance(TriangleMeshIndex p_triangleMeshIndex, TriangleMeshInstanceIndex p_instanceIndex);
   std::pair<TriangleMeshIndex, TriangleMeshInstanceIndex> pushTriangleMeshSingleInstance(TriangleMeshCreator p_creator,
                                                                                          const Mat4x4f &p_localToGlobal,
@@ -55,44 +92,158 @@ public:
   void updateProjectionPlane(const Mat4x4f &p_cameraPose, Angle p_verticalFov, float p_aspectRatio,
                              float p_projectionPlaneDistance);
   void clearTriangleMeshInstances(TriangleMeshIndex p_triMeshIndex);
+  // The cage is generated on worker threads while the previous one keeps being rendered, and swapped in by the first
+  // update after it's done. Cages requested meanwhile are coalesced into the latest one.
   void buildCage(uint32_t p_baseTorusTesselationCount, uint32_t p_baseTorusCount, uint32_t p_torusLayerCount);
 
 private:
-  template <typename T> struct MemPoolAllocation {
-    uint32_t count;
-    T *elements = nullptr;
-    size_t memOffset = 0;
+  typedef uint16_t InstanceArenaIndex;
+
+  // Memory for a number of instances along with its buffer; only mapped if it's host visible.
+  struct InstanceStorage {
+    uint32_t capacity = 0;
+    vk::UniqueDeviceMemory memory;
+    vk::UniqueBuffer buffer;
+    Instance *mapped = nullptr;
+  };
+
+  // Instances of one or more triangle meshes, each drawing a contiguous range of them. The host copies are stored one
+  // after the other for each frame slot and grow on demand; the instance buffer all physical devices draw from follows
+  // their capacity in the next update.
+  struct InstanceArena {
+    uint32_t maxInstances;
+    uint32_t instanceCount = 0;
+    // Refilled by the LOD selection every frame, so its instances aren't carried over to the next frame.
+    bool lodSelection = false;
+    InstanceStorage hostInstances;
+    InstanceStorage instanceBuffer;
+    // Range of the instances of each frame slot and of each physical device's instance buffer that differ from the
+    // current frame slot, as first and end instance; empty if the first isn't less than the end.
+    std::array<std::pair<uint32_t, uint32_t>, MAX_QUEUED_FRAMES> staleSlotRanges = {};
+    std::vector<std::pair<uint32_t, uint32_t>> staleDeviceRanges;
+
+    Instance *getInstances(uint32_t p_bufferIndex) const {
+      return hostInstances.mapped + p_bufferIndex * hostInstances.capacity;
+    }
+    size_t getInstancesOffset(uint32_t p_bufferIndex) const {
+      return p_bufferIndex * hostInstances.capacity * sizeof(Instance);
+    }
   };
 
-  struct VulkanMemPool {
-    size_t size = 0;
-    vk::UniqueDeviceMemory memory = {};
-    size_t freePtr = 0;
-    char *mapped = nullptr;
+  struct CageParameters {
+    uint32_t baseTorusTesselationCount;
+    uint32_t baseTorusCount;
+    uint32_t torusLayerCount;
+  };
+
+  // Instances of a cage being generated, a plane per worker thread, along with the torus meshes it's drawn with. The
+  // futures come last, so they're waited for before the instances are destroyed.
+  struct CageBuild {
+    std::chrono::high_resolution_clock::time_point begin;
+    TriangleMeshIndex torusMeshIndex;
+    std::vector<std::pair<uint32_t, TriangleMeshIndex>> lodLevels;
+    std::vector<Instance> instances;
+    std::vector<std::future<void>> planes;
+  };
 
-    template <typename T> MemPoolAllocation<T> allocate(uint32_t p_count);
+  // Buffer visible instances are packed into, along with the memory offset and count of each triangle mesh's ones.
+  struct PackedInstances {
+    vk::Buffer buffer;
+    std::vector<std::pair<size_t, uint32_t>> meshRanges;
   };
 
   struct TriangleMeshContainer {
     TriangleMesh triMesh;
     bool enabled = true;
+    // Meshes are only drawn once the uploader has finished this value, as of the current frame.
+    uint64_t uploadValue = 0;
+    bool uploaded = false;
+    InstanceArenaIndex arenaIndex;
+    uint32_t firstInstance = 0;
     uint32_t instanceCount = 0;
-    std::array<MemPoolAllocation<Instance>, MAX_QUEUED_FRAMES> instances = {};
   };
 
   const Renderer &m_renderer;
+  vk::UniqueDescriptorSetLayout m_descriptorSetLayout;
+  // With mesh shading, the pipeline draws the meshlets of the triangle meshes instead of their vertices.
+  std::unique_ptr<MeshletRenderer> m_meshletRenderer;
   vk::UniquePipelineLayout m_pipelineLayout;
   vk::UniquePipeline m_pipeline;
+  vk::ResolveModeFlagBits m_depthResolveMode = vk::ResolveModeFlagBits::eSampleZero;
   std::vector<TriangleMeshContainer> m_triangleMeshes;
-  VulkanMemPool m_uploadMemPool;
-  vk::UniqueBuffer m_uploadBuffer;
+  std::vector<InstanceArena> m_instanceArenas;
+  uint32_t m_uploadMemTypeIndex;
+  // Host copies, instance and broadcast buffers replaced while frames in flight may still read them, along with the
+  // frame they were replaced before.
+  std::vector<std::pair<uint64_t, InstanceStorage>> m_retiredInstanceStorage;
+  vk::UniqueDeviceMemory m_cameraMemory;
+  vk::UniqueBuffer m_cameraBuffer;
+  char *m_mappedCameras = nullptr;
+  vk::DeviceSize m_cameraStride = 0;
+  vk::UniqueDescriptorPool m_descriptorPool;
+  vk::DescriptorSet m_cameraDescriptorSet;
+  std::unique_ptr<InstanceCuller> m_instanceCuller;
+  // Frame the depth pyramid of each physical device was last built in.
+  std::vector<std::optional<uint64_t>> m_depthPyramidFrameIndices;
+  // CPU culling packs the visible instances of each physical device into this ring every frame.
+  std::unique_ptr<FrameUploadRing> m_visibleUploadRing;
+  // Frustum of each physical device along with the frame its camera was last set for.
+  std::vector<std::pair<uint64_t, FrustumCuller::Frustum>> m_cullFrusta;
+  FrustumCuller m_frustumCuller;
+  // Index of the first bounding sphere of each triangle mesh in m_frustumCuller, plus the total count.
+  std::vector<uint32_t> m_firstSphereIndices;
+  std::optional<uint64_t> m_boundingSpheresFrameIndex;
+  // With stereo culling, the visible instances are packed once per frame and uploaded to all physical devices.
+  PackedInstances m_sharedVisibleInstances;
+  std::vector<uint32_t> m_visibleSphereIndices;
+  // Instances broadcast by the first physical device, in a region per frame slot of its memory with room for the
+  // capacity of all instance arenas; along with the first instance and memory offset of each instance arena's broadcast
+  // range of the current frame.
+  bool m_broadcastingInstances = false;
+  InstanceStorage m_broadcastInstances;
+  std::vector<std::pair<uint32_t, size_t>> m_broadcastRanges;
   uint32_t m_currentBufferIndex;
   std::pair<TriangleMeshIndex, TriangleMeshInstanceIndex> m_projectionPlane;
+  // The torus meshes of all tessellations share an instance arena.
   std::unordered_map<uint32_t, TriangleMeshIndex> m_torusLods;
+  InstanceArenaIndex m_torusArenaIndex;
+  // With LOD selection, the torus instances of the cage are kept aside along with their bounding spheres and
+  // distributed over the torus meshes of each tessellation every frame, each taking a contiguous range of the torus
+  // arena from fine to coarse.
+  std::vector<std::pair<uint32_t, TriangleMeshIndex>> m_lodLevels;
+  std::vector<Instance> m_lodInstances;
+  std::vector<Vec4f> m_lodSpheres;
+  std::optional<uint64_t> m_lodFrameIndex;
+  // Frame the camera of each physical device was last set for.
+  std::vector<uint64_t> m_cameraFrameIndices;
+  std::optional<CageBuild> m_cageBuild;
+  std::optional<CageParameters> m_queuedCage;
 
-  void createChainMailPlane(TriangleMeshIndex p_torusMeshIndex, uint32_t p_horizontalTorusCount,
-                            uint32_t p_verticalTorusCount, uint32_t p_layerCount, float p_maxExtrusion,
-                            const Mat4x4f &p_transform);
+  void startCageBuild(const CageParameters &p_parameters);
+  bool isCageUploaded(const CageBuild &p_build) const;
+  // Replaces the torus instances by the ones of a finished cage.
+  void applyCage(CageBuild &p_build);
   TriangleMeshIndex getTorusMeshIndex(uint32_t p_baseTesselationCount);
+  InstanceArenaIndex pushInstanceArena(uint32_t p_maxInstances);
+  TriangleMeshIndex pushArenaTriangleMesh(TriangleMeshCreator p_creator, InstanceArenaIndex p_arenaIndex);
+  // Replaces the host copies of an arena's instances, keeping the ones of the current frame slot.
+  void resizeInstanceStorage(InstanceArena &p_arena, uint32_t p_capacity);
+  // Replaces the instance buffer of an arena by an uninitialized one with the capacity of its host copies.
+  void resizeInstanceBuffer(InstanceArenaIndex p_arenaIndex);
+  // Replaces the broadcast buffer by an uninitialized one with the given capacity per frame slot.
+  void resizeBroadcastBuffer(uint32_t p_capacity);
+  // Marks instances of the current frame slot as written, so they get copied to the other slots and uploaded again.
+  void markInstancesDirty(InstanceArena &p_arena, uint32_t p_first, uint32_t p_end);
+  vk::DeviceSize getCameraOffset(uint64_t p_frameIndex, uint32_t p_physicalDeviceIndex) const;
+  void updateBoundingSpheres();
+  void selectTorusLods(uint64_t p_frameIndex);
+  PackedInstances packVisibleInstances(const FrustumCuller::Planes &p_planes);
+  // The late pass of occlusion culling draws the late visible instances on top of the early pass, whose multisampled
+  // attachments are kept for it. Each triangle mesh draws the given count of instances from the given first one,
+  // unless the draw commands of the culling on the device take their place.
+  void drawTriangleMeshes(vk::CommandBuffer p_cmdBuffer, const RenderAttachments &p_attachments,
+                          const std::vector<RenderRegion> &p_regions,
+                          const std::vector<std::pair<uint32_t, uint32_t>> &p_draws, uint32_t p_cameraOffset,
+                          bool p_late, bool p_keepMultisample);
 };
 } // namespace xrmg
@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+#include "xrmg.hpp"
+
+#include "Matrix.hpp"
+#include "VulkanImageResource.hpp"
+
+namespace xrmg {
+class Renderer;
+
+// Per physical device fragment shading rate attachment covering its full resolution render area. Texels further from
+// the lens center than the configured radius select 2 x 2 pixel shading. The images are filled once on first use.
+class ShadingRateMap {
+public:
+  ShadingRateMap(const Renderer &p_renderer);
+
+  const vk::Extent2D &getTexelSize() const { return m_texelSize; }
+  vk::ImageView getImageView(uint32_t p_physicalDeviceIndex) const {
+    return m_imageResources[p_physicalDeviceIndex].getImageView();
+  }
+  // p_deviceViewport is the viewport of the projection relative to the device's image.
+  void upload(vk::CommandBuffer p_cmdBuffer, uint32_t p_physicalDeviceIndex, const Rect2Df &p_deviceViewport,
+              const Vec2f &p_lensCenter, const vk::Extent2D &p_imageExtent);
+
+private:
+  vk::Extent2D m_texelSize;
+  vk::Extent2D m_extent;
+  std::vector<VulkanImageResource> m_imageResources;
+  std::vector<bool> m_uploaded;
+  vk::UniqueDeviceMemory m_stagingMemory;
+  vk::UniqueBuffer m_stagingBuffer;
+  uint8_t *m_mappedStaging = nullptr;
+};
+} // namespace xrmg
@@ -32,6 +32,9 @@ struct StereoProjection {
   static StereoProjection create(Eye p_eye, float p_ipd, float p_projectionPlaneDistance, Angle p_verticalFov,
                                  float p_aspectRatio, float p_zNear, float p_zFar);
 
+  // Where the view direction hits the image plane, in normalized device coordinates of the projection.
+  Vec2f getLensCenter() const;
+
   Mat4x4f projectionMatrix;
   Rect2Df relativeViewport;
 };
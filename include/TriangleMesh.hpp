@@ -19,9 +19,11 @@
 #pragma once
 #include "xrmg.hpp"
 
+#include "DeviceMemoryAllocator.hpp"
 #include "Matrix.hpp"
 
 namespace xrmg {
+class MeshUploader;
 class Renderer;
 
 class TriangleMesh {
@@ -32,35 +34,95 @@ public:
     Vec2f tex;
   };
 
+  // Layout of the vertices in memory with --compact-vertices: the position as snorm16 against the bounding box of the
+  // mesh, with one unused component, the normal as octahedral snorm16 and the texture coordinates as unorm16.
+  struct CompactVertex {
+    std::array<int16_t, 4> pos;
+    std::array<int16_t, 2> normal;
+    std::array<uint16_t, 2> tex;
+  };
+
+  // Center and half extent of the vertices' bounding box, which map compact positions back to the mesh's space.
+  struct PositionBounds {
+    Vec4f center;
+    Vec4f halfExtent;
+  };
+
   typedef std::pair<std::vector<vk::VertexInputBindingDescription>, std::vector<vk::VertexInputAttributeDescription>>
       VertexDescription;
 
-  static TriangleMesh createUnitCube(const Renderer &p_renderer, uint32_t p_maxInstances, size_t p_sizePerInstance);
-  static TriangleMesh createPlaneXZ(const Renderer &p_renderer, uint32_t p_maxInstances, size_t p_sizePerInstance);
-  static TriangleMesh createTorusXY(const Renderer &p_renderer, uint32_t p_maxInstances, size_t p_sizePerInstance,
-                                    uint32_t p_subdivisionCount, float p_minorRadius, float p_majorRadius);
+  static constexpr uint32_t MAX_MESHLET_VERTEX_COUNT = 64;
+  static constexpr uint32_t MAX_MESHLET_TRIANGLE_COUNT = 124;
 
-  TriangleMesh(const Renderer &p_renderer, uint32_t p_maxInstances, size_t p_sizePerInstance, uint32_t p_vertexCount,
-               const Vertex *p_vertices, uint32_t p_indexCount = 0, const uint32_t *p_indices = nullptr);
+  // Adjacent triangles drawn by a single mesh shader workgroup. Its vertex indices and triangles are ranges of those of
+  // all meshlets; each triangle packs three 8 bit indices into the meshlet's vertices.
+  struct Meshlet {
+    // Center and radius of a sphere enclosing the meshlet's vertices.
+    Vec4f boundingSphere;
+    // Axis and sine of the half angle of a cone enclosing the outward triangle normals. The cutoff is 1 if the normals
+    // spread too far for the meshlet to ever face away from the viewer as a whole.
+    Vec4f cone;
+    uint32_t firstVertex;
+    uint32_t firstTriangle;
+    uint32_t vertexCount;
+    uint32_t triangleCount;
+  };
+
+  static TriangleMesh createUnitCube(const Renderer &p_renderer);
+  static TriangleMesh createPlaneXZ(const Renderer &p_renderer);
+  static TriangleMesh createTorusXY(const Renderer &p_renderer, uint32_t p_subdivisionCount, float p_minorRadius,
+                                    float p_majorRadius);
+
+  TriangleMesh(const Renderer &p_renderer, uint32_t p_vertexCount, const Vertex *p_vertices, uint32_t p_indexCount = 0,
+               const uint32_t *p_indices = nullptr);
 
   bool hasIndices() const { return m_indexCount != 0; }
+  // Meshlets are only built for mesh shading.
+  bool hasMeshlets() const { return m_meshletCount != 0; }
   bool isUploaded() const { return m_uploaded; }
-  void upload(vk::Device p_vkDevice, uint32_t p_queueFamilyIndex, uint32_t p_deviceMask);
-  uint32_t getMaxInstances() const { return m_maxInstances; }
-  vk::Buffer getInstanceBuffer() const { return m_instanceBuffer.get(); }
-  void bind(vk::CommandBuffer p_cmdBuffer) const;
+  // Streams the vertices and indices to all physical devices. The mesh may only be drawn once the uploader has finished
+  // the returned semaphore value.
+  uint64_t upload(MeshUploader &p_uploader);
+  // Number of indices or, without indices, vertices of a single instance.
+  uint32_t getElementCount() const { return this->hasIndices() ? m_indexCount : m_vertexCount; }
+  // Center and radius of a sphere enclosing all vertices.
+  const Vec4f &getBoundingSphere() const { return m_boundingSphere; }
+  const PositionBounds &getPositionBounds() const { return m_positionBounds; }
+  vk::Buffer getVertexBuffer() const { return m_vertexBuffer.get(); }
+  // Holds the meshlets, followed by their vertex indices and triangles at the given byte offsets.
+  vk::Buffer getMeshletBuffer() const { return m_meshletBuffer.get(); }
+  uint32_t getMeshletCount() const { return m_meshletCount; }
+  vk::DeviceSize getMeshletVertexOffset() const { return m_meshletVertexOffset; }
+  vk::DeviceSize getMeshletTriangleOffset() const { return m_meshletTriangleOffset; }
+  // The instances are read from a buffer of the scene, which may hold those of other triangle meshes as well.
+  void bind(vk::CommandBuffer p_cmdBuffer, vk::Buffer p_instanceBuffer) const;
   void draw(vk::CommandBuffer p_cmdBuffer, uint32_t p_instanceCount = 1, uint32_t p_firstInstance = 0) const;
+  void drawIndirect(vk::CommandBuffer p_cmdBuffer, vk::Buffer p_drawCommandBuffer, vk::DeviceSize p_offset = 0) const;
 
 private:
+  vk::DeviceSize getVertexDataSize() const { return m_vertexCount * m_vertexSize; }
+  vk::DeviceSize getIndexDataSize() const {
+    return m_indexCount * (m_indexType == vk::IndexType::eUint16 ? sizeof(uint16_t) : sizeof(uint32_t));
+  }
+
   bool m_uploaded = false;
   uint32_t m_vertexCount;
   uint32_t m_indexCount;
-  uint32_t m_maxInstances;
-  vk::UniqueDeviceMemory m_uploadMem;
-  vk::UniqueBuffer m_uploadBuffer;
+  uint32_t m_vertexSize;
+  // 16 bit indices are used whenever the vertices fit, leaving their maximum value for the primitive restart.
+  vk::IndexType m_indexType;
+  Vec4f m_boundingSphere;
+  PositionBounds m_positionBounds;
+  uint32_t m_meshletCount = 0;
+  vk::DeviceSize m_meshletVertexOffset = 0;
+  vk::DeviceSize m_meshletTriangleOffset = 0;
+  // Vertices followed by the indices and the meshlet buffer's contents, kept until they are handed to the uploader.
+  std::vector<char> m_uploadData;
+  DeviceMemoryAllocator::Allocation m_vertexMemory;
+  DeviceMemoryAllocator::Allocation m_indexMemory;
+  DeviceMemoryAllocator::Allocation m_meshletMemory;
   vk::UniqueBuffer m_vertexBuffer;
-  vk::UniqueBuffer m_instanceBuffer;
   vk::UniqueBuffer m_indexBuffer;
-  vk::UniqueDeviceMemory m_geoMem;
+  vk::UniqueBuffer m_meshletBuffer;
 };
 } // namespace xrmg
\ No newline at end of file
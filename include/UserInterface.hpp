@@ -29,6 +29,7 @@ class UserInterface {
 public:
   struct FrameInfo {
     std::optional<uint64_t> predictedDisplayTimeNanos;
+    std::optional<uint64_t> predictedDisplayPeriodNanos;
   };
 
   struct FrameRenderTargets {
@@ -40,7 +41,9 @@ public:
 
   virtual ~UserInterface() {}
 
-  virtual vk::Extent2D getResolutionPerEye() = 0;
+  virtual uint32_t getViewCount() = 0;
+  // Sub-image of the swapchain images the given view is presented from.
+  virtual vk::Rect2D getViewImageRect(uint32_t p_viewIndex) = 0;
   virtual vk::UniqueInstance createVkInstance(const vk::InstanceCreateInfo &p_createInfo) = 0;
   virtual std::optional<uint32_t> queryMainPhysicalDevice(vk::Instance p_vkInstance, uint32_t p_queueFamilyIndex,
                                                           uint32_t p_candidateCount,
@@ -50,11 +53,14 @@ public:
                           uint32_t p_presentQueueIndex) = 0;
   virtual void update(float p_millis) = 0;
   virtual FrameInfo beginFrame() = 0;
-  virtual Mat4x4f getCurrentFrameView(StereoProjection::Eye p_eye) = 0;
-  virtual StereoProjection getCurrentFrameProjection(StereoProjection::Eye p_eye) = 0;
+  virtual Mat4x4f getCurrentFrameView(uint32_t p_viewIndex) = 0;
+  virtual StereoProjection getCurrentFrameProjection(uint32_t p_viewIndex) = 0;
+  // Refreshes the current frame's views with the latest available pose prediction.
+  virtual void latchCurrentFrameViews() = 0;
   virtual FrameRenderTargets acquireSwapchainImages(vk::Device p_device) = 0;
   virtual vk::Semaphore getSwapchainImageReadySemaphore() = 0;
-  virtual void releaseSwapchainImage() = 0;
+  // Unless the depth image was written, the frame must be submitted without it.
+  virtual void releaseSwapchainImage(bool p_depthWritten) = 0;
   virtual vk::Semaphore getFrameReadySemaphore() = 0;
   virtual void endFrame(vk::Queue p_presentGraphicsQueue) = 0;
 };
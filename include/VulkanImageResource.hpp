@@ -19,6 +19,8 @@
 #pragma once
 #include "xrmg.hpp"
 
+#include "DeviceMemoryAllocator.hpp"
+
 namespace xrmg {
 class Renderer;
 
@@ -32,7 +34,7 @@ public:
   const vk::ImageView &getImageView() const { return m_imageView.get(); }
 
 private:
-  vk::UniqueDeviceMemory m_memory;
+  DeviceMemoryAllocator::Allocation m_memory;
   vk::UniqueImage m_image;
   vk::UniqueImageView m_imageView;
 };
@@ -30,7 +30,8 @@ class WindowUserInterface : public UserInterface, public UserInputSink {
 public:
   WindowUserInterface(Window &p_window) : m_window(p_window) { m_window.pushUserInputSink(*this); }
 
-  vk::Extent2D getResolutionPerEye() override;
+  uint32_t getViewCount() override { return 2; }
+  vk::Rect2D getViewImageRect(uint32_t p_viewIndex) override;
   vk::UniqueInstance createVkInstance(const vk::InstanceCreateInfo &p_createInfo) override;
   std::optional<uint32_t> queryMainPhysicalDevice(vk::Instance p_vkInstance, uint32_t p_queueFamilyIndex,
                                                   uint32_t p_candidateCount, vk::PhysicalDevice *p_candidates) override;
@@ -39,13 +40,15 @@ public:
                   uint32_t p_presentQueueIndex) override;
   void update(float p_millis) override;
   FrameInfo beginFrame() override;
-  Mat4x4f getCurrentFrameView(StereoProjection::Eye p_eye) override;
-  StereoProjection getCurrentFrameProjection(StereoProjection::Eye p_eye) override;
+  Mat4x4f getCurrentFrameView(uint32_t p_viewIndex) override;
+  StereoProjection getCurrentFrameProjection(uint32_t p_viewIndex) override;
+  void latchCurrentFrameViews() override {}
   FrameRenderTargets acquireSwapchainImages(vk::Device p_device) override;
   vk::Semaphore getSwapchainImageReadySemaphore() override;
-  void releaseSwapchainImage() override;
+  void releaseSwapchainImage(bool p_depthWritten) override;
   vk::Semaphore getFrameReadySemaphore() override { return m_frameReadySemaphore.get(); }
   void endFrame(vk::Queue p_presentGraphicsQueue) override;
+  vk::Extent2D getResolutionPerEye();
   float getAspectRatioPerEye();
 
   bool onKeyDown(int32_t p_key) override;
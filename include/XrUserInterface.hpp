@@ -26,12 +26,13 @@
 namespace xrmg {
 class XrUserInterface : public UserInterface {
 public:
-  static const uint32_t VIEW_COUNT = 2;
+  static const uint32_t MAX_VIEW_COUNT = 4;
 
   XrUserInterface(bool p_enableCoreValidation);
   ~XrUserInterface();
 
-  vk::Extent2D getResolutionPerEye() override { return m_resolutionPerEye; }
+  uint32_t getViewCount() override { return m_viewCount; }
+  vk::Rect2D getViewImageRect(uint32_t p_viewIndex) override;
   vk::UniqueInstance createVkInstance(const vk::InstanceCreateInfo &p_createInfo) override;
   std::optional<uint32_t> queryMainPhysicalDevice(vk::Instance p_vkInstance, uint32_t p_queueFamilyIndex,
                                                   uint32_t p_candidateCount, vk::PhysicalDevice *p_candidates) override;
@@ -40,11 +41,12 @@ public:
                   uint32_t p_presentQueueIndex) override;
   void update(float p_millis) override {}
   FrameInfo beginFrame() override;
-  Mat4x4f getCurrentFrameView(StereoProjection::Eye p_eye) override;
-  StereoProjection getCurrentFrameProjection(StereoProjection::Eye p_eye) override;
+  Mat4x4f getCurrentFrameView(uint32_t p_viewIndex) override;
+  StereoProjection getCurrentFrameProjection(uint32_t p_viewIndex) override;
+  void latchCurrentFrameViews() override;
   FrameRenderTargets acquireSwapchainImages(vk::Device p_device) override;
   vk::Semaphore getSwapchainImageReadySemaphore() override { return {}; }
-  void releaseSwapchainImage() override;
+  void releaseSwapchainImage(bool p_depthWritten) override;
   vk::Semaphore getFrameReadySemaphore() override { return {}; }
   void endFrame(vk::Queue p_presentGraphicsQueue) override;
 
@@ -62,7 +64,9 @@ private:
 
   XrInstance m_instance = nullptr;
   XrSystemId m_systemId;
-  vk::Extent2D m_resolutionPerEye;
+  XrViewConfigurationType m_viewConfigurationType = XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO;
+  uint32_t m_viewCount = 2;
+  std::array<vk::Extent2D, MAX_VIEW_COUNT> m_viewResolutions = {};
   vk::PhysicalDevice m_mainPhysicalDevice;
   XrSession m_session = nullptr;
   Swapchain m_colorSwapchain;
@@ -70,9 +74,12 @@ private:
   XrSpace m_space;
   XrSessionState m_sessionState = XR_SESSION_STATE_UNKNOWN;
   XrTime m_currentFramePredictedDisplayTime;
-  std::array<XrView, VIEW_COUNT> m_locatedViews;
+  std::array<XrView, MAX_VIEW_COUNT> m_locatedViews;
   SwapchainImageState m_swapchainImageState;
+  bool m_depthWritten = false;
 
+  void updateViewResolutions();
+  void locateViews();
   void handleEvents();
   void handle(XrEventDataSessionStateChanged &p_evt);
   Swapchain createSwapchain(const XrSwapchainCreateInfo &p_createInfo) const;
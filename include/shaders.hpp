@@ -20,7 +20,27 @@
 #include <vector>
 
 namespace xrmg {
+static const std::vector<uint32_t> g_composeSrc = {
+#include "shaders/compose.slang.inl"
+};
+
+static const std::vector<uint32_t> g_cullSrc = {
+#include "shaders/cull.slang.inl"
+};
+
+static const std::vector<uint32_t> g_depthPyramidSrc = {
+#include "shaders/depthPyramid.slang.inl"
+};
+
 static const std::vector<uint32_t> g_layeredMeshSrc = {
 #include "shaders/layeredMesh.slang.inl"
 };
+
+static const std::vector<uint32_t> g_layeredMeshletsSrc = {
+#include "shaders/layeredMeshlets.slang.inl"
+};
+
+static const std::vector<uint32_t> g_layeredMeshVrsSrc = {
+#include "shaders/layeredMeshVrs.slang.inl"
+};
 } // namespace xrmg
\ No newline at end of file
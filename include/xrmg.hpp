@@ -102,6 +102,8 @@
 
 #define XRMG_BOOL_TO_STRING(_v) ((_v) ? "\033[32m✔\033[0m" : "\033[31m✘\033[0m")
 
+#define XRMG_ALIGN(_value, _alignment) ((((_value) + (_alignment) - 1) / (_alignment)) * (_alignment))
+
 #ifdef _WIN32
 namespace xrmg {
 inline std::string formatLastWin32Error(std::optional<DWORD> p_lastError = {}) {
@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "Compositor.hpp"
+
+#include "Renderer.hpp"
+
+#include "shaders.hpp"
+
+namespace xrmg {
+Mat4x4f Compositor::createReprojection(const Mat4x4f &p_projection, const Rect2Df &p_relativeViewport,
+                                       const Mat4x4f &p_renderView, const Mat4x4f &p_displayView) {
+  Mat4x4f uvToNdc = Mat4x4f::createTranslation(-1.0f - 2.0f * p_relativeViewport.x / p_relativeViewport.width,
+                                               -1.0f - 2.0f * p_relativeViewport.y / p_relativeViewport.height, 0.0f) *
+                    Mat4x4f::createScaling(2.0f / p_relativeViewport.width, 2.0f / p_relativeViewport.height, 1.0f);
+  Mat4x4f displayToRender = p_renderView * p_displayView.invert();
+  for (uint32_t i = 0; i < 3; ++i) {
+    displayToRender.v[i][3] = 0.0f;
+  }
+  return uvToNdc.invert() * p_projection * displayToRender * p_projection.invert() * uvToNdc;
+}
+
+Compositor::Compositor(const Renderer &p_renderer, const std::vector<vk::Extent2D> &p_sourceExtents,
+                       uint32_t p_maxLayerCount)
+    : m_renderer(p_renderer), m_sourceCount(static_cast<uint32_t>(p_sourceExtents.size())),
+      m_maxLayerCount(p_maxLayerCount) {
+  // The sources are the per physical device images of each frame slot, transferred to the main physical device.
+  vk::ImageCreateInfo sourceImageCreateInfo(
+      {}, vk::ImageType::e2D, g_renderFormat, {}, 1, 1, vk::SampleCountFlagBits::e1,
+      vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled,
+      vk::SharingMode::eExclusive, {}, vk::ImageLayout::eUndefined);
+  vk::ImageViewCreateInfo sourceImageViewCreateInfo({}, {}, vk::ImageViewType::e2D, g_renderFormat, {},
+                                                    {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1});
+  for (uint32_t i = 0; i < MAX_QUEUED_FRAMES * m_sourceCount; ++i) {
+    sourceImageCreateInfo.setExtent(vk::Extent3D(p_sourceExtents[i % m_sourceCount], 1));
+    m_sourceResources.emplace_back(p_renderer, 0, sourceImageCreateInfo, sourceImageViewCreateInfo);
+  }
+
+  m_sampler = p_renderer.vkDevice().createSamplerUnique(
+      {{}, vk::Filter::eLinear, vk::Filter::eLinear, vk::SamplerMipmapMode::eNearest,
+       vk::SamplerAddressMode::eClampToEdge, vk::SamplerAddressMode::eClampToEdge,
+       vk::SamplerAddressMode::eClampToEdge});
+  std::vector<vk::DescriptorSetLayoutBinding> bindings = {
+      {0, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment, &m_sampler.get()},
+      {1, vk::DescriptorType::eUniformBufferDynamic, 1, vk::ShaderStageFlagBits::eFragment}};
+  m_descriptorSetLayout = p_renderer.vkDevice().createDescriptorSetLayoutUnique({{}, bindings});
+  vk::PushConstantRange sourceRectRange(vk::ShaderStageFlagBits::eFragment, 0, sizeof(Rect2Df));
+  m_pipelineLayout =
+      p_renderer.vkDevice().createPipelineLayoutUnique({{}, m_descriptorSetLayout.get(), sourceRectRange});
+
+  vk::UniqueShaderModule composeModule = p_renderer.vkDevice().createShaderModuleUnique({{}, g_composeSrc});
+  std::vector<vk::PipelineShaderStageCreateInfo> stages = {
+      {{}, vk::ShaderStageFlagBits::eVertex, composeModule.get(), "vs"},
+      {{}, vk::ShaderStageFlagBits::eFragment, composeModule.get(), "fs"}};
+  vk::PipelineVertexInputStateCreateInfo vertexInputState;
+  vk::PipelineInputAssemblyStateCreateInfo inputAssemblyState({}, vk::PrimitiveTopology::eTriangleList, false);
+  vk::PipelineViewportStateCreateInfo viewportState({}, 1, nullptr, 1, nullptr);
+  vk::PipelineRasterizationStateCreateInfo rasterizationState(
+      {}, false, false, vk::PolygonMode::eFill, vk::CullModeFlagBits::eNone, vk::FrontFace::eCounterClockwise, false,
+      0.0f, 0.0f, 0.0f, 1.0f);
+  vk::PipelineMultisampleStateCreateInfo multisampleState({}, vk::SampleCountFlagBits::e1);
+  vk::PipelineDepthStencilStateCreateInfo depthStencilState;
+  vk::PipelineColorBlendAttachmentState blendAttachment(false);
+  blendAttachment.setColorWriteMask(vk::FlagTraits<vk::ColorComponentFlagBits>::allFlags);
+  vk::PipelineColorBlendStateCreateInfo colorBlendState({}, false, {}, blendAttachment);
+  std::vector<vk::DynamicState> dynamicStates = {vk::DynamicState::eViewport, vk::DynamicState::eScissor};
+  vk::PipelineDynamicStateCreateInfo dynamicState({}, dynamicStates);
+  vk::StructureChain pipelineCreateChain(
+      vk::GraphicsPipelineCreateInfo({}, stages, &vertexInputState, &inputAssemblyState, nullptr, &viewportState,
+                                     &rasterizationState, &multisampleState, &depthStencilState, &colorBlendState,
+                                     &dynamicState, m_pipelineLayout.get()),
+      vk::PipelineRenderingCreateInfo(0, g_renderFormat));
+  auto [createPipelineResult, pipeline] =
+      p_renderer.vkDevice().createGraphicsPipelineUnique(p_renderer.getPipelineCache(), pipelineCreateChain.get());
+  XRMG_ASSERT(createPipelineResult == vk::Result::eSuccess, "Pipeline creation failed.");
+  m_pipeline = std::move(pipeline);
+
+  // One transform per frame slot and layer.
+  uint32_t transformSlotCount = MAX_QUEUED_FRAMES * m_maxLayerCount;
+  vk::DeviceSize uboAlignment = p_renderer.getPhysicalDevice(0).getProperties().limits.minUniformBufferOffsetAlignment;
+  m_transformStride = XRMG_ALIGN(sizeof(Mat4x4f), uboAlignment);
+  vk::DeviceSize transformBufferSize = transformSlotCount * m_transformStride;
+  m_transformBuffer = p_renderer.vkDevice().createBufferUnique(
+      {{}, transformBufferSize, vk::BufferUsageFlagBits::eUniformBuffer, vk::SharingMode::eExclusive, {}});
+  vk::MemoryRequirements transformMemReqs = p_renderer.vkDevice().getBufferMemoryRequirements(m_transformBuffer.get());
+  std::optional<uint32_t> transformMemTypeIndex = p_renderer.queryCompatibleMemoryTypeIndex(
+      0, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+      transformMemReqs.memoryTypeBits);
+  XRMG_ASSERT(transformMemTypeIndex, "No host visible and coherent memory type for the transform buffer available.");
+  m_transformMemory =
+      p_renderer.vkDevice().allocateMemoryUnique({transformMemReqs.size, transformMemTypeIndex.value()});
+  m_mappedTransforms =
+      reinterpret_cast<char *>(p_renderer.vkDevice().mapMemory(m_transformMemory.get(), 0, transformMemReqs.size));
+  p_renderer.vkDevice().bindBufferMemory(m_transformBuffer.get(), m_transformMemory.get(), 0);
+  for (uint32_t i = 0; i < transformSlotCount; ++i) {
+    *reinterpret_cast<Mat4x4f *>(m_mappedTransforms + i * m_transformStride) = Mat4x4f::IDENTITY;
+  }
+
+  auto slotCount = static_cast<uint32_t>(m_sourceResources.size());
+  std::vector<vk::DescriptorPoolSize> poolSizes = {{vk::DescriptorType::eCombinedImageSampler, slotCount},
+                                                   {vk::DescriptorType::eUniformBufferDynamic, slotCount}};
+  m_descriptorPool = p_renderer.vkDevice().createDescriptorPoolUnique({{}, slotCount, poolSizes});
+  std::vector<vk::DescriptorSetLayout> setLayouts(slotCount, m_descriptorSetLayout.get());
+  m_descriptorSets = p_renderer.vkDevice().allocateDescriptorSets({m_descriptorPool.get(), setLayouts});
+  vk::DescriptorBufferInfo transformBufferInfo(m_transformBuffer.get(), 0, sizeof(Mat4x4f));
+  for (uint32_t i = 0; i < slotCount; ++i) {
+    vk::DescriptorImageInfo imageInfo(nullptr, m_sourceResources[i].getImageView(),
+                                      vk::ImageLayout::eShaderReadOnlyOptimal);
+    std::vector<vk::WriteDescriptorSet> writes = {
+        {m_descriptorSets[i], 0, 0, vk::DescriptorType::eCombinedImageSampler, imageInfo},
+        {m_descriptorSets[i], 1, 0, vk::DescriptorType::eUniformBufferDynamic, {}, transformBufferInfo}};
+    p_renderer.vkDevice().updateDescriptorSets(writes, {});
+  }
+}
+
+uint32_t Compositor::getSourceSlot(uint64_t p_frameIndex, uint32_t p_sourceIndex) const {
+  XRMG_ASSERT(p_sourceIndex < m_sourceCount, "Source index ({}) must be less than the number of sources ({}).",
+              p_sourceIndex, m_sourceCount);
+  return static_cast<uint32_t>(p_frameIndex % MAX_QUEUED_FRAMES) * m_sourceCount + p_sourceIndex;
+}
+
+uint32_t Compositor::getTransformSlot(uint64_t p_frameIndex, uint32_t p_layerIndex) const {
+  XRMG_ASSERT(p_layerIndex < m_maxLayerCount, "Layer index ({}) must be less than the maximum layer count ({}).",
+              p_layerIndex, m_maxLayerCount);
+  return static_cast<uint32_t>(p_frameIndex % MAX_QUEUED_FRAMES) * m_maxLayerCount + p_layerIndex;
+}
+
+VulkanImageResource &Compositor::getSourceResource(uint64_t p_frameIndex, uint32_t p_sourceIndex) {
+  return m_sourceResources[this->getSourceSlot(p_frameIndex, p_sourceIndex)];
+}
+
+void Compositor::setLayerTransform(uint64_t p_frameIndex, uint32_t p_layerIndex, const Mat4x4f &p_destToSource) {
+  *reinterpret_cast<Mat4x4f *>(m_mappedTransforms +
+                               this->getTransformSlot(p_frameIndex, p_layerIndex) * m_transformStride) = p_destToSource;
+}
+
+vk::ImageView Compositor::getDestImageView(vk::Image p_dest) {
+  // Swapchain images are recycled, so their views are created once on first use.
+  auto it = m_destImageViews.find(p_dest);
+  if (it == m_destImageViews.end()) {
+    vk::ImageViewCreateInfo imageViewCreateInfo({}, p_dest, vk::ImageViewType::e2D, g_renderFormat, {},
+                                                {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1});
+    it = m_destImageViews.emplace(p_dest, m_renderer.vkDevice().createImageViewUnique(imageViewCreateInfo)).first;
+  }
+  return it->second.get();
+}
+
+void Compositor::compose(vk::CommandBuffer p_cmdBuffer, uint64_t p_frameIndex, vk::Image p_dest,
+                         const vk::Rect2D &p_renderArea, const std::vector<Layer> &p_layers) {
+  vk::RenderingAttachmentInfo colorAttachment(this->getDestImageView(p_dest), vk::ImageLayout::eColorAttachmentOptimal,
+                                              vk::ResolveModeFlagBits::eNone, nullptr, vk::ImageLayout::eUndefined,
+                                              vk::AttachmentLoadOp::eClear, vk::AttachmentStoreOp::eStore,
+                                              g_clearValues);
+  p_cmdBuffer.beginRendering(vk::RenderingInfo({}, p_renderArea, 1, 0, colorAttachment, nullptr, nullptr));
+  p_cmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_pipeline.get());
+  XRMG_ASSERT(p_layers.size() <= m_maxLayerCount, "Too many layers ({}).", p_layers.size());
+  for (uint32_t layerIdx = 0; layerIdx < p_layers.size(); ++layerIdx) {
+    const Layer &layer = p_layers[layerIdx];
+    vk::Viewport viewport(static_cast<float>(layer.destRect.offset.x), static_cast<float>(layer.destRect.offset.y),
+                          static_cast<float>(layer.destRect.extent.width),
+                          static_cast<float>(layer.destRect.extent.height), 0.0f, 1.0f);
+    p_cmdBuffer.setViewport(0, viewport);
+    p_cmdBuffer.setScissor(0, layer.destRect);
+    auto transformOffset = static_cast<uint32_t>(this->getTransformSlot(p_frameIndex, layerIdx) * m_transformStride);
+    p_cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_pipelineLayout.get(), 0,
+                                   m_descriptorSets[this->getSourceSlot(layer.sourceFrameIndex, layer.sourceIndex)],
+                                   transformOffset);
+    p_cmdBuffer.pushConstants(m_pipelineLayout.get(), vk::ShaderStageFlagBits::eFragment, 0, sizeof(Rect2Df),
+                              &layer.sourceRect);
+    p_cmdBuffer.draw(3, 1, 0, 0);
+  }
+  p_cmdBuffer.endRendering();
+}
+} // namespace xrmg
@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "DepthPyramid.hpp"
+
+#include "Renderer.hpp"
+
+#include "shaders.hpp"
+
+namespace xrmg {
+static const vk::Format g_pyramidFormat = vk::Format::eR32Sfloat;
+
+struct LevelConstants {
+  uint32_t sourceExtent[2];
+  uint32_t destExtent[2];
+};
+
+DepthPyramid::DepthPyramid(const Renderer &p_renderer)
+    : m_renderer(p_renderer), m_depthExtent(p_renderer.getResolutionPerPhysicalDevice()) {
+  vk::Extent2D levelExtent = m_depthExtent;
+  do {
+    levelExtent = vk::Extent2D((levelExtent.width + 1) / 2, (levelExtent.height + 1) / 2);
+    m_levelExtents.push_back(levelExtent);
+  } while (1 < levelExtent.width || 1 < levelExtent.height);
+  uint32_t levelCount = this->getLevelCount();
+
+  m_image = p_renderer.vkDevice().createImageUnique(
+      {{},
+       vk::ImageType::e2D,
+       g_pyramidFormat,
+       vk::Extent3D(m_levelExtents.front(), 1),
+       levelCount,
+       1,
+       vk::SampleCountFlagBits::e1,
+       vk::ImageTiling::eOptimal,
+       vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled,
+       vk::SharingMode::eExclusive,
+       {},
+       vk::ImageLayout::eUndefined});
+  // Allocated for all physical devices, so each of them gets its own instance.
+  vk::MemoryRequirements memReqs = p_renderer.vkDevice().getImageMemoryRequirements(m_image.get());
+  std::optional<uint32_t> memTypeIndex =
+      p_renderer.queryCompatibleMemoryTypeIndex(0, vk::MemoryPropertyFlagBits::eDeviceLocal, memReqs.memoryTypeBits);
+  XRMG_ASSERT(memTypeIndex, "No device local memory type for the depth pyramid available.");
+  m_memory = p_renderer.getMemoryAllocator().allocateImageMemory(m_image.get(), memTypeIndex.value(),
+                                                                 p_renderer.getDeviceMaskAll());
+  m_imageView = p_renderer.vkDevice().createImageViewUnique(
+      {{}, m_image.get(), vk::ImageViewType::e2D, g_pyramidFormat, {},
+       {vk::ImageAspectFlagBits::eColor, 0, levelCount, 0, 1}});
+  for (uint32_t level = 0; level < levelCount; ++level) {
+    m_levelViews.push_back(p_renderer.vkDevice().createImageViewUnique(
+        {{}, m_image.get(), vk::ImageViewType::e2D, g_pyramidFormat, {},
+         {vk::ImageAspectFlagBits::eColor, level, 1, 0, 1}}));
+  }
+
+  std::vector<vk::DescriptorSetLayoutBinding> bindings = {
+      {0, vk::DescriptorType::eSampledImage, 1, vk::ShaderStageFlagBits::eCompute},
+      {1, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eCompute}};
+  m_descriptorSetLayout = p_renderer.vkDevice().createDescriptorSetLayoutUnique({{}, bindings});
+  vk::PushConstantRange constantsRange(vk::ShaderStageFlagBits::eCompute, 0, sizeof(LevelConstants));
+  m_pipelineLayout =
+      p_renderer.vkDevice().createPipelineLayoutUnique({{}, m_descriptorSetLayout.get(), constantsRange});
+  vk::UniqueShaderModule module = p_renderer.vkDevice().createShaderModuleUnique({{}, g_depthPyramidSrc});
+  vk::ComputePipelineCreateInfo pipelineCreateInfo({}, {{}, vk::ShaderStageFlagBits::eCompute, module.get(), "cs"},
+                                                   m_pipelineLayout.get());
+  auto [createPipelineResult, pipeline] =
+      p_renderer.vkDevice().createComputePipelineUnique(p_renderer.getPipelineCache(), pipelineCreateInfo);
+  XRMG_ASSERT(createPipelineResult == vk::Result::eSuccess, "Pipeline creation failed.");
+  m_pipeline = std::move(pipeline);
+
+  // One set per level above 0 and one per depth image of each physical device.
+  uint32_t maxSets = levelCount - 1 + MAX_QUEUED_FRAMES * p_renderer.getPhysicalDeviceCount();
+  std::vector<vk::DescriptorPoolSize> poolSizes = {{vk::DescriptorType::eSampledImage, maxSets},
+                                                   {vk::DescriptorType::eStorageImage, maxSets}};
+  m_descriptorPool = p_renderer.vkDevice().createDescriptorPoolUnique({{}, maxSets, poolSizes});
+  m_levelDescriptorSets.push_back({});
+  for (uint32_t level = 1; level < levelCount; ++level) {
+    vk::DescriptorSet descriptorSet =
+        p_renderer.vkDevice().allocateDescriptorSets({m_descriptorPool.get(), m_descriptorSetLayout.get()}).front();
+    vk::DescriptorImageInfo sourceInfo({}, m_levelViews[level - 1].get(), vk::ImageLayout::eGeneral);
+    vk::DescriptorImageInfo destInfo({}, m_levelViews[level].get(), vk::ImageLayout::eGeneral);
+    std::vector<vk::WriteDescriptorSet> writes = {
+        {descriptorSet, 0, 0, vk::DescriptorType::eSampledImage, sourceInfo},
+        {descriptorSet, 1, 0, vk::DescriptorType::eStorageImage, destInfo}};
+    p_renderer.vkDevice().updateDescriptorSets(writes, {});
+    m_levelDescriptorSets.push_back(descriptorSet);
+  }
+
+  // The culling reads the pyramid before its first build, so it starts out in the general layout on all devices.
+  vk::UniqueCommandPool cmdPool =
+      p_renderer.vkDevice().createCommandPoolUnique({{}, p_renderer.getGraphicsQueueFamilyIndex()});
+  vk::UniqueCommandBuffer cmdBuffer = std::move(
+      p_renderer.vkDevice().allocateCommandBuffersUnique({cmdPool.get(), vk::CommandBufferLevel::ePrimary, 1}).front());
+  vk::ImageMemoryBarrier2 initBarrier(vk::PipelineStageFlagBits2::eNone, vk::AccessFlagBits2::eNone,
+                                      vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eNone,
+                                      vk::ImageLayout::eUndefined, vk::ImageLayout::eGeneral, VK_QUEUE_FAMILY_IGNORED,
+                                      VK_QUEUE_FAMILY_IGNORED, m_image.get(),
+                                      {vk::ImageAspectFlagBits::eColor, 0, levelCount, 0, 1});
+  cmdBuffer->begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+  cmdBuffer->pipelineBarrier2({{}, {}, {}, initBarrier});
+  cmdBuffer->end();
+  vk::CommandBufferSubmitInfo cmdBufferSubmit(cmdBuffer.get(), p_renderer.getDeviceMaskAll());
+  vk::Queue queue = p_renderer.vkDevice().getQueue(p_renderer.getGraphicsQueueFamilyIndex(), 0);
+  queue.submit2(vk::SubmitInfo2({}, {}, cmdBufferSubmit));
+  queue.waitIdle();
+}
+
+vk::DescriptorSet DepthPyramid::getDepthDescriptorSet(vk::ImageView p_depthView) {
+  if (auto it = m_depthDescriptorSets.find(p_depthView); it != m_depthDescriptorSets.end()) {
+    return it->second;
+  }
+  XRMG_ASSERT(m_depthDescriptorSets.size() < MAX_QUEUED_FRAMES * m_renderer.getPhysicalDeviceCount(),
+              "Too many depth images for the depth pyramid.");
+  vk::DescriptorSet descriptorSet =
+      m_renderer.vkDevice().allocateDescriptorSets({m_descriptorPool.get(), m_descriptorSetLayout.get()}).front();
+  vk::DescriptorImageInfo sourceInfo({}, p_depthView, vk::ImageLayout::eDepthReadOnlyOptimal);
+  vk::DescriptorImageInfo destInfo({}, m_levelViews.front().get(), vk::ImageLayout::eGeneral);
+  std::vector<vk::WriteDescriptorSet> writes = {{descriptorSet, 0, 0, vk::DescriptorType::eSampledImage, sourceInfo},
+                                                {descriptorSet, 1, 0, vk::DescriptorType::eStorageImage, destInfo}};
+  m_renderer.vkDevice().updateDescriptorSets(writes, {});
+  return m_depthDescriptorSets.emplace(p_depthView, descriptorSet).first->second;
+}
+
+void DepthPyramid::build(vk::CommandBuffer p_cmdBuffer, vk::Image p_depthImage, vk::ImageView p_depthView) {
+  vk::ImageSubresourceRange depthRange(vk::ImageAspectFlagBits::eDepth, 0, 1, 0, 1);
+  // The previous contents are discarded once the last culling is done reading them.
+  std::vector<vk::ImageMemoryBarrier2> preBuildBarriers = {
+      {vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eNone,
+       vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageWrite,
+       vk::ImageLayout::eUndefined, vk::ImageLayout::eGeneral, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+       m_image.get(), vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, this->getLevelCount(), 0, 1)},
+      // Depth resolves are performed in the color attachment output stage.
+      {vk::PipelineStageFlagBits2::eLateFragmentTests | vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+       vk::AccessFlagBits2::eDepthStencilAttachmentWrite | vk::AccessFlagBits2::eColorAttachmentWrite,
+       vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderSampledRead,
+       vk::ImageLayout::eDepthAttachmentOptimal, vk::ImageLayout::eDepthReadOnlyOptimal, VK_QUEUE_FAMILY_IGNORED,
+       VK_QUEUE_FAMILY_IGNORED, p_depthImage, depthRange}};
+  p_cmdBuffer.pipelineBarrier2({{}, {}, {}, preBuildBarriers});
+
+  p_cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_pipeline.get());
+  vk::MemoryBarrier2 levelBarrier(vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageWrite,
+                                  vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderSampledRead);
+  for (uint32_t level = 0; level < this->getLevelCount(); ++level) {
+    if (level != 0) {
+      p_cmdBuffer.pipelineBarrier2({{}, levelBarrier});
+    }
+    vk::DescriptorSet descriptorSet =
+        level == 0 ? this->getDepthDescriptorSet(p_depthView) : m_levelDescriptorSets[level];
+    p_cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_pipelineLayout.get(), 0, descriptorSet, {});
+    const vk::Extent2D &sourceExtent = level == 0 ? m_depthExtent : m_levelExtents[level - 1];
+    const vk::Extent2D &destExtent = m_levelExtents[level];
+    LevelConstants constants = {.sourceExtent = {sourceExtent.width, sourceExtent.height},
+                                .destExtent = {destExtent.width, destExtent.height}};
+    p_cmdBuffer.pushConstants(m_pipelineLayout.get(), vk::ShaderStageFlagBits::eCompute, 0, sizeof(constants),
+                              &constants);
+    p_cmdBuffer.dispatch((destExtent.width + 7) / 8, (destExtent.height + 7) / 8, 1);
+  }
+
+  std::vector<vk::ImageMemoryBarrier2> postBuildBarriers = {
+      {vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageWrite,
+       vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderSampledRead,
+       vk::ImageLayout::eGeneral, vk::ImageLayout::eGeneral, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+       m_image.get(), vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, this->getLevelCount(), 0, 1)},
+      {vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eNone,
+       vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+       vk::AccessFlagBits2::eDepthStencilAttachmentWrite | vk::AccessFlagBits2::eColorAttachmentWrite,
+       vk::ImageLayout::eDepthReadOnlyOptimal, vk::ImageLayout::eDepthAttachmentOptimal, VK_QUEUE_FAMILY_IGNORED,
+       VK_QUEUE_FAMILY_IGNORED, p_depthImage, depthRange}};
+  p_cmdBuffer.pipelineBarrier2({{}, {}, {}, postBuildBarriers});
+}
+} // namespace xrmg
@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "DeviceMemoryAllocator.hpp"
+
+#include "Renderer.hpp"
+
+namespace xrmg {
+// Takes the first free range fitting the aligned size; returns its aligned offset.
+static std::optional<vk::DeviceSize> takeFreeRange(std::map<vk::DeviceSize, vk::DeviceSize> &p_freeRanges,
+                                                   vk::DeviceSize p_size, vk::DeviceSize p_alignment) {
+  for (auto it = p_freeRanges.begin(); it != p_freeRanges.end(); ++it) {
+    auto [offset, rangeSize] = *it;
+    vk::DeviceSize alignedOffset = XRMG_ALIGN(offset, p_alignment);
+    if (alignedOffset + p_size <= offset + rangeSize) {
+      p_freeRanges.erase(it);
+      if (offset < alignedOffset) {
+        p_freeRanges.emplace(offset, alignedOffset - offset);
+      }
+      if (alignedOffset + p_size < offset + rangeSize) {
+        p_freeRanges.emplace(alignedOffset + p_size, offset + rangeSize - alignedOffset - p_size);
+      }
+      return alignedOffset;
+    }
+  }
+  return {};
+}
+
+DeviceMemoryAllocator::Allocation &DeviceMemoryAllocator::Allocation::operator=(Allocation &&p_other) noexcept {
+  if (this != &p_other) {
+    this->release();
+    m_allocator = std::exchange(p_other.m_allocator, nullptr);
+    m_block = std::exchange(p_other.m_block, nullptr);
+    m_memory = std::exchange(p_other.m_memory, nullptr);
+    m_dedicatedMemory = std::move(p_other.m_dedicatedMemory);
+    m_offset = p_other.m_offset;
+    m_size = p_other.m_size;
+  }
+  return *this;
+}
+
+void DeviceMemoryAllocator::Allocation::release() {
+  if (m_allocator) {
+    m_allocator->free(*this);
+    m_allocator = nullptr;
+  }
+}
+
+DeviceMemoryAllocator::DeviceMemoryAllocator(const Renderer &p_renderer) : m_renderer(p_renderer) {}
+
+DeviceMemoryAllocator::Allocation DeviceMemoryAllocator::allocateBufferMemory(vk::Buffer p_buffer,
+                                                                              uint32_t p_memTypeIndex,
+                                                                              uint32_t p_deviceMask) {
+  vk::Device device = m_renderer.vkDevice();
+  auto memReqs =
+      device.getBufferMemoryRequirements2<vk::MemoryRequirements2, vk::MemoryDedicatedRequirements>({p_buffer});
+  const vk::MemoryDedicatedRequirements &dedicatedReqs = memReqs.get<vk::MemoryDedicatedRequirements>();
+  Allocation allocation =
+      this->allocate(memReqs.get<vk::MemoryRequirements2>().memoryRequirements,
+                     dedicatedReqs.prefersDedicatedAllocation, {p_memTypeIndex, p_deviceMask, false}, p_buffer, {});
+  device.bindBufferMemory(p_buffer, allocation.getMemory(), allocation.getOffset());
+  return allocation;
+}
+
+DeviceMemoryAllocator::Allocation DeviceMemoryAllocator::allocateImageMemory(vk::Image p_image,
+                                                                             uint32_t p_memTypeIndex,
+                                                                             uint32_t p_deviceMask) {
+  vk::Device device = m_renderer.vkDevice();
+  auto memReqs =
+      device.getImageMemoryRequirements2<vk::MemoryRequirements2, vk::MemoryDedicatedRequirements>({p_image});
+  const vk::MemoryDedicatedRequirements &dedicatedReqs = memReqs.get<vk::MemoryDedicatedRequirements>();
+  Allocation allocation =
+      this->allocate(memReqs.get<vk::MemoryRequirements2>().memoryRequirements,
+                     dedicatedReqs.prefersDedicatedAllocation, {p_memTypeIndex, p_deviceMask, true}, {}, p_image);
+  vk::BindImageMemoryInfo bindInfo(p_image, allocation.getMemory(), allocation.getOffset());
+  device.bindImageMemory2(bindInfo);
+  return allocation;
+}
+
+DeviceMemoryAllocator::Allocation DeviceMemoryAllocator::allocate(const vk::MemoryRequirements &p_memReqs,
+                                                                  bool p_dedicated, const PoolKey &p_key,
+                                                                  vk::Buffer p_buffer, vk::Image p_image) {
+  XRMG_ASSERT(p_memReqs.memoryTypeBits & (1u << std::get<0>(p_key)), "Memory type {} not supported by resource.",
+              std::get<0>(p_key));
+  Allocation allocation;
+  allocation.m_allocator = this;
+  allocation.m_size = p_memReqs.size;
+  // Large resources would take most of a block, and the driver may prefer dedicated memory, e.g. for render targets.
+  if (p_dedicated || BLOCK_SIZE / 2 < p_memReqs.size) {
+    allocation.m_dedicatedMemory = this->allocateMemoryObject(p_memReqs.size, p_key, p_buffer, p_image);
+    allocation.m_memory = allocation.m_dedicatedMemory.get();
+  } else {
+    std::vector<std::unique_ptr<Block>> &blocks = m_pools[p_key];
+    for (const std::unique_ptr<Block> &block : blocks) {
+      std::optional<vk::DeviceSize> offset = takeFreeRange(block->freeRanges, p_memReqs.size, p_memReqs.alignment);
+      if (offset) {
+        allocation.m_block = block.get();
+        allocation.m_offset = offset.value();
+        break;
+      }
+    }
+    if (!allocation.m_block) {
+      Block &block = *blocks.emplace_back(
+          std::make_unique<Block>(Block{.key = p_key,
+                                        .memory = this->allocateMemoryObject(BLOCK_SIZE, p_key, {}, {}),
+                                        .freeRanges = {{0, BLOCK_SIZE}}}));
+      allocation.m_block = &block;
+      allocation.m_offset = takeFreeRange(block.freeRanges, p_memReqs.size, p_memReqs.alignment).value();
+    }
+    allocation.m_memory = allocation.m_block->memory.get();
+  }
+  m_liveSize += p_memReqs.size;
+  m_peakLiveSize = std::max(m_peakLiveSize, m_liveSize);
+  ++m_allocationCount;
+  return allocation;
+}
+
+vk::UniqueDeviceMemory DeviceMemoryAllocator::allocateMemoryObject(vk::DeviceSize p_size, const PoolKey &p_key,
+                                                                   vk::Buffer p_buffer, vk::Image p_image) {
+  vk::StructureChain<vk::MemoryAllocateInfo, vk::MemoryAllocateFlagsInfo, vk::MemoryDedicatedAllocateInfo>
+      allocateInfo({p_size, std::get<0>(p_key)}, {vk::MemoryAllocateFlagBits::eDeviceMask, std::get<1>(p_key)},
+                   {p_image, p_buffer});
+  if (!p_buffer && !p_image) {
+    allocateInfo.unlink<vk::MemoryDedicatedAllocateInfo>();
+  }
+  vk::UniqueDeviceMemory memory = m_renderer.vkDevice().allocateMemoryUnique(allocateInfo.get());
+  m_memoryObjectSize += p_size;
+  ++m_memoryObjectCount;
+  return memory;
+}
+
+void DeviceMemoryAllocator::free(Allocation &p_allocation) {
+  m_liveSize -= p_allocation.m_size;
+  --m_allocationCount;
+  if (!p_allocation.m_block) {
+    p_allocation.m_dedicatedMemory.reset();
+    m_memoryObjectSize -= p_allocation.m_size;
+    --m_memoryObjectCount;
+    return;
+  }
+  // The range is merged with the free ranges right after and before it.
+  Block &block = *p_allocation.m_block;
+  vk::DeviceSize offset = p_allocation.m_offset;
+  vk::DeviceSize size = p_allocation.m_size;
+  auto next = block.freeRanges.lower_bound(offset);
+  if (next != block.freeRanges.end() && offset + size == next->first) {
+    size += next->second;
+    next = block.freeRanges.erase(next);
+  }
+  if (next != block.freeRanges.begin() && std::prev(next)->first + std::prev(next)->second == offset) {
+    std::prev(next)->second += size;
+  } else {
+    block.freeRanges.emplace(offset, size);
+  }
+  // Empty blocks are released unless they're the last one of their pool.
+  std::vector<std::unique_ptr<Block>> &blocks = m_pools[block.key];
+  if (1 < blocks.size() && block.freeRanges.size() == 1 && block.freeRanges.begin()->second == BLOCK_SIZE) {
+    std::erase_if(blocks, [&](const std::unique_ptr<Block> &p_block) { return p_block.get() == &block; });
+    m_memoryObjectSize -= BLOCK_SIZE;
+    --m_memoryObjectCount;
+  }
+}
+
+void DeviceMemoryAllocator::logStatistics() const {
+  vk::DeviceSize freeSize = 0;
+  vk::DeviceSize largestFreeSize = 0;
+  for (const auto &[key, blocks] : m_pools) {
+    for (const std::unique_ptr<Block> &block : blocks) {
+      for (const auto &[offset, size] : block->freeRanges) {
+        freeSize += size;
+        largestFreeSize = std::max(largestFreeSize, size);
+      }
+    }
+  }
+  float fragmentation =
+      freeSize == 0 ? 0.0f : 1.0f - static_cast<float>(largestFreeSize) / static_cast<float>(freeSize);
+  XRMG_INFO("Device memory: {} allocations of {} (peak {}) in {} memory objects of {}, {:.0f}% of free block memory "
+            "fragmented",
+            m_allocationCount, formatByteSize(m_liveSize), formatByteSize(m_peakLiveSize), m_memoryObjectCount,
+            formatByteSize(m_memoryObjectSize), 100.0f * fragmentation);
+}
+} // namespace xrmg
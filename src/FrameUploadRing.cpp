@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "FrameUploadRing.hpp"
+
+#include "Renderer.hpp"
+
+namespace xrmg {
+FrameUploadRing::FrameUploadRing(const Renderer &p_renderer, uint32_t p_memTypeIndex, vk::BufferUsageFlags p_usage)
+    : m_renderer(p_renderer), m_memTypeIndex(p_memTypeIndex), m_usage(p_usage),
+      m_current(this->createRingBuffer(MIN_CAPACITY)) {}
+
+FrameUploadRing::RingBuffer FrameUploadRing::createRingBuffer(vk::DeviceSize p_capacity) const {
+  vk::Device device = m_renderer.vkDevice();
+  RingBuffer ringBuffer;
+  ringBuffer.capacity = p_capacity;
+  ringBuffer.buffer = device.createBufferUnique({{}, p_capacity, m_usage, vk::SharingMode::eExclusive, {}});
+  vk::MemoryRequirements memReqs = device.getBufferMemoryRequirements(ringBuffer.buffer.get());
+  XRMG_ASSERT(memReqs.memoryTypeBits & (1u << m_memTypeIndex), "Memory type {} not supported by the upload ring.",
+              m_memTypeIndex);
+  ringBuffer.memory = device.allocateMemoryUnique({memReqs.size, m_memTypeIndex});
+  device.bindBufferMemory(ringBuffer.buffer.get(), ringBuffer.memory.get(), 0);
+  ringBuffer.mapped = reinterpret_cast<char *>(device.mapMemory(ringBuffer.memory.get(), 0, p_capacity));
+  return ringBuffer;
+}
+
+std::optional<vk::DeviceSize> FrameUploadRing::findSpace(vk::DeviceSize p_size, vk::DeviceSize p_alignment) const {
+  vk::DeviceSize offset = XRMG_ALIGN(m_head, p_alignment);
+  if (m_frameEnds.empty()) {
+    return p_size <= m_current.capacity ? std::optional<vk::DeviceSize>(0) : std::nullopt;
+  } else if (m_head < m_tail) {
+    if (offset + p_size < m_tail) {
+      return offset;
+    }
+  } else if (offset + p_size <= m_current.capacity) {
+    return offset;
+  } else if (p_size < m_tail) {
+    return 0;
+  }
+  return {};
+}
+
+FrameUploadRing::Allocation FrameUploadRing::allocate(uint64_t p_frameIndex, vk::DeviceSize p_size,
+                                                      vk::DeviceSize p_alignment) {
+  XRMG_ASSERT(m_frameEnds.empty() || m_frameEnds.back().first <= p_frameIndex, "Allocation for a past frame.");
+  if (p_size == 0) {
+    return {m_current.buffer.get(), 0, m_current.mapped};
+  }
+  std::optional<vk::DeviceSize> offset = this->findSpace(p_size, p_alignment);
+  if (!offset) {
+    // The allocations of the frames in flight stay in the replaced buffer, which is retired with the current frame.
+    vk::DeviceSize capacity = 2 * m_current.capacity;
+    while (capacity < 2 * p_size) {
+      capacity *= 2;
+    }
+    m_retiredBuffers.emplace_back(p_frameIndex, std::move(m_current));
+    m_current = this->createRingBuffer(capacity);
+    m_head = 0;
+    m_tail = 0;
+    m_frameEnds.clear();
+    offset = 0;
+    XRMG_INFO("Frame upload ring grown to {}.", formatByteSize(m_current.capacity));
+  }
+  if (m_frameEnds.empty()) {
+    m_tail = offset.value();
+  }
+  m_head = offset.value() + p_size;
+  if (m_frameEnds.empty() || m_frameEnds.back().first != p_frameIndex) {
+    m_frameEnds.emplace_back(p_frameIndex, m_head);
+  } else {
+    m_frameEnds.back().second = m_head;
+  }
+  return {m_current.buffer.get(), offset.value(), m_current.mapped + offset.value()};
+}
+
+void FrameUploadRing::release(uint64_t p_finishedFrameIndex) {
+  while (!m_frameEnds.empty() && m_frameEnds.front().first <= p_finishedFrameIndex) {
+    m_tail = m_frameEnds.front().second;
+    m_frameEnds.pop_front();
+  }
+  if (m_frameEnds.empty()) {
+    m_head = 0;
+    m_tail = 0;
+  }
+  std::erase_if(m_retiredBuffers, [&](const std::pair<uint64_t, RingBuffer> &p_retired) {
+    return p_retired.first <= p_finishedFrameIndex;
+  });
+}
+} // namespace xrmg
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "FrustumCuller.hpp"
+
+#include <bit>
+#include <emmintrin.h>
+#include <limits>
+
+namespace xrmg {
+FrustumCuller::Frustum FrustumCuller::createFrustum(const Mat4x4f &p_viewProjection, const Vec4f &p_clipBounds) {
+  auto combine = [&](uint32_t p_row, float p_sign, float p_bound) {
+    Vec4f plane;
+    for (uint32_t i = 0; i < 4; ++i) {
+      plane.values[i] = p_sign * (p_viewProjection.v[p_row][i] - p_bound * p_viewProjection.v[3][i]);
+    }
+    float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+    return Vec4f{plane.x / length, plane.y / length, plane.z / length, plane.w / length};
+  };
+  Frustum frustum = {.planes = {combine(0, 1.0f, p_clipBounds.x), combine(0, -1.0f, p_clipBounds.z),
+                                combine(1, 1.0f, p_clipBounds.y), combine(1, -1.0f, p_clipBounds.w),
+                                combine(2, 1.0f, 0.0f), combine(2, -1.0f, 1.0f)}};
+  Mat4x4f clipToWorld = p_viewProjection.invert();
+  for (uint32_t i = 0; i < 8; ++i) {
+    float x = i & 1 ? p_clipBounds.z : p_clipBounds.x;
+    float y = i & 2 ? p_clipBounds.w : p_clipBounds.y;
+    float z = i & 4 ? 1.0f : 0.0f;
+    float w = clipToWorld.v[3][0] * x + clipToWorld.v[3][1] * y + clipToWorld.v[3][2] * z + clipToWorld.v[3][3];
+    frustum.corners[i] = clipToWorld.transformCoord({x, y, z}) / w;
+  }
+  return frustum;
+}
+
+FrustumCuller::Planes FrustumCuller::createUnion(const std::vector<Frustum> &p_frusta) {
+  XRMG_ASSERT(!p_frusta.empty(), "The union of no frusta is empty.");
+  Planes planes;
+  for (uint32_t side = 0; side < 6; ++side) {
+    float minShift = std::numeric_limits<float>::infinity();
+    for (const Frustum &candidate : p_frusta) {
+      const Vec4f &plane = candidate.planes[side];
+      float shift = 0.0f;
+      for (const Frustum &frustum : p_frusta) {
+        for (const Vec3f &corner : frustum.corners) {
+          shift = std::max(shift, -(plane.x * corner.x + plane.y * corner.y + plane.z * corner.z + plane.w));
+        }
+      }
+      if (shift < minShift) {
+        minShift = shift;
+        planes[side] = {plane.x, plane.y, plane.z, plane.w + shift};
+      }
+    }
+  }
+  return planes;
+}
+
+void FrustumCuller::clear() {
+  m_centerX.clear();
+  m_centerY.clear();
+  m_centerZ.clear();
+  m_radius.clear();
+  m_sphereCount = 0;
+}
+
+void FrustumCuller::pushSphere(const Vec3f &p_center, float p_radius) {
+  if (m_sphereCount % 4 == 0) {
+    m_centerX.resize(m_sphereCount + 4, 0.0f);
+    m_centerY.resize(m_sphereCount + 4, 0.0f);
+    m_centerZ.resize(m_sphereCount + 4, 0.0f);
+    m_radius.resize(m_sphereCount + 4, -std::numeric_limits<float>::infinity());
+  }
+  m_centerX[m_sphereCount] = p_center.x;
+  m_centerY[m_sphereCount] = p_center.y;
+  m_centerZ[m_sphereCount] = p_center.z;
+  m_radius[m_sphereCount] = p_radius;
+  ++m_sphereCount;
+}
+
+void FrustumCuller::cull(const Planes &p_planes, std::vector<uint32_t> &p_visibleIndices) const {
+  std::array<__m128, 6> planeX, planeY, planeZ, planeW;
+  for (uint32_t i = 0; i < 6; ++i) {
+    planeX[i] = _mm_set1_ps(p_planes[i].x);
+    planeY[i] = _mm_set1_ps(p_planes[i].y);
+    planeZ[i] = _mm_set1_ps(p_planes[i].z);
+    planeW[i] = _mm_set1_ps(p_planes[i].w);
+  }
+  for (uint32_t base = 0; base < m_sphereCount; base += 4) {
+    __m128 x = _mm_loadu_ps(&m_centerX[base]);
+    __m128 y = _mm_loadu_ps(&m_centerY[base]);
+    __m128 z = _mm_loadu_ps(&m_centerZ[base]);
+    __m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&m_radius[base]));
+    // A sphere is visible unless it lies completely behind one of the planes.
+    __m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (uint32_t i = 0; i < 6; ++i) {
+      __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[i], x), _mm_mul_ps(planeY[i], y)),
+                                   _mm_add_ps(_mm_mul_ps(planeZ[i], z), planeW[i]));
+      visible = _mm_and_ps(visible, _mm_cmpge_ps(distance, negRadius));
+    }
+    for (auto mask = static_cast<uint32_t>(_mm_movemask_ps(visible)); mask != 0; mask &= mask - 1) {
+      p_visibleIndices.push_back(base + static_cast<uint32_t>(std::countr_zero(mask)));
+    }
+  }
+}
+} // namespace xrmg
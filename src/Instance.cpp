@@ -19,8 +19,17 @@
 #include "Instance.hpp"
 
 namespace xrmg {
+Mat4x4f Instance::getTransform() const {
+  Mat4x4f transform = Mat4x4f::IDENTITY;
+  for (uint32_t i = 0; i < 3; ++i) {
+    transform.rows[i] = modelToWorld[i];
+  }
+  return transform;
+}
+
 void Instance::setTransform(const Mat4x4f &p_modelToWorld) {
-  modelToWorld = p_modelToWorld;
-  modelToWorldIT = p_modelToWorld.invert().transpose();
+  for (uint32_t i = 0; i < 3; ++i) {
+    modelToWorld[i] = p_modelToWorld.rows[i];
+  }
 }
 } // namespace xrmg
\ No newline at end of file
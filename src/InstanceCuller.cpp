@@ -0,0 +1,298 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "InstanceCuller.hpp"
+
+#include "App.hpp"
+#include "Instance.hpp"
+#include "Renderer.hpp"
+
+#include "shaders.hpp"
+
+namespace xrmg {
+static_assert(sizeof(Instance) == 60, "The cull shader expects tightly packed instances of 60 bytes.");
+
+// The early and late draw commands are followed by the count of occlusion candidates.
+static const vk::DeviceSize g_candidateCountOffset =
+    InstanceCuller::LATE_DRAW_COMMAND_OFFSET + sizeof(vk::DrawIndexedIndirectCommand);
+static const vk::DeviceSize g_drawCommandsSize = g_candidateCountOffset + sizeof(uint32_t);
+
+struct CullConstants {
+  Vec4f boundingSphere;
+  uint32_t instanceCount;
+  uint32_t phase;
+  uint32_t indexed;
+  uint32_t depthPyramidLevelCount;
+  uint32_t depthExtent[2];
+  uint32_t firstInstance;
+  uint32_t drawCommandOffset;
+};
+
+InstanceCuller::InstanceCuller(const Renderer &p_renderer, vk::Buffer p_cameraBuffer, vk::DeviceSize p_cameraSize)
+    : m_renderer(p_renderer), m_cameraBuffer(p_cameraBuffer), m_cameraSize(p_cameraSize),
+      m_statisticsBatches(MAX_QUEUED_FRAMES * p_renderer.getPhysicalDeviceCount(), {UINT64_MAX, {}}) {
+  std::vector<vk::DescriptorSetLayoutBinding> bindings = {
+      {0, vk::DescriptorType::eUniformBufferDynamic, 1, vk::ShaderStageFlagBits::eCompute},
+      {1, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute},
+      {2, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute},
+      {3, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute},
+      {4, vk::DescriptorType::eUniformBufferDynamic, 1, vk::ShaderStageFlagBits::eCompute},
+      {5, vk::DescriptorType::eSampledImage, 1, vk::ShaderStageFlagBits::eCompute},
+      {6, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute}};
+  m_descriptorSetLayout = p_renderer.vkDevice().createDescriptorSetLayoutUnique({{}, bindings});
+  vk::PushConstantRange constantsRange(vk::ShaderStageFlagBits::eCompute, 0, sizeof(CullConstants));
+  m_pipelineLayout =
+      p_renderer.vkDevice().createPipelineLayoutUnique({{}, m_descriptorSetLayout.get(), constantsRange});
+
+  vk::UniqueShaderModule cullModule = p_renderer.vkDevice().createShaderModuleUnique({{}, g_cullSrc});
+  vk::ComputePipelineCreateInfo pipelineCreateInfo(
+      {}, {{}, vk::ShaderStageFlagBits::eCompute, cullModule.get(), "cs"}, m_pipelineLayout.get());
+  auto [createPipelineResult, pipeline] =
+      p_renderer.vkDevice().createComputePipelineUnique(p_renderer.getPipelineCache(), pipelineCreateInfo);
+  XRMG_ASSERT(createPipelineResult == vk::Result::eSuccess, "Pipeline creation failed.");
+  m_pipeline = std::move(pipeline);
+
+  // An instance arena is resized at most once per frame, and its replaced descriptor sets are kept until the frame
+  // they were replaced before is finished. There are no more arenas than triangle meshes.
+  uint32_t maxDescriptorSetCount = (MAX_QUEUED_FRAMES + 2) * MAX_TRIANGLE_MESH_COUNT;
+  std::vector<vk::DescriptorPoolSize> poolSizes = {
+      {vk::DescriptorType::eUniformBufferDynamic, 2 * maxDescriptorSetCount},
+      {vk::DescriptorType::eStorageBuffer, 4 * maxDescriptorSetCount},
+      {vk::DescriptorType::eSampledImage, maxDescriptorSetCount}};
+  m_descriptorPool = p_renderer.vkDevice().createDescriptorPoolUnique(
+      {vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet, maxDescriptorSetCount, poolSizes});
+  // The cull shader always binds the pyramid, even if only the frustum phase is used.
+  m_depthPyramid = std::make_unique<DepthPyramid>(p_renderer);
+
+  m_drawCommandBuffer = p_renderer.vkDevice().createBufferUnique(
+      {{},
+       MAX_TRIANGLE_MESH_COUNT * g_drawCommandsSize,
+       vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eStorageBuffer |
+           vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc,
+       vk::SharingMode::eExclusive,
+       {}});
+  vk::MemoryRequirements commandMemReqs = p_renderer.vkDevice().getBufferMemoryRequirements(m_drawCommandBuffer.get());
+  std::optional<uint32_t> commandMemTypeIndex = p_renderer.queryCompatibleMemoryTypeIndex(
+      0, vk::MemoryPropertyFlagBits::eDeviceLocal, commandMemReqs.memoryTypeBits);
+  XRMG_ASSERT(commandMemTypeIndex, "No device local memory type for draw commands available.");
+  m_drawCommandMemory = p_renderer.vkDevice().allocateMemoryUnique({commandMemReqs.size, commandMemTypeIndex.value()});
+  p_renderer.vkDevice().bindBufferMemory(m_drawCommandBuffer.get(), m_drawCommandMemory.get(), 0);
+
+  vk::DeviceSize statisticsSize =
+      MAX_QUEUED_FRAMES * p_renderer.getPhysicalDeviceCount() * MAX_TRIANGLE_MESH_COUNT * g_drawCommandsSize;
+  m_statisticsBuffer = p_renderer.vkDevice().createBufferUnique(
+      {{}, statisticsSize, vk::BufferUsageFlagBits::eTransferDst, vk::SharingMode::eExclusive, {}});
+  vk::MemoryRequirements statisticsMemReqs =
+      p_renderer.vkDevice().getBufferMemoryRequirements(m_statisticsBuffer.get());
+  std::optional<uint32_t> statisticsMemTypeIndex = p_renderer.queryCompatibleMemoryTypeIndex(
+      0, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+      statisticsMemReqs.memoryTypeBits);
+  XRMG_ASSERT(statisticsMemTypeIndex, "No host visible and coherent memory type for culling statistics available.");
+  m_statisticsMemory =
+      p_renderer.vkDevice().allocateMemoryUnique({statisticsMemReqs.size, statisticsMemTypeIndex.value()});
+  m_mappedStatistics = reinterpret_cast<const char *>(
+      p_renderer.vkDevice().mapMemory(m_statisticsMemory.get(), 0, statisticsMemReqs.size));
+  p_renderer.vkDevice().bindBufferMemory(m_statisticsBuffer.get(), m_statisticsMemory.get(), 0);
+}
+
+void InstanceCuller::addInstanceArena() {
+  XRMG_ASSERT(m_culledArenas.size() < MAX_TRIANGLE_MESH_COUNT, "Too many instance arenas for culling.");
+  m_culledArenas.emplace_back();
+}
+
+void InstanceCuller::resizeInstanceArena(uint32_t p_arenaIndex, vk::Buffer p_instanceBuffer, uint32_t p_capacity) {
+  if (m_culledArenas[p_arenaIndex].descriptorSet) {
+    m_retiredArenas.emplace_back(g_app->getCurrentFrameIndex(), std::move(m_culledArenas[p_arenaIndex]));
+  }
+  CulledArena &culledArena = m_culledArenas[p_arenaIndex];
+  culledArena = {};
+  if (p_capacity == 0) {
+    return;
+  }
+  vk::DeviceSize visibleInstanceSize = p_capacity * sizeof(Instance);
+  vk::DeviceSize candidateSize = p_capacity * sizeof(uint32_t);
+  culledArena.visibleInstanceBuffer = m_renderer.vkDevice().createBufferUnique(
+      {{},
+       visibleInstanceSize,
+       vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eStorageBuffer,
+       vk::SharingMode::eExclusive,
+       {}});
+  culledArena.candidateBuffer = m_renderer.vkDevice().createBufferUnique(
+      {{}, candidateSize, vk::BufferUsageFlagBits::eStorageBuffer, vk::SharingMode::eExclusive, {}});
+  vk::MemoryRequirements instanceMemReqs =
+      m_renderer.vkDevice().getBufferMemoryRequirements(culledArena.visibleInstanceBuffer.get());
+  vk::MemoryRequirements candidateMemReqs =
+      m_renderer.vkDevice().getBufferMemoryRequirements(culledArena.candidateBuffer.get());
+  std::optional<uint32_t> memTypeIndex = m_renderer.queryCompatibleMemoryTypeIndex(
+      0, vk::MemoryPropertyFlagBits::eDeviceLocal, instanceMemReqs.memoryTypeBits & candidateMemReqs.memoryTypeBits);
+  XRMG_ASSERT(memTypeIndex, "No device local memory type for culling results available.");
+  vk::DeviceSize candidateOffset = XRMG_ALIGN(instanceMemReqs.size, candidateMemReqs.alignment);
+  culledArena.memory =
+      m_renderer.vkDevice().allocateMemoryUnique({candidateOffset + candidateMemReqs.size, memTypeIndex.value()});
+  m_renderer.vkDevice().bindBufferMemory(culledArena.visibleInstanceBuffer.get(), culledArena.memory.get(), 0);
+  m_renderer.vkDevice().bindBufferMemory(culledArena.candidateBuffer.get(), culledArena.memory.get(), candidateOffset);
+
+  culledArena.descriptorSet = std::move(
+      m_renderer.vkDevice()
+          .allocateDescriptorSetsUnique({m_descriptorPool.get(), m_descriptorSetLayout.get()})
+          .front());
+  vk::DescriptorBufferInfo cameraInfo(m_cameraBuffer, 0, m_cameraSize);
+  vk::DescriptorBufferInfo instanceInfo(p_instanceBuffer, 0, visibleInstanceSize);
+  vk::DescriptorBufferInfo visibleInstanceInfo(culledArena.visibleInstanceBuffer.get(), 0, visibleInstanceSize);
+  vk::DescriptorBufferInfo commandInfo(m_drawCommandBuffer.get(), 0, VK_WHOLE_SIZE);
+  vk::DescriptorImageInfo depthPyramidInfo({}, m_depthPyramid->getImageView(), vk::ImageLayout::eGeneral);
+  vk::DescriptorBufferInfo candidateInfo(culledArena.candidateBuffer.get(), 0, candidateSize);
+  vk::DescriptorSet descriptorSet = culledArena.descriptorSet.get();
+  std::vector<vk::WriteDescriptorSet> writes = {
+      {descriptorSet, 0, 0, vk::DescriptorType::eUniformBufferDynamic, {}, cameraInfo},
+      {descriptorSet, 1, 0, vk::DescriptorType::eStorageBuffer, {}, instanceInfo},
+      {descriptorSet, 2, 0, vk::DescriptorType::eStorageBuffer, {}, visibleInstanceInfo},
+      {descriptorSet, 3, 0, vk::DescriptorType::eStorageBuffer, {}, commandInfo},
+      {descriptorSet, 4, 0, vk::DescriptorType::eUniformBufferDynamic, {}, cameraInfo},
+      {descriptorSet, 5, 0, vk::DescriptorType::eSampledImage, depthPyramidInfo},
+      {descriptorSet, 6, 0, vk::DescriptorType::eStorageBuffer, {}, candidateInfo}};
+  m_renderer.vkDevice().updateDescriptorSets(writes, {});
+}
+
+void InstanceCuller::releaseRetiredArenas(uint64_t p_finishedFrameIndex) {
+  std::erase_if(m_retiredArenas, [&](const std::pair<uint64_t, CulledArena> &p_retired) {
+    return p_retired.first <= p_finishedFrameIndex;
+  });
+}
+
+vk::DeviceSize InstanceCuller::getDrawCommandOffset(uint32_t p_triMeshIndex) const {
+  return p_triMeshIndex * g_drawCommandsSize;
+}
+
+void InstanceCuller::cull(vk::CommandBuffer p_cmdBuffer, Phase p_phase, uint32_t p_cameraOffset,
+                          uint32_t p_occlusionCameraOffset, const std::vector<Batch> &p_batches) const {
+  if (p_phase == Phase::LATE) {
+    // The late phase appends to the results of the early one, which its draws may still be reading.
+    vk::MemoryBarrier2 preCullBarrier(
+        vk::PipelineStageFlagBits2::eComputeShader | vk::PipelineStageFlagBits2::eDrawIndirect |
+            vk::PipelineStageFlagBits2::eVertexAttributeInput,
+        vk::AccessFlagBits2::eShaderStorageWrite, vk::PipelineStageFlagBits2::eComputeShader,
+        vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite);
+    p_cmdBuffer.pipelineBarrier2({{}, preCullBarrier});
+  } else {
+    // The previous frame's draws and statistics copies must be done reading the results before they are reset.
+    vk::MemoryBarrier2 preResetBarrier(
+        vk::PipelineStageFlagBits2::eDrawIndirect | vk::PipelineStageFlagBits2::eVertexAttributeInput |
+            vk::PipelineStageFlagBits2::eTransfer,
+        vk::AccessFlagBits2::eNone, vk::PipelineStageFlagBits2::eTransfer | vk::PipelineStageFlagBits2::eComputeShader,
+        vk::AccessFlagBits2::eNone);
+    p_cmdBuffer.pipelineBarrier2({{}, preResetBarrier});
+    for (const Batch &batch : p_batches) {
+      // The instance counts of the early and late draw commands and the candidate count are accumulated by the cull
+      // shader, which also places the late visible instances behind the early ones.
+      uint32_t elementCount = batch.triMesh->getElementCount();
+      std::array<uint32_t, g_drawCommandsSize / sizeof(uint32_t)> drawCommands = {elementCount, 0, 0, 0, 0,
+                                                                                   elementCount, 0, 0, 0, 0, 0};
+      drawCommands[batch.triMesh->hasIndices() ? 4 : 3] = batch.firstInstance;
+      p_cmdBuffer.updateBuffer(m_drawCommandBuffer.get(), this->getDrawCommandOffset(batch.triMeshIndex),
+                               sizeof(drawCommands), drawCommands.data());
+    }
+    // Also covers the instance uploads preceding the culling.
+    vk::MemoryBarrier2 preCullBarrier(
+        vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
+        vk::PipelineStageFlagBits2::eComputeShader,
+        vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite);
+    p_cmdBuffer.pipelineBarrier2({{}, preCullBarrier});
+  }
+
+  p_cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_pipeline.get());
+  const vk::Extent2D &depthExtent = m_depthPyramid->getDepthExtent();
+  for (const Batch &batch : p_batches) {
+    p_cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_pipelineLayout.get(), 0,
+                                   m_culledArenas[batch.arenaIndex].descriptorSet.get(),
+                                   {p_cameraOffset, p_occlusionCameraOffset});
+    auto drawCommandOffset = static_cast<uint32_t>(this->getDrawCommandOffset(batch.triMeshIndex));
+    CullConstants constants = {.boundingSphere = batch.triMesh->getBoundingSphere(),
+                               .instanceCount = batch.instanceCount,
+                               .phase = static_cast<uint32_t>(p_phase),
+                               .indexed = batch.triMesh->hasIndices(),
+                               .depthPyramidLevelCount = m_depthPyramid->getLevelCount(),
+                               .depthExtent = {depthExtent.width, depthExtent.height},
+                               .firstInstance = batch.firstInstance,
+                               .drawCommandOffset = drawCommandOffset};
+    p_cmdBuffer.pushConstants(m_pipelineLayout.get(), vk::ShaderStageFlagBits::eCompute, 0, sizeof(constants),
+                              &constants);
+    // The candidate count is only known on the device, so the late phase covers all instances as well.
+    p_cmdBuffer.dispatch((batch.instanceCount + 63) / 64, 1, 1);
+  }
+
+  vk::MemoryBarrier2 postCullBarrier(
+      vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageWrite,
+      vk::PipelineStageFlagBits2::eDrawIndirect | vk::PipelineStageFlagBits2::eVertexAttributeInput,
+      vk::AccessFlagBits2::eIndirectCommandRead | vk::AccessFlagBits2::eVertexAttributeRead);
+  p_cmdBuffer.pipelineBarrier2({{}, postCullBarrier});
+}
+
+vk::DeviceSize InstanceCuller::getStatisticsOffset(uint64_t p_frameIndex, uint32_t p_physicalDeviceIndex) const {
+  return ((p_frameIndex % MAX_QUEUED_FRAMES) * m_renderer.getPhysicalDeviceCount() + p_physicalDeviceIndex) *
+         MAX_TRIANGLE_MESH_COUNT * g_drawCommandsSize;
+}
+
+void InstanceCuller::writeStatistics(vk::CommandBuffer p_cmdBuffer, uint64_t p_frameIndex,
+                                     uint32_t p_physicalDeviceIndex, const std::vector<Batch> &p_batches) {
+  vk::MemoryBarrier2 preCopyBarrier(vk::PipelineStageFlagBits2::eComputeShader,
+                                    vk::AccessFlagBits2::eShaderStorageWrite, vk::PipelineStageFlagBits2::eTransfer,
+                                    vk::AccessFlagBits2::eTransferRead);
+  p_cmdBuffer.pipelineBarrier2({{}, preCopyBarrier});
+  vk::DeviceSize offset = this->getStatisticsOffset(p_frameIndex, p_physicalDeviceIndex);
+  uint64_t slotIdx = (p_frameIndex % MAX_QUEUED_FRAMES) * m_renderer.getPhysicalDeviceCount() + p_physicalDeviceIndex;
+  auto &[frameIndex, batches] = m_statisticsBatches[slotIdx];
+  frameIndex = p_frameIndex;
+  batches.clear();
+  for (const Batch &batch : p_batches) {
+    p_cmdBuffer.copyBuffer(m_drawCommandBuffer.get(), m_statisticsBuffer.get(),
+                           vk::BufferCopy(this->getDrawCommandOffset(batch.triMeshIndex),
+                                          offset + batch.triMeshIndex * g_drawCommandsSize, g_drawCommandsSize));
+    batches.emplace_back(batch.triMeshIndex, batch.instanceCount);
+  }
+  vk::MemoryBarrier2 postCopyBarrier(vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
+                                     vk::PipelineStageFlagBits2::eHost, vk::AccessFlagBits2::eHostRead);
+  p_cmdBuffer.pipelineBarrier2({{}, postCopyBarrier});
+}
+
+void InstanceCuller::logStatistics(uint64_t p_frameIndex) const {
+  for (uint32_t devIdx = 0; devIdx < m_renderer.getPhysicalDeviceCount(); ++devIdx) {
+    const auto &[frameIndex, batches] =
+        m_statisticsBatches[(p_frameIndex % MAX_QUEUED_FRAMES) * m_renderer.getPhysicalDeviceCount() + devIdx];
+    if (frameIndex != p_frameIndex) {
+      continue;
+    }
+    uint32_t drawnCount = 0;
+    uint32_t outsideCount = 0;
+    uint32_t occludedCount = 0;
+    for (auto [triMeshIdx, instanceCount] : batches) {
+      auto drawCommands = reinterpret_cast<const uint32_t *>(
+          m_mappedStatistics + this->getStatisticsOffset(p_frameIndex, devIdx) + triMeshIdx * g_drawCommandsSize);
+      uint32_t earlyCount = drawCommands[1];
+      uint32_t lateCount = drawCommands[LATE_DRAW_COMMAND_OFFSET / sizeof(uint32_t) + 1];
+      uint32_t candidateCount = drawCommands[g_candidateCountOffset / sizeof(uint32_t)];
+      drawnCount += earlyCount + lateCount;
+      outsideCount += instanceCount - earlyCount - candidateCount;
+      occludedCount += candidateCount - lateCount;
+    }
+    g_app->getProfiler().pushCpuInstant(std::format("device {} culling: {} drawn, {} outside the frustum, {} occluded",
+                                                    devIdx, drawnCount, outsideCount, occludedCount),
+                                        p_frameIndex);
+  }
+}
+} // namespace xrmg
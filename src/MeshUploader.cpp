@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "MeshUploader.hpp"
+
+#include "App.hpp"
+#include "Renderer.hpp"
+
+namespace xrmg {
+MeshUploader::MeshUploader(const Renderer &p_renderer, uint32_t p_queueFamilyIndex, vk::Queue p_queue)
+    : m_renderer(p_renderer), m_queue(p_queue) {
+  vk::Device device = p_renderer.vkDevice();
+  vk::StructureChain<vk::SemaphoreCreateInfo, vk::SemaphoreTypeCreateInfo> semaphoreCreateInfo(
+      {}, {vk::SemaphoreType::eTimeline});
+  m_semaphore = device.createSemaphoreUnique(semaphoreCreateInfo.get());
+
+  m_stagingBuffer = device.createBufferUnique(
+      {{}, STAGING_SIZE, vk::BufferUsageFlagBits::eTransferSrc, vk::SharingMode::eExclusive});
+  vk::MemoryRequirements stagingMemReqs = device.getBufferMemoryRequirements(m_stagingBuffer.get());
+  std::optional<uint32_t> stagingMemTypeIndex = p_renderer.queryCompatibleMemoryTypeIndex(
+      0, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+      stagingMemReqs.memoryTypeBits);
+  XRMG_ASSERT(stagingMemTypeIndex, "No host visible and coherent memory type for the staging ring available.");
+  m_stagingMemory = device.allocateMemoryUnique({stagingMemReqs.size, stagingMemTypeIndex.value()});
+  device.bindBufferMemory(m_stagingBuffer.get(), m_stagingMemory.get(), 0);
+  m_mappedStaging = reinterpret_cast<char *>(device.mapMemory(m_stagingMemory.get(), 0, STAGING_SIZE));
+
+  m_cmdPool = device.createCommandPoolUnique({vk::CommandPoolCreateFlagBits::eTransient, p_queueFamilyIndex});
+}
+
+MeshUploader::~MeshUploader() {
+  // The pending copies still read the staging memory and their command buffers.
+  if (!m_pendingCopies.empty()) {
+    vk::Result waitResult =
+        m_renderer.vkDevice().waitSemaphores({{}, m_semaphore.get(), m_submittedValue}, UINT64_MAX);
+    XRMG_WARN_UNLESS(waitResult == vk::Result::eSuccess, "Waiting for pending uploads failed.");
+  }
+}
+
+uint64_t MeshUploader::upload(vk::Buffer p_buffer, const void *p_data, vk::DeviceSize p_size) {
+  vk::Device device = m_renderer.vkDevice();
+  for (vk::DeviceSize copied = 0; copied < p_size; copied += MAX_COPY_SIZE) {
+    vk::DeviceSize size = std::min(MAX_COPY_SIZE, p_size - copied);
+    vk::DeviceSize offset = this->allocateStaging(size);
+    memcpy(m_mappedStaging + offset, static_cast<const char *>(p_data) + copied, size);
+
+    vk::UniqueCommandBuffer cmdBuffer = std::move(
+        device.allocateCommandBuffersUnique({m_cmdPool.get(), vk::CommandBufferLevel::ePrimary, 1}).front());
+    cmdBuffer->begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+    cmdBuffer->copyBuffer(m_stagingBuffer.get(), p_buffer, {{offset, copied, size}});
+    cmdBuffer->end();
+    vk::CommandBufferSubmitInfo cmdBufferSubmit(cmdBuffer.get(), m_renderer.getDeviceMaskAll());
+    vk::SemaphoreSubmitInfo uploadedSignal(m_semaphore.get(), ++m_submittedValue,
+                                           vk::PipelineStageFlagBits2::eTransfer, 0);
+    m_queue.submit2(vk::SubmitInfo2({}, {}, cmdBufferSubmit, uploadedSignal));
+    m_pendingCopies.push_back({m_submittedValue, offset, offset + size, std::move(cmdBuffer)});
+  }
+  return m_submittedValue;
+}
+
+void MeshUploader::update() {
+  m_finishedValue = m_renderer.vkDevice().getSemaphoreCounterValue(m_semaphore.get());
+  this->releaseFinishedCopies(m_finishedValue);
+}
+
+vk::DeviceSize MeshUploader::allocateStaging(vk::DeviceSize p_size) {
+  this->releaseFinishedCopies(m_renderer.vkDevice().getSemaphoreCounterValue(m_semaphore.get()));
+  for (;;) {
+    if (m_pendingCopies.empty()) {
+      m_stagingHead = p_size;
+      return 0;
+    }
+    // The pending copies read the ring from the oldest one's offset up to the head, possibly wrapping around. The head
+    // never catches up with that offset, so they only coincide with an empty ring.
+    vk::DeviceSize tail = m_pendingCopies.front().offset;
+    std::optional<vk::DeviceSize> offset;
+    if (m_stagingHead < tail) {
+      if (m_stagingHead + p_size < tail) {
+        offset = m_stagingHead;
+      }
+    } else if (m_stagingHead + p_size <= STAGING_SIZE) {
+      offset = m_stagingHead;
+    } else if (p_size < tail) {
+      offset = 0;
+    }
+    if (offset) {
+      m_stagingHead = offset.value() + p_size;
+      return offset.value();
+    }
+    XRMG_SCOPED_INSTRUMENT("wait for staging ring");
+    uint64_t waitValue = m_pendingCopies.front().value;
+    vk::Result waitResult = m_renderer.vkDevice().waitSemaphores({{}, m_semaphore.get(), waitValue}, UINT64_MAX);
+    XRMG_ASSERT(waitResult == vk::Result::eSuccess, "Wait failed.");
+    this->releaseFinishedCopies(waitValue);
+  }
+}
+
+void MeshUploader::releaseFinishedCopies(uint64_t p_finishedValue) {
+  while (!m_pendingCopies.empty() && m_pendingCopies.front().value <= p_finishedValue) {
+    m_pendingCopies.pop_front();
+  }
+}
+} // namespace xrmg
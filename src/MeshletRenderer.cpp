@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "MeshletRenderer.hpp"
+
+#include "App.hpp"
+#include "Instance.hpp"
+#include "Renderer.hpp"
+
+namespace xrmg {
+static_assert(sizeof(Instance) == 60, "The task and mesh shaders expect tightly packed instances of 60 bytes.");
+static_assert(sizeof(TriangleMesh::Meshlet) == 48, "The task and mesh shaders expect meshlets of 48 bytes.");
+
+static const vk::ShaderStageFlags g_meshletStages =
+    vk::ShaderStageFlagBits::eTaskEXT | vk::ShaderStageFlagBits::eMeshEXT;
+// Meshlets tested by each task shader workgroup.
+static const uint32_t g_meshletsPerTask = 32;
+
+struct MeshletConstants {
+  TriangleMesh::PositionBounds positionBounds;
+  uint32_t meshletCount;
+  uint32_t firstInstance;
+  uint32_t vertexIndexOffset;
+  uint32_t triangleOffset;
+};
+
+MeshletRenderer::MeshletRenderer(const Renderer &p_renderer) : m_renderer(p_renderer) {
+  vk::DescriptorSetLayoutBinding arenaBinding(0, vk::DescriptorType::eStorageBuffer, 1, g_meshletStages);
+  m_arenaDescriptorSetLayout = p_renderer.vkDevice().createDescriptorSetLayoutUnique({{}, arenaBinding});
+  std::vector<vk::DescriptorSetLayoutBinding> meshBindings = {
+      {0, vk::DescriptorType::eStorageBuffer, 1, g_meshletStages},
+      {1, vk::DescriptorType::eStorageBuffer, 1, g_meshletStages}};
+  m_meshDescriptorSetLayout = p_renderer.vkDevice().createDescriptorSetLayoutUnique({{}, meshBindings});
+
+  // An instance arena is resized at most once per frame, and its replaced descriptor set is kept until the frame it
+  // was replaced before is finished. There are no more arenas than triangle meshes.
+  uint32_t maxDescriptorSetCount = (MAX_QUEUED_FRAMES + 3) * MAX_TRIANGLE_MESH_COUNT;
+  vk::DescriptorPoolSize poolSize(vk::DescriptorType::eStorageBuffer, 2 * maxDescriptorSetCount);
+  m_descriptorPool = p_renderer.vkDevice().createDescriptorPoolUnique(
+      {vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet, maxDescriptorSetCount, poolSize});
+
+  auto meshShaderProps =
+      p_renderer.getPhysicalDevice(0)
+          .getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceMeshShaderPropertiesEXT>()
+          .get<vk::PhysicalDeviceMeshShaderPropertiesEXT>();
+  m_maxTaskWorkGroupCountY = meshShaderProps.maxTaskWorkGroupCount[1];
+  m_maxTaskWorkGroupTotalCount = meshShaderProps.maxTaskWorkGroupTotalCount;
+}
+
+std::vector<vk::DescriptorSetLayout> MeshletRenderer::getDescriptorSetLayouts() const {
+  return {m_arenaDescriptorSetLayout.get(), m_meshDescriptorSetLayout.get()};
+}
+
+vk::PushConstantRange MeshletRenderer::getPushConstantRange() const {
+  return {g_meshletStages, 0, sizeof(MeshletConstants)};
+}
+
+void MeshletRenderer::addInstanceArena() {
+  XRMG_ASSERT(m_arenaDescriptorSets.size() < MAX_TRIANGLE_MESH_COUNT, "Too many instance arenas for mesh shading.");
+  m_arenaDescriptorSets.emplace_back();
+}
+
+void MeshletRenderer::addTriangleMesh(const TriangleMesh &p_triMesh) {
+  XRMG_ASSERT(m_meshDescriptorSets.size() < MAX_TRIANGLE_MESH_COUNT, "Too many triangle meshes for mesh shading.");
+  XRMG_ASSERT(p_triMesh.hasMeshlets(), "Triangle mesh without meshlets.");
+  m_meshDescriptorSets.push_back(std::move(
+      m_renderer.vkDevice()
+          .allocateDescriptorSetsUnique({m_descriptorPool.get(), m_meshDescriptorSetLayout.get()})
+          .front()));
+  vk::DescriptorSet descriptorSet = m_meshDescriptorSets.back().get();
+  vk::DescriptorBufferInfo vertexInfo(p_triMesh.getVertexBuffer(), 0, VK_WHOLE_SIZE);
+  vk::DescriptorBufferInfo meshletInfo(p_triMesh.getMeshletBuffer(), 0, VK_WHOLE_SIZE);
+  std::vector<vk::WriteDescriptorSet> writes = {
+      {descriptorSet, 0, 0, vk::DescriptorType::eStorageBuffer, {}, vertexInfo},
+      {descriptorSet, 1, 0, vk::DescriptorType::eStorageBuffer, {}, meshletInfo}};
+  m_renderer.vkDevice().updateDescriptorSets(writes, {});
+}
+
+void MeshletRenderer::resizeInstanceArena(uint32_t p_arenaIndex, vk::Buffer p_instanceBuffer, uint32_t p_capacity) {
+  vk::UniqueDescriptorSet &descriptorSet = m_arenaDescriptorSets[p_arenaIndex];
+  if (descriptorSet) {
+    m_retiredArenaDescriptorSets.emplace_back(g_app->getCurrentFrameIndex(), std::move(descriptorSet));
+  }
+  descriptorSet = {};
+  if (p_capacity == 0) {
+    return;
+  }
+  descriptorSet = std::move(
+      m_renderer.vkDevice()
+          .allocateDescriptorSetsUnique({m_descriptorPool.get(), m_arenaDescriptorSetLayout.get()})
+          .front());
+  vk::DescriptorBufferInfo instanceInfo(p_instanceBuffer, 0, p_capacity * sizeof(Instance));
+  m_renderer.vkDevice().updateDescriptorSets(
+      vk::WriteDescriptorSet(descriptorSet.get(), 0, 0, vk::DescriptorType::eStorageBuffer, {}, instanceInfo), {});
+}
+
+void MeshletRenderer::releaseRetiredArenas(uint64_t p_finishedFrameIndex) {
+  std::erase_if(m_retiredArenaDescriptorSets, [&](const std::pair<uint64_t, vk::UniqueDescriptorSet> &p_retired) {
+    return p_retired.first <= p_finishedFrameIndex;
+  });
+}
+
+void MeshletRenderer::draw(vk::CommandBuffer p_cmdBuffer, vk::PipelineLayout p_pipelineLayout, uint32_t p_triMeshIndex,
+                           const TriangleMesh &p_triMesh, uint32_t p_arenaIndex, uint32_t p_firstInstance,
+                           uint32_t p_instanceCount) const {
+  XRMG_WARN_UNLESS(p_triMesh.isUploaded(), "Drawing triangle mesh before it was uploaded.");
+  std::array<vk::DescriptorSet, 2> descriptorSets = {m_arenaDescriptorSets[p_arenaIndex].get(),
+                                                     m_meshDescriptorSets[p_triMeshIndex].get()};
+  p_cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, p_pipelineLayout, FIRST_DESCRIPTOR_SET,
+                                 descriptorSets, {});
+  // Each row of task shader workgroups covers the meshlets of an instance; the rows are split into several draws if
+  // they exceed the limits of a single one.
+  uint32_t taskCountX = (p_triMesh.getMeshletCount() + g_meshletsPerTask - 1) / g_meshletsPerTask;
+  uint32_t maxInstancesPerDraw = std::min(m_maxTaskWorkGroupCountY, m_maxTaskWorkGroupTotalCount / taskCountX);
+  for (uint32_t first = 0; first < p_instanceCount; first += maxInstancesPerDraw) {
+    MeshletConstants constants = {
+        .positionBounds = p_triMesh.getPositionBounds(),
+        .meshletCount = p_triMesh.getMeshletCount(),
+        .firstInstance = p_firstInstance + first,
+        .vertexIndexOffset = static_cast<uint32_t>(p_triMesh.getMeshletVertexOffset()),
+        .triangleOffset = static_cast<uint32_t>(p_triMesh.getMeshletTriangleOffset()),
+    };
+    p_cmdBuffer.pushConstants(p_pipelineLayout, g_meshletStages, 0, sizeof(constants), &constants);
+    p_cmdBuffer.drawMeshTasksEXT(taskCountX, std::min(maxInstancesPerDraw, p_instanceCount - first), 1);
+  }
+}
+} // namespace xrmg
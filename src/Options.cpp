@@ -36,6 +36,9 @@ std::optional<uint32_t> parseUintOption(const std::vector<std::string> &p_args,
 std::optional<std::pair<uint32_t, uint32_t>> parseUint2Option(const std::vector<std::string> &p_args, uint32_t &p_index,
                                                               bool p_required) {
   XRMG_ASSERT(!p_required || p_index + 2 < p_args.size(), "Missing arguments for {}.", p_args[p_index]);
+  if (p_args.size() <= p_index + 2) {
+    return std::nullopt;
+  }
   int32_t x;
   int32_t y;
   try {
@@ -94,6 +97,78 @@ Options::Options(const std::vector<std::string> &p_args) {
       XRMG_INFO("Frame time log interval: {} ms.", frameTimeLogInterval.value());
     } else if (p_args[index] == "--swap-eyes") {
       swapEyes = true;
+    } else if (p_args[index] == "--late-latching") {
+      lateLatching = true;
+      XRMG_INFO("Late latching of the head pose enabled.");
+    } else if (p_args[index] == "--timewarp") {
+      timewarp = true;
+      XRMG_INFO("Rotational reprojection of the final frame enabled.");
+    } else if (p_args[index] == "--quad-views") {
+      quadViews = true;
+    } else if (p_args[index] == "--foveation") {
+      foveation = FoveationCenter::LENS;
+      if (index + 1 < p_args.size() && p_args[index + 1] == "lens") {
+        ++index;
+      } else if (index + 1 < p_args.size() && p_args[index + 1] == "gaze") {
+        foveation = FoveationCenter::MOCK_GAZE;
+        ++index;
+      }
+      XRMG_INFO("Foveated rendering centered on the {}.",
+                foveation.value() == FoveationCenter::LENS ? "lens center" : "mock gaze");
+    } else if (p_args[index] == "--dynamic-resolution") {
+      dynamicResolution = true;
+      XRMG_INFO("Dynamic resolution enabled.");
+    } else if (p_args[index] == "--msaa") {
+      uint32_t samples = parseUintOption(p_args, index, true).value();
+      XRMG_ASSERT(samples == 1 || samples == 2 || samples == 4 || samples == 8,
+                  "Sample count for --msaa must be one of {{1, 2, 4, 8}}.");
+      sampleCount = static_cast<vk::SampleCountFlagBits>(samples);
+      XRMG_INFO("Multisampling with {} samples per pixel.", samples);
+    } else if (p_args[index] == "--vrs") {
+      variableRateShading = parseUint2Option(p_args, index, false).value_or(std::make_pair(50u, 50u));
+      XRMG_ASSERT(variableRateShading.value().second <= 100, "Full rate extrusion of --vrs must not exceed 100%.");
+      XRMG_INFO("Variable rate shading with full rate within {}% of the lens center and below {}% extrusion.",
+                variableRateShading.value().first, variableRateShading.value().second);
+    } else if (p_args[index] == "--half-rate-periphery") {
+      halfRatePeriphery = true;
+    } else if (p_args[index] == "--gpu-culling") {
+      gpuCulling = true;
+    } else if (p_args[index] == "--occlusion-culling") {
+      occlusionCulling = true;
+    } else if (p_args[index] == "--cpu-culling") {
+      cpuCulling = CullingFrustum::VIEW;
+      if (index + 1 < p_args.size() && p_args[index + 1] == "view") {
+        ++index;
+      } else if (index + 1 < p_args.size() && p_args[index + 1] == "stereo") {
+        cpuCulling = CullingFrustum::STEREO;
+        ++index;
+      }
+      XRMG_INFO("CPU culling against {}.",
+                cpuCulling.value() == CullingFrustum::VIEW ? "each device's frustum" : "the union of all frusta");
+    } else if (p_args[index] == "--lod") {
+      lodSegmentPixels = parseUintOption(p_args, index, false).value_or(8);
+      XRMG_ASSERT(lodSegmentPixels.value() != 0, "Segment length of --lod must not be 0.");
+      XRMG_INFO("Torus LOD selection with segments of at least {} pixels.", lodSegmentPixels.value());
+    } else if (p_args[index] == "--mesh-shading") {
+      meshShading = true;
+      XRMG_INFO("Mesh shading of meshlets enabled.");
+    } else if (p_args[index] == "--compact-vertices") {
+      compactVertices = true;
+      XRMG_INFO("Compact vertex encoding enabled.");
+    } else if (p_args[index] == "--triangle-lists") {
+      triangleLists = TriangleOrder::VERTEX_CACHE;
+      if (index + 1 < p_args.size() && p_args[index + 1] == "cache") {
+        ++index;
+      } else if (index + 1 < p_args.size() && p_args[index + 1] == "overdraw") {
+        triangleLists = TriangleOrder::OVERDRAW;
+        ++index;
+      }
+      XRMG_INFO("Triangle lists ordered for {}.", triangleLists.value() == TriangleOrder::VERTEX_CACHE
+                                                      ? "the vertex cache"
+                                                      : "the vertex cache and overdraw");
+    } else if (p_args[index] == "--pipeline-statistics") {
+      pipelineStatistics = true;
+      XRMG_INFO("Pipeline statistics logging enabled.");
     } else if (p_args[index] == "--render-projection-plane") {
       renderProjectionPlane = true;
     } else if (p_args[index] == "--trace-range") {
@@ -120,6 +195,13 @@ Options::Options(const std::vector<std::string> &p_args) {
   XRMG_INFO("Initial torus layer count: {}", initialTorusLayerCount);
   XRMG_INFO_IF(traceRange, "Tracing of frames {} to {} to file {}", traceRange.value().first, traceRange.value().second,
                traceFilePath.string());
+  XRMG_ASSERT(!gpuCulling || !cpuCulling, "--gpu-culling and --cpu-culling must not be set simultaneously.");
+  XRMG_ASSERT(!occlusionCulling || gpuCulling, "--occlusion-culling requires --gpu-culling.");
+  XRMG_ASSERT(!meshShading || !gpuCulling, "--mesh-shading and --gpu-culling must not be set simultaneously.");
+  XRMG_WARN_IF(meshShading && variableRateShading,
+               "Mesh shading keeps fur layers at full rate; --vrs only coarsens the shading outside of its radius.");
+  XRMG_WARN_IF(pipelineStatistics && meshShading,
+               "Mesh shading bypasses the vertex shader; --pipeline-statistics only counts its primitives.");
   XRMG_ASSERT(!monitorIndex || !windowClientAreaSize,
               "Monitor index and window client area size must not be set simultaneously.");
   XRMG_INFO_UNLESS(windowClientAreaSize || monitorIndex, "Using OpenXR for rendering");
@@ -132,7 +214,11 @@ void Options::printUsageAndExit(int32_t p_exitCode) const {
       "  " SAMPLE_NAME " [--device-group <index>] [--simulate <count>] [--windowed [<width> <height>] | --monitor "
       "<index>] [--present-mode <string>] [--frame-time-log-interval <count>] [--trace-range <begin, end> "
       "[--trace-file <path>]] [--base-torus-tesselation <count>] [--base-torus-count <count>] [--torus-layer-count "
-      "<count>]\n\n"
+      "<count>] [--late-latching] [--timewarp] [--quad-views] [--foveation [lens|gaze]] "
+      "[--dynamic-resolution] [--msaa <count>] [--vrs [<radius> <extrusion>]] "
+      "[--half-rate-periphery] [--gpu-culling [--occlusion-culling] | --cpu-culling [view|stereo]] "
+      "[--lod [<pixels>]] [--mesh-shading] [--compact-vertices] [--triangle-lists [cache|overdraw]] "
+      "[--pipeline-statistics]\n\n"
       "Options:\n"
       "  --help -h                            Show this text.\n"
       "  --device-group <index>               Select the device group to use explicitly by its index. Only device "
@@ -154,7 +240,51 @@ void Options::printUsageAndExit(int32_t p_exitCode) const {
       "<count> x <count>; default: {}\n"
       "  --base-torus-count <count>           The number of tori per compass direction will be 2 x <count> x <count>; "
       "default: {}\n"
-      "  --torus-layer-count <count>          The number of layers per torus to sculpt its spikes; default: {}",
+      "  --torus-layer-count <count>          The number of layers per torus to sculpt its spikes; default: {}\n"
+      "  --late-latching                      Update the view matrices of a frame with the latest head pose right "
+      "before the GPU starts rendering it instead of at command recording time.\n"
+      "  --timewarp                           Reproject the images of all devices to the latest head pose while "
+      "composing the final frame on the main device. Only the rotation of the head is compensated.\n"
+      "  --quad-views                         Use the OpenXR primary stereo with foveated inset view configuration if "
+      "supported by the runtime and 4 physical devices are used; each one renders one of the two wide and two inset "
+      "views. Falls back to primary stereo otherwise.\n"
+      "  --foveation [lens|gaze]              Render the periphery of each view at half resolution and only an inset "
+      "around the lens center or a mock gaze at full resolution; the parts are composed on the main device. Default: "
+      "lens.\n"
+      "  --dynamic-resolution                 Scale the render area of each device down to 50% per dimension when its "
+      "GPU time exceeds the display period; the images are upscaled while composing the final frame on the main "
+      "device.\n"
+      "  --msaa <count>                       Render with <count> samples per pixel and resolve them on each device "
+      "before the transfer. Must be one of {{1, 2, 4, 8}}; default: 1.\n"
+      "  --vrs [<radius> <extrusion>]         Shade at 2 x 2 pixel rate outside of <radius> percent of the half view "
+      "size around the lens center and on fur layers extruded at least <extrusion> percent; default: 50 50. The "
+      "radius is only applied to unscaled, unfoveated renderings.\n"
+      "  --half-rate-periphery                Let devices that only render the periphery, i.e. the wide views of "
+      "--quad-views, render every second frame. The final frame reuses their last image in between; with --timewarp "
+      "it is reprojected to the latest head pose.\n"
+      "  --gpu-culling                        Cull the instances against the part of the view frustum each device "
+      "renders in a compute pass on that device and draw the visible ones indirectly.\n"
+      "  --occlusion-culling                  Also cull the instances hidden behind the depth of an earlier frame and "
+      "draw the ones the current frame's first pass reveals in a second pass. Only applied to unscaled, unfoveated "
+      "renderings.\n"
+      "  --cpu-culling [view|stereo]          Cull the instances on the CPU and only upload the visible ones. With "
+      "view, each device gets the instances within the part of the view frustum it renders; with stereo, all devices "
+      "share the instances within a single frustum enclosing all of them. Default: view.\n"
+      "  --lod [<pixels>]                     Select the tessellation of each torus per frame from its projected size "
+      "in all views, halving it from the base tessellation down to 8 as long as each segment of the torus still spans "
+      "at least <pixels> pixels; default: 8.\n"
+      "  --mesh-shading                       Draw the triangle meshes as meshlets with task and mesh shaders. The "
+      "task shader skips the meshlets of each instance outside of the part of the view frustum its device renders "
+      "and the ones facing away from the viewer. Not available with --gpu-culling.\n"
+      "  --compact-vertices                   Store the vertices in 16 instead of 32 bytes: the position quantized "
+      "against the bounding box of its mesh, the normal octahedrally encoded and the texture coordinates as 16 bit "
+      "fixed point values.\n"
+      "  --triangle-lists [cache|overdraw]    Draw the triangle meshes as indexed triangle lists instead of strips, "
+      "reordered for the post-transform vertex cache. With overdraw, clusters of the reordered triangles are also "
+      "sorted so the outward facing ones come first. Default: cache.\n"
+      "  --pipeline-statistics                Count the vertex shader invocations and input assembly primitives of "
+      "each device with a pipeline statistics query, time its instance uploads with timestamps and log their averages "
+      "per frame every 100 frames.",
       traceFilePath.string(), initialBaseTorusTesselation, initialBaseTorusCount, initialTorusLayerCount);
   XRMG_INFO("{}", usage);
   exit(p_exitCode);
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "PipelineStatistics.hpp"
+
+#include "Renderer.hpp"
+
+namespace xrmg {
+PipelineStatistics::PipelineStatistics(const Renderer &p_renderer)
+    : m_renderer(p_renderer),
+      m_timestampPeriod(p_renderer.getPhysicalDevice(0).getProperties().limits.timestampPeriod),
+      m_uploadSizes(MAX_QUEUED_FRAMES * p_renderer.getPhysicalDeviceCount(), 0),
+      m_sums(p_renderer.getPhysicalDeviceCount()) {
+  // A query per frame slot and physical device. The results are ordered by the flags' bits, i.e. primitives first.
+  m_queryPool = p_renderer.vkDevice().createQueryPoolUnique(
+      {{},
+       vk::QueryType::ePipelineStatistics,
+       MAX_QUEUED_FRAMES * p_renderer.getPhysicalDeviceCount(),
+       vk::QueryPipelineStatisticFlagBits::eInputAssemblyPrimitives |
+           vk::QueryPipelineStatisticFlagBits::eVertexShaderInvocations});
+  // A begin and an end timestamp of the instance upload per frame slot and physical device.
+  m_uploadQueryPool = p_renderer.vkDevice().createQueryPoolUnique(
+      {{}, vk::QueryType::eTimestamp, 2 * MAX_QUEUED_FRAMES * p_renderer.getPhysicalDeviceCount()});
+}
+
+uint32_t PipelineStatistics::getQueryIndex(uint64_t p_frameIndex, uint32_t p_physicalDeviceIndex) const {
+  return static_cast<uint32_t>(p_frameIndex % MAX_QUEUED_FRAMES) * m_renderer.getPhysicalDeviceCount() +
+         p_physicalDeviceIndex;
+}
+
+void PipelineStatistics::writeRenderBegin(vk::CommandBuffer p_cmdBuffer, uint64_t p_frameIndex,
+                                          uint32_t p_physicalDeviceIndex) {
+  uint32_t queryIdx = this->getQueryIndex(p_frameIndex, p_physicalDeviceIndex);
+  p_cmdBuffer.resetQueryPool(m_queryPool.get(), queryIdx, 1);
+  p_cmdBuffer.beginQuery(m_queryPool.get(), queryIdx, {});
+}
+
+void PipelineStatistics::writeRenderEnd(vk::CommandBuffer p_cmdBuffer, uint64_t p_frameIndex,
+                                        uint32_t p_physicalDeviceIndex) {
+  p_cmdBuffer.endQuery(m_queryPool.get(), this->getQueryIndex(p_frameIndex, p_physicalDeviceIndex));
+}
+
+void PipelineStatistics::writeInstanceUploadBegin(vk::CommandBuffer p_cmdBuffer, uint64_t p_frameIndex,
+                                                  uint32_t p_physicalDeviceIndex) {
+  uint32_t queryIdx = 2 * this->getQueryIndex(p_frameIndex, p_physicalDeviceIndex);
+  p_cmdBuffer.resetQueryPool(m_uploadQueryPool.get(), queryIdx, 2);
+  p_cmdBuffer.writeTimestamp2(vk::PipelineStageFlagBits2::eTransfer, m_uploadQueryPool.get(), queryIdx);
+}
+
+void PipelineStatistics::writeInstanceUploadEnd(vk::CommandBuffer p_cmdBuffer, uint64_t p_frameIndex,
+                                                uint32_t p_physicalDeviceIndex, vk::DeviceSize p_uploadSize) {
+  uint32_t queryIdx = this->getQueryIndex(p_frameIndex, p_physicalDeviceIndex);
+  p_cmdBuffer.writeTimestamp2(vk::PipelineStageFlagBits2::eTransfer, m_uploadQueryPool.get(), 2 * queryIdx + 1);
+  m_uploadSizes[queryIdx] = p_uploadSize;
+}
+
+void PipelineStatistics::update(uint64_t p_frameIndex) {
+  for (uint32_t devIdx = 0; devIdx < m_renderer.getPhysicalDeviceCount(); ++devIdx) {
+    if (!m_renderer.isDeviceRenderingFrame(devIdx, p_frameIndex)) {
+      continue;
+    }
+    uint32_t queryIdx = this->getQueryIndex(p_frameIndex, devIdx);
+    auto [result, counts] = m_renderer.vkDevice().getQueryPoolResults<uint64_t>(
+        m_queryPool.get(), queryIdx, 1, 2 * sizeof(uint64_t), 2 * sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+    if (result != vk::Result::eSuccess) {
+      XRMG_WARN("Getting pipeline statistics of physical device {} failed: {}", devIdx, vk::to_string(result));
+      continue;
+    }
+    auto [uploadResult, timestamps] = m_renderer.vkDevice().getQueryPoolResults<uint64_t>(
+        m_uploadQueryPool.get(), 2 * queryIdx, 2, 2 * sizeof(uint64_t), sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+    if (uploadResult != vk::Result::eSuccess) {
+      XRMG_WARN("Getting instance upload timestamps of physical device {} failed: {}", devIdx,
+                vk::to_string(uploadResult));
+      continue;
+    }
+    Sums &sums = m_sums[devIdx];
+    sums.primitiveCount += counts[0];
+    sums.vertexShaderInvocationCount += counts[1];
+    sums.uploadNanos += m_timestampPeriod * static_cast<double>(timestamps[1] - timestamps[0]);
+    sums.uploadSize += m_uploadSizes[queryIdx];
+    if (++sums.frameCount < LOG_INTERVAL) {
+      continue;
+    }
+    // Invocations per primitive approach 0.5 for a perfect vertex cache and 3 for none.
+    double primitives = static_cast<double>(sums.primitiveCount) / LOG_INTERVAL;
+    double invocations = static_cast<double>(sums.vertexShaderInvocationCount) / LOG_INTERVAL;
+    XRMG_INFO("Device {}: {:.0f} primitives and {:.0f} vertex shader invocations per frame, {:.3f} per primitive.",
+              devIdx, primitives, invocations, 0.0 < primitives ? invocations / primitives : 0.0);
+    XRMG_INFO("Device {}: instance upload of {} per frame in {:.3f} ms.", devIdx,
+              formatByteSize(sums.uploadSize / LOG_INTERVAL), 1e-6 * sums.uploadNanos / LOG_INTERVAL);
+    sums = {};
+  }
+}
+} // namespace xrmg
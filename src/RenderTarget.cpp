@@ -18,6 +18,7 @@
  */
 #include "RenderTarget.hpp"
 
+#include "App.hpp"
 #include "Renderer.hpp"
 
 namespace xrmg {
@@ -29,10 +30,13 @@ RenderTarget::RenderTarget(const Renderer &p_renderer, uint32_t p_physicalDevice
       vk::ImageLayout::eUndefined);
   vk::ImageViewCreateInfo colorImageViewCreateInfo({}, {}, vk::ImageViewType::e2D, g_renderFormat, {},
                                                    {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1});
+  // With occlusion culling, the depth is reduced into a depth pyramid.
+  bool occlusionCulling = g_app->getOptions().occlusionCulling;
   vk::ImageCreateInfo depthImageCreateInfo(
       {}, vk::ImageType::e2D, g_depthFormat, vk::Extent3D(p_renderer.getResolutionPerPhysicalDevice(), 1), 1, 1,
       vk::SampleCountFlagBits::e1, vk::ImageTiling::eOptimal,
-      vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eTransferSrc,
+      vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eTransferSrc |
+          (occlusionCulling ? vk::ImageUsageFlagBits::eSampled : vk::ImageUsageFlags()),
       vk::SharingMode::eExclusive, {}, vk::ImageLayout::eUndefined);
   vk::ImageViewCreateInfo depthImageViewCreateInfo({}, {}, vk::ImageViewType::e2D, g_depthFormat, {},
                                                    {vk::ImageAspectFlagBits::eDepth, 0, 1, 0, 1});
@@ -40,6 +44,21 @@ RenderTarget::RenderTarget(const Renderer &p_renderer, uint32_t p_physicalDevice
     m_colorResources.emplace_back(p_renderer, p_physicalDeviceIndex, colorImageCreateInfo, colorImageViewCreateInfo);
     m_depthResources.emplace_back(p_renderer, p_physicalDeviceIndex, depthImageCreateInfo, depthImageViewCreateInfo);
   }
+
+  // The multisampled attachments are only used within a frame's rendering, so all frames share them. Occlusion culling
+  // renders each frame in two passes, so they must keep their contents in between.
+  vk::SampleCountFlagBits sampleCount = g_app->getOptions().sampleCount;
+  if (sampleCount != vk::SampleCountFlagBits::e1) {
+    vk::ImageUsageFlags transientUsage =
+        occlusionCulling ? vk::ImageUsageFlags() : vk::ImageUsageFlagBits::eTransientAttachment;
+    colorImageCreateInfo.setSamples(sampleCount).setUsage(vk::ImageUsageFlagBits::eColorAttachment | transientUsage);
+    m_multisampleColorResource.emplace(p_renderer, p_physicalDeviceIndex, colorImageCreateInfo,
+                                       colorImageViewCreateInfo);
+    depthImageCreateInfo.setSamples(sampleCount).setUsage(vk::ImageUsageFlagBits::eDepthStencilAttachment |
+                                                          transientUsage);
+    m_multisampleDepthResource.emplace(p_renderer, p_physicalDeviceIndex, depthImageCreateInfo,
+                                       depthImageViewCreateInfo);
+  }
 }
 
 VulkanImageResource &RenderTarget::getColorResource(uint64_t p_frameIndex) {
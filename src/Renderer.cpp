@@ -19,8 +19,14 @@
 #include "Renderer.hpp"
 
 #include "App.hpp"
+#include "Compositor.hpp"
+#include "DeviceMemoryAllocator.hpp"
+#include "MeshUploader.hpp"
 #include "Options.hpp"
+#include "PipelineStatistics.hpp"
 #include "RenderTarget.hpp"
+#include "ResolutionGovernor.hpp"
+#include "ShadingRateMap.hpp"
 
 VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
 
@@ -37,6 +43,22 @@ static const std::vector<const char *> g_vulkanDeviceExtensions = {
 #endif
 };
 
+// The compositor's source images have the layout of the render targets, so a layer's source rectangle is its render
+// area relative to the extent of the device's image.
+static Compositor::Layer createCompositorLayer(uint32_t p_sourceIndex, uint64_t p_sourceFrameIndex,
+                                               const vk::Extent2D &p_sourceExtent, const vk::Rect2D &p_renderArea,
+                                               const vk::Rect2D &p_destRect) {
+  auto width = static_cast<float>(p_sourceExtent.width);
+  auto height = static_cast<float>(p_sourceExtent.height);
+  return {.sourceIndex = p_sourceIndex,
+          .sourceFrameIndex = p_sourceFrameIndex,
+          .sourceRect = {.x = static_cast<float>(p_renderArea.offset.x) / width,
+                         .y = static_cast<float>(p_renderArea.offset.y) / height,
+                         .width = static_cast<float>(p_renderArea.extent.width) / width,
+                         .height = static_cast<float>(p_renderArea.extent.height) / height},
+          .destRect = p_destRect};
+}
+
 Renderer::Renderer(std::unique_ptr<UserInterface> p_userInterface) : m_userInterface(std::move(p_userInterface)) {
   VULKAN_HPP_DEFAULT_DISPATCHER.init();
 
@@ -50,9 +72,12 @@ Renderer::Renderer(std::unique_ptr<UserInterface> p_userInterface) : m_userInter
   this->createQueueFamilies();
   this->updateMainPhysicalDevice();
   this->createLogicalDevice();
+  m_memoryAllocator = std::make_unique<DeviceMemoryAllocator>(*this);
+  m_meshUploader = std::make_unique<MeshUploader>(*this, m_transferQueueFamily->getIndex(), m_transferQueue);
   this->printVulkanMemoryProps();
   this->initPipelineCache();
   this->createMainRenderTargets();
+  m_memoryAllocator->logStatistics();
 
   m_userInterface->initialize(*this, this->getGraphicsQueueFamilyIndex(), 1);
   if (!m_userInterface->getSwapchainImageReadySemaphore()) {
@@ -168,10 +193,59 @@ void Renderer::createLogicalDevice() {
       {{}, m_transferQueueFamily->getIndex(), transferQueuePriorities}};
   std::vector<const char *> deviceExtensions = m_userInterface->getNeededDeviceExtensions();
   deviceExtensions.insert(deviceExtensions.end(), g_vulkanDeviceExtensions.begin(), g_vulkanDeviceExtensions.end());
+  if (g_app->getOptions().variableRateShading) {
+    for (vk::PhysicalDevice physicalDevice : m_vkPhysicalDevices) {
+      auto shadingRateFeatures =
+          physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceFragmentShadingRateFeaturesKHR>()
+              .get<vk::PhysicalDeviceFragmentShadingRateFeaturesKHR>();
+      XRMG_ASSERT(shadingRateFeatures.pipelineFragmentShadingRate && shadingRateFeatures.primitiveFragmentShadingRate &&
+                      shadingRateFeatures.attachmentFragmentShadingRate,
+                  "Physical device {} doesn't support pipeline, primitive and attachment fragment shading rates.",
+                  physicalDevice.getProperties().deviceName.data());
+    }
+    deviceExtensions.emplace_back("VK_KHR_fragment_shading_rate");
+  }
+  vk::PhysicalDeviceFeatures enabledFeatures;
+  if (g_app->getOptions().occlusionCulling) {
+    for (vk::PhysicalDevice physicalDevice : m_vkPhysicalDevices) {
+      XRMG_ASSERT(physicalDevice.getFeatures().drawIndirectFirstInstance,
+                  "Physical device {} doesn't support indirect draws with a first instance.",
+                  physicalDevice.getProperties().deviceName.data());
+    }
+    // The late draws of occlusion culling read their instances behind the early ones.
+    enabledFeatures.setDrawIndirectFirstInstance(true);
+  }
+  if (g_app->getOptions().pipelineStatistics) {
+    for (vk::PhysicalDevice physicalDevice : m_vkPhysicalDevices) {
+      XRMG_ASSERT(physicalDevice.getFeatures().pipelineStatisticsQuery,
+                  "Physical device {} doesn't support pipeline statistics queries.",
+                  physicalDevice.getProperties().deviceName.data());
+    }
+    enabledFeatures.setPipelineStatisticsQuery(true);
+  }
+  if (g_app->getOptions().meshShading) {
+    for (vk::PhysicalDevice physicalDevice : m_vkPhysicalDevices) {
+      auto meshShaderFeatures =
+          physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceMeshShaderFeaturesEXT>()
+              .get<vk::PhysicalDeviceMeshShaderFeaturesEXT>();
+      XRMG_ASSERT(meshShaderFeatures.taskShader && meshShaderFeatures.meshShader,
+                  "Physical device {} doesn't support task and mesh shaders.",
+                  physicalDevice.getProperties().deviceName.data());
+    }
+    deviceExtensions.emplace_back("VK_EXT_mesh_shader");
+  }
   vk::StructureChain deviceCreateInfoChain(
-      vk::DeviceCreateInfo({}, queueCreateInfos, {}, deviceExtensions, nullptr),
+      vk::DeviceCreateInfo({}, queueCreateInfos, {}, deviceExtensions, &enabledFeatures),
       vk::DeviceGroupDeviceCreateInfo(m_vkPhysicalDevices), vk::PhysicalDeviceDynamicRenderingFeatures(true),
-      vk::PhysicalDeviceTimelineSemaphoreFeatures(true), vk::PhysicalDeviceSynchronization2Features(true));
+      vk::PhysicalDeviceTimelineSemaphoreFeatures(true), vk::PhysicalDeviceSynchronization2Features(true),
+      vk::PhysicalDeviceFragmentShadingRateFeaturesKHR(true, true, true),
+      vk::PhysicalDeviceMeshShaderFeaturesEXT(true, true));
+  if (!g_app->getOptions().variableRateShading) {
+    deviceCreateInfoChain.unlink<vk::PhysicalDeviceFragmentShadingRateFeaturesKHR>();
+  }
+  if (!g_app->getOptions().meshShading) {
+    deviceCreateInfoChain.unlink<vk::PhysicalDeviceMeshShaderFeaturesEXT>();
+  }
   m_vkDevice = m_vkPhysicalDevices.front().createDeviceUnique(deviceCreateInfoChain.get());
 
   m_graphicsQueueFamily->allocateCommandBuffers(m_vkDevice.get(), MAX_QUEUED_FRAMES, 10);
@@ -189,19 +263,80 @@ void Renderer::createLogicalDevice() {
   m_frameIndexSem = m_vkDevice->createSemaphoreUnique(timelineSemaphoreCreateInfo.get());
   m_renderDoneSemaphores.resize(this->getPhysicalDeviceCount());
   for (vk::UniqueSemaphore &sem : m_renderDoneSemaphores) {
-    sem = m_vkDevice->createSemaphoreUnique({});
+    sem = m_vkDevice->createSemaphoreUnique(timelineSemaphoreCreateInfo.get());
   }
   m_transferDoneSemaphore = m_vkDevice->createSemaphoreUnique(timelineSemaphoreCreateInfo.get());
+  if (g_app->getOptions().lateLatching) {
+    m_poseLatchedSemaphore = m_vkDevice->createSemaphoreUnique(timelineSemaphoreCreateInfo.get());
+  }
+  if (1 < this->getPhysicalDeviceCount()) {
+    m_instanceBroadcastSemaphore = m_vkDevice->createSemaphoreUnique(timelineSemaphoreCreateInfo.get());
+  }
 }
 
 void Renderer::createMainRenderTargets() {
-  m_resolutionPerPhysicalDevice = m_userInterface->getResolutionPerEye();
-  if (this->getPhysicalDeviceCount() == 4) {
-    m_resolutionPerPhysicalDevice.height /= 2;
+  uint32_t viewCount = m_userInterface->getViewCount();
+  XRMG_ASSERT(viewCount == 2 || viewCount == this->getPhysicalDeviceCount(),
+              "{} views can't be distributed to {} physical devices.", viewCount, this->getPhysicalDeviceCount());
+  m_resolutionPerPhysicalDevice = vk::Extent2D(0, 0);
+  for (uint32_t devIdx = 0; devIdx < this->getPhysicalDeviceCount(); ++devIdx) {
+    // With as many views as devices, each device renders a whole view. Otherwise, device 0 and 2 render the left view
+    // and device 1 and 3 the right one; with 4 devices each of them renders one half of it.
+    uint32_t viewIdx = viewCount == this->getPhysicalDeviceCount() ? devIdx : devIdx % 2;
+    Rect2Df viewport = {.x = 0.0f, .y = 0.0f, .width = 1.0f, .height = 1.0f};
+    if (viewCount < this->getPhysicalDeviceCount()) {
+      viewport = devIdx < 2 ? Rect2Df{.x = 0.0f, .y = 0.0f, .width = 1.0f, .height = 0.5f}
+                            : Rect2Df{.x = 0.0f, .y = 0.5f, .width = 1.0f, .height = 0.5f};
+    }
+    vk::Rect2D viewImageRect = m_userInterface->getViewImageRect(viewIdx);
+    auto viewWidth = static_cast<float>(viewImageRect.extent.width);
+    auto viewHeight = static_cast<float>(viewImageRect.extent.height);
+    vk::Rect2D imageRect({viewImageRect.offset.x + static_cast<int32_t>(viewport.x * viewWidth),
+                          viewImageRect.offset.y + static_cast<int32_t>(viewport.y * viewHeight)},
+                         {static_cast<uint32_t>(viewport.width * viewWidth),
+                          static_cast<uint32_t>(viewport.height * viewHeight)});
+    // With quad views, the first two views are the wide ones; the runtime only shows their periphery.
+    bool periphery = viewCount == 4 && viewIdx < 2;
+    // Swapping the eyes only swaps the rendered content, not where it ends up in the swapchain image.
+    m_deviceLayouts.emplace_back(DeviceLayout{
+        .viewIndex = g_app->getOptions().swapEyes ? viewIdx ^ 1 : viewIdx,
+        .updateInterval = periphery && g_app->getOptions().halfRatePeriphery ? PERIPHERY_UPDATE_INTERVAL : 1,
+        .viewport = viewport,
+        .imageRect = imageRect});
+    m_resolutionPerPhysicalDevice.width = std::max(m_resolutionPerPhysicalDevice.width, imageRect.extent.width);
+    m_resolutionPerPhysicalDevice.height = std::max(m_resolutionPerPhysicalDevice.height, imageRect.extent.height);
   }
+  vk::SampleCountFlagBits sampleCount = g_app->getOptions().sampleCount;
   for (uint32_t devIdx = 0; devIdx < this->getPhysicalDeviceCount(); ++devIdx) {
+    const vk::PhysicalDeviceLimits &limits = this->getPhysicalDevice(devIdx).getProperties().limits;
+    XRMG_ASSERT((limits.framebufferColorSampleCounts & limits.framebufferDepthSampleCounts & sampleCount) ==
+                    sampleCount,
+                "Physical device {} doesn't support {}.", devIdx, vk::to_string(sampleCount));
     m_renderTargets.emplace_back(*this, devIdx);
   }
+  m_renderViews.resize(this->getPhysicalDeviceCount(), Mat4x4f::IDENTITY);
+  m_deviceRegions.resize(this->getPhysicalDeviceCount());
+  const Options &options = g_app->getOptions();
+  XRMG_WARN_IF(options.halfRatePeriphery && viewCount != 4,
+               "No physical device renders only the periphery; all of them render every frame.");
+  if (options.timewarp || options.foveation || options.dynamicResolution || options.halfRatePeriphery) {
+    std::vector<vk::Extent2D> sourceExtents;
+    for (const DeviceLayout &layout : m_deviceLayouts) {
+      sourceExtents.emplace_back(layout.imageRect.extent);
+    }
+    uint32_t layersPerDevice = options.foveation ? 2 : 1;
+    m_compositor =
+        std::make_unique<Compositor>(*this, sourceExtents, layersPerDevice * this->getPhysicalDeviceCount());
+  }
+  if (options.dynamicResolution) {
+    m_resolutionGovernor = std::make_unique<ResolutionGovernor>(*this);
+  }
+  if (options.pipelineStatistics) {
+    m_pipelineStatistics = std::make_unique<PipelineStatistics>(*this);
+  }
+  if (options.variableRateShading) {
+    m_shadingRateMap = std::make_unique<ShadingRateMap>(*this);
+  }
 }
 
 void Renderer::initPipelineCache() {
@@ -258,6 +393,7 @@ void Renderer::nextFrame(Scene &p_scene) {
                           : 0.0f;
   m_lastPredictedDisplayTimeNanos = frameInfo.predictedDisplayTimeNanos;
   m_runtimeMillis += deltaMillis;
+  m_meshUploader->update();
   {
     XRMG_SCOPED_INSTRUMENT("scene update");
     p_scene.update(deltaMillis);
@@ -276,6 +412,14 @@ void Renderer::nextFrame(Scene &p_scene) {
       uint64_t waitValue = m_frameIndex - MAX_QUEUED_FRAMES + 1;
       vk::Result waitResult = m_vkDevice.get().waitSemaphores({{}, m_frameIndexSem.get(), waitValue}, UINT64_MAX);
       XRMG_ASSERT(waitResult == vk::Result::eSuccess, "Wait failed.");
+      if (m_resolutionGovernor) {
+        m_resolutionGovernor->update(m_frameIndex - MAX_QUEUED_FRAMES, frameInfo.predictedDisplayPeriodNanos);
+      }
+      if (m_pipelineStatistics) {
+        m_pipelineStatistics->update(m_frameIndex - MAX_QUEUED_FRAMES);
+      }
+      p_scene.logCullingStatistics(m_frameIndex - MAX_QUEUED_FRAMES);
+      p_scene.releaseRetiredInstanceStorage(m_frameIndex - MAX_QUEUED_FRAMES);
     }
     m_graphicsQueueFamily->reset(m_vkDevice.get());
     m_transferQueueFamily->reset(m_vkDevice.get());
@@ -294,13 +438,19 @@ void Renderer::nextFrame(Scene &p_scene) {
                                                       vk::PipelineStageFlagBits2::eAllCommands, 0);
     m_presentQueue.submit2(vk::SubmitInfo2({}, {}, {}, swapchainImageReadySignal));
   }
+  if (g_app->getOptions().lateLatching) {
+    // Acquiring the swapchain images may block, so the pose is latched afterwards.
+    XRMG_SCOPED_INSTRUMENT("latch pose");
+    this->latchPose(p_scene);
+  }
+  bool depthWritten;
   {
     XRMG_SCOPED_INSTRUMENT("build final frame");
-    this->buildFinalFrame(frt);
+    depthWritten = this->buildFinalFrame(frt);
   }
   {
     XRMG_SCOPED_INSTRUMENT("release swap chain image");
-    m_userInterface->releaseSwapchainImage();
+    m_userInterface->releaseSwapchainImage(depthWritten);
   }
   {
     XRMG_SCOPED_INSTRUMENT("end frame");
@@ -311,12 +461,72 @@ void Renderer::nextFrame(Scene &p_scene) {
 
 void Renderer::renderFrame(Scene &p_scene) {
   std::vector<vk::SubmitInfo2> graphicsSubmits;
-  std::vector<vk::SemaphoreSubmitInfo> semaphoreWaits(2 * this->getPhysicalDeviceCount());
+  std::vector<vk::SemaphoreSubmitInfo> semaphoreWaits(4 * this->getPhysicalDeviceCount());
   uint32_t nextSemWaitIdx = 0;
   std::vector<vk::CommandBufferSubmitInfo> graphicsCmdBufferSubmits(this->getPhysicalDeviceCount());
   std::vector<vk::SemaphoreSubmitInfo> semaphoreSignals(this->getPhysicalDeviceCount());
+  // Stages reading the camera and fetching the triangle meshes; mesh shading does both in its task and mesh shaders.
+  bool meshShading = g_app->getOptions().meshShading;
+  vk::PipelineStageFlags2 geometryStages =
+      meshShading ? vk::PipelineStageFlagBits2::eTaskShaderEXT | vk::PipelineStageFlagBits2::eMeshShaderEXT
+                  : vk::PipelineStageFlagBits2::eVertexShader;
+  vk::PipelineStageFlags2 meshFetchStages =
+      meshShading ? geometryStages
+                  : vk::PipelineStageFlagBits2::eVertexAttributeInput | vk::PipelineStageFlagBits2::eIndexInput;
 
+  // All cameras are set before the first device renders, so culling may take the frusta of all devices into account.
   for (uint32_t devIdx = 0; devIdx < this->getPhysicalDeviceCount(); ++devIdx) {
+    if (!this->isDeviceRenderingFrame(devIdx, m_frameIndex)) {
+      continue;
+    }
+    uint32_t viewIdx = m_deviceLayouts[devIdx].viewIndex;
+    StereoProjection proj = m_userInterface->getCurrentFrameProjection(viewIdx);
+    Rect2Df viewport = this->getDeviceRelativeViewport(devIdx, proj.relativeViewport);
+    m_renderViews[devIdx] = m_userInterface->getCurrentFrameView(viewIdx);
+    // Part of the normalized device coordinates the device's image covers, for culling against its frustum.
+    Vec4f clipBounds = {std::max(-1.0f, -1.0f - 2.0f * viewport.x / viewport.width),
+                        std::max(-1.0f, -1.0f - 2.0f * viewport.y / viewport.height),
+                        std::min(1.0f, -1.0f + 2.0f * (1.0f - viewport.x) / viewport.width),
+                        std::min(1.0f, -1.0f + 2.0f * (1.0f - viewport.y) / viewport.height)};
+    p_scene.setCamera(m_frameIndex, devIdx, m_renderViews[devIdx], proj.projectionMatrix, clipBounds);
+  }
+
+  // The first device reads the instances from host memory once for all devices rendering the frame, which copy them
+  // from its memory before drawing.
+  bool broadcastInstances = p_scene.isBroadcastingInstances();
+  vk::CommandBufferSubmitInfo broadcastCmdBufferSubmit;
+  std::vector<vk::SemaphoreSubmitInfo> broadcastWaits;
+  vk::SemaphoreSubmitInfo broadcastSignal;
+  if (broadcastInstances) {
+    std::vector<uint32_t> renderingDeviceIndices;
+    for (uint32_t devIdx = 0; devIdx < this->getPhysicalDeviceCount(); ++devIdx) {
+      if (this->isDeviceRenderingFrame(devIdx, m_frameIndex)) {
+        renderingDeviceIndices.push_back(devIdx);
+      }
+    }
+    vk::CommandBuffer broadcastCmdBuffer = m_graphicsQueueFamily->nextCommandBuffer();
+    broadcastCmdBuffer.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+    p_scene.broadcastInstances(broadcastCmdBuffer, renderingDeviceIndices);
+    broadcastCmdBuffer.end();
+    broadcastCmdBufferSubmit = vk::CommandBufferSubmitInfo(broadcastCmdBuffer, this->getDeviceMaskFirst());
+    if (MAX_QUEUED_FRAMES <= m_frameIndex) {
+      // The frame slot's broadcast instances must have been copied by all devices.
+      broadcastWaits.emplace_back(m_frameIndexSem.get(), m_frameIndex - MAX_QUEUED_FRAMES + 1,
+                                  vk::PipelineStageFlagBits2::eAllCommands, 0);
+    }
+    broadcastSignal = vk::SemaphoreSubmitInfo(m_instanceBroadcastSemaphore.get(), m_frameIndex + 1,
+                                              vk::PipelineStageFlagBits2::eTransfer, 0);
+    graphicsSubmits.emplace_back(vk::SubmitInfo2({}, broadcastWaits, broadcastCmdBufferSubmit, broadcastSignal));
+  }
+
+  for (uint32_t devIdx = 0; devIdx < this->getPhysicalDeviceCount(); ++devIdx) {
+    semaphoreSignals[devIdx] = vk::SemaphoreSubmitInfo(m_renderDoneSemaphores[devIdx].get(), m_frameIndex + 1,
+                                                       vk::PipelineStageFlagBits2::eAllCommands, devIdx);
+    if (!this->isDeviceRenderingFrame(devIdx, m_frameIndex)) {
+      // The device's last image is reused, so only its render done semaphore advances.
+      graphicsSubmits.emplace_back(vk::SubmitInfo2({}, {}, {}, semaphoreSignals[devIdx]));
+      continue;
+    }
     RenderTarget &rt = m_renderTargets[devIdx];
     vk::Image rtColorImage = rt.getColorResource(m_frameIndex).getImage();
     vk::ImageView rtColorImageView = rt.getColorResource(m_frameIndex).getImageView();
@@ -329,8 +539,16 @@ void Renderer::renderFrame(Scene &p_scene) {
       g_app->getProfiler().resetQueryPool(cmdBuffer);
     }
     g_app->getProfiler().pushDurationBegin(std::format("render device {}", devIdx), m_frameIndex, devIdx, cmdBuffer);
-    uint32_t srcQueueFamilyIndex =
-        m_frameIndex < MAX_QUEUED_FRAMES ? m_graphicsQueueFamily->getIndex() : m_transferQueueFamily->getIndex();
+    if (m_resolutionGovernor) {
+      m_resolutionGovernor->writeRenderBegin(cmdBuffer, m_frameIndex, devIdx);
+    }
+    if (m_pipelineStatistics) {
+      m_pipelineStatistics->writeRenderBegin(cmdBuffer, m_frameIndex, devIdx);
+    }
+    // Each frame slot is released by the transfer queue family once the device has rendered to it.
+    uint32_t srcQueueFamilyIndex = m_frameIndex < MAX_QUEUED_FRAMES * m_deviceLayouts[devIdx].updateInterval
+                                       ? m_graphicsQueueFamily->getIndex()
+                                       : m_transferQueueFamily->getIndex();
     // Before rendering, we need to transfer the color and depth images from the transfer queue family to the graphics
     // queue family.
     std::vector<vk::ImageMemoryBarrier2> transferToGraphicsQueueFamilyBarriersEnd = {
@@ -359,24 +577,61 @@ void Renderer::renderFrame(Scene &p_scene) {
             {vk::ImageAspectFlagBits::eDepth, 0, 1, 0, 1},
         },
     };
+    if (const std::optional<VulkanImageResource> &msColor = rt.getMultisampleColorResource(); msColor) {
+      // The multisampled attachments are shared by all frames, so the last frame's rendering to them must be done.
+      transferToGraphicsQueueFamilyBarriersEnd.emplace_back(
+          vk::PipelineStageFlagBits2::eColorAttachmentOutput, vk::AccessFlagBits2::eColorAttachmentWrite,
+          vk::PipelineStageFlagBits2::eColorAttachmentOutput, vk::AccessFlagBits2::eColorAttachmentWrite,
+          vk::ImageLayout::eUndefined, vk::ImageLayout::eColorAttachmentOptimal, VK_QUEUE_FAMILY_IGNORED,
+          VK_QUEUE_FAMILY_IGNORED, msColor->getImage(),
+          vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1));
+      transferToGraphicsQueueFamilyBarriersEnd.emplace_back(
+          vk::PipelineStageFlagBits2::eLateFragmentTests | vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+          vk::AccessFlagBits2::eDepthStencilAttachmentWrite, vk::PipelineStageFlagBits2::eEarlyFragmentTests,
+          vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
+          vk::ImageLayout::eUndefined, vk::ImageLayout::eDepthAttachmentOptimal, VK_QUEUE_FAMILY_IGNORED,
+          VK_QUEUE_FAMILY_IGNORED, rt.getMultisampleDepthResource()->getImage(),
+          vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eDepth, 0, 1, 0, 1));
+    }
     cmdBuffer.pipelineBarrier2({{}, {}, {}, transferToGraphicsQueueFamilyBarriersEnd});
-    auto eye = static_cast<StereoProjection::Eye>(devIdx % 2);
-    if (g_app->getOptions().swapEyes) {
-      eye = static_cast<StereoProjection::Eye>(1 - static_cast<int32_t>(eye));
-    }
-    StereoProjection proj = m_userInterface->getCurrentFrameProjection(eye);
-    Rect2Df eyeViewport = proj.relativeViewport;
-    Rect2Df deviceViewport = this->getDeviceViewport(devIdx);
-    eyeViewport.x -= deviceViewport.x / deviceViewport.width;
-    eyeViewport.y -= deviceViewport.y / deviceViewport.height;
-    eyeViewport.width /= deviceViewport.width;
-    eyeViewport.height /= deviceViewport.height;
-    vk::Viewport vp(eyeViewport.x * static_cast<float>(this->getResolutionPerPhysicalDevice().width),
-                    eyeViewport.y * static_cast<float>(this->getResolutionPerPhysicalDevice().height),
-                    eyeViewport.width * static_cast<float>(this->getResolutionPerPhysicalDevice().width),
-                    eyeViewport.height * static_cast<float>(this->getResolutionPerPhysicalDevice().height), 0.0f, 1.0f);
-    p_scene.render(devIdx, cmdBuffer, rtColorImageView, rtDepthImageView, {{0, 0}, m_resolutionPerPhysicalDevice}, vp,
-                   m_userInterface->getCurrentFrameView(eye), proj.projectionMatrix);
+    uint32_t viewIdx = m_deviceLayouts[devIdx].viewIndex;
+    const vk::Rect2D &imageRect = m_deviceLayouts[devIdx].imageRect;
+    StereoProjection proj = m_userInterface->getCurrentFrameProjection(viewIdx);
+    Rect2Df viewport = this->getDeviceRelativeViewport(devIdx, proj.relativeViewport);
+    m_deviceRegions[devIdx] = this->computeDeviceRegions(devIdx, proj, viewport);
+    std::vector<Scene::RenderRegion> renderRegions;
+    for (const DeviceRegion &region : m_deviceRegions[devIdx]) {
+      // The viewport is scaled and moved along with the region, so each region shows its part of the device's image.
+      float scaleX =
+          static_cast<float>(region.renderArea.extent.width) / static_cast<float>(region.destRect.extent.width);
+      float scaleY =
+          static_cast<float>(region.renderArea.extent.height) / static_cast<float>(region.destRect.extent.height);
+      float originX = static_cast<float>(region.renderArea.offset.x) -
+                      scaleX * static_cast<float>(region.destRect.offset.x - imageRect.offset.x);
+      float originY = static_cast<float>(region.renderArea.offset.y) -
+                      scaleY * static_cast<float>(region.destRect.offset.y - imageRect.offset.y);
+      vk::Viewport vp(originX + scaleX * viewport.x * static_cast<float>(imageRect.extent.width),
+                      originY + scaleY * viewport.y * static_cast<float>(imageRect.extent.height),
+                      scaleX * viewport.width * static_cast<float>(imageRect.extent.width),
+                      scaleY * viewport.height * static_cast<float>(imageRect.extent.height), 0.0f, 1.0f);
+      renderRegions.emplace_back(Scene::RenderRegion{.renderArea = region.renderArea, .viewport = vp});
+    }
+    const std::optional<VulkanImageResource> &msColor = rt.getMultisampleColorResource();
+    const std::optional<VulkanImageResource> &msDepth = rt.getMultisampleDepthResource();
+    Scene::RenderAttachments attachments = {.color = rtColorImageView,
+                                            .depth = rtDepthImageView,
+                                            .multisampleColor = msColor ? msColor->getImageView() : vk::ImageView(),
+                                            .multisampleDepth = msDepth ? msDepth->getImageView() : vk::ImageView(),
+                                            .depthImage = rtDepthImage};
+    // The shading rate image covers the device's image at full resolution, so foveated or downscaled regions only use
+    // the per primitive rates.
+    if (m_shadingRateMap && m_deviceRegions[devIdx].size() == 1 &&
+        m_deviceRegions[devIdx].front().renderArea.extent == imageRect.extent) {
+      m_shadingRateMap->upload(cmdBuffer, devIdx, viewport, proj.getLensCenter(), imageRect.extent);
+      attachments.shadingRate = m_shadingRateMap->getImageView(devIdx);
+      attachments.shadingRateTexelSize = m_shadingRateMap->getTexelSize();
+    }
+    p_scene.render(devIdx, cmdBuffer, attachments, renderRegions);
     // After rendering, we need to transfer the color and depth images from the graphics queue family to the transfer
     // queue family.
     std::vector<vk::ImageMemoryBarrier2> graphicsToTransferQueueFamilyBarriersBegin = {
@@ -393,8 +648,9 @@ void Renderer::renderFrame(Scene &p_scene) {
             {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1},
         },
         {
-            vk::PipelineStageFlagBits2::eLateFragmentTests,
-            vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
+            // Depth resolves are performed in the color attachment output stage.
+            vk::PipelineStageFlagBits2::eLateFragmentTests | vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+            vk::AccessFlagBits2::eDepthStencilAttachmentWrite | vk::AccessFlagBits2::eColorAttachmentWrite,
             vk::PipelineStageFlagBits2::eTransfer,
             vk::AccessFlagBits2::eTransferRead,
             vk::ImageLayout::eDepthAttachmentOptimal,
@@ -406,12 +662,16 @@ void Renderer::renderFrame(Scene &p_scene) {
         },
     };
     cmdBuffer.pipelineBarrier2({{}, {}, {}, graphicsToTransferQueueFamilyBarriersBegin});
+    if (m_pipelineStatistics) {
+      m_pipelineStatistics->writeRenderEnd(cmdBuffer, m_frameIndex, devIdx);
+    }
+    if (m_resolutionGovernor) {
+      m_resolutionGovernor->writeRenderEnd(cmdBuffer, m_frameIndex, devIdx);
+    }
     g_app->getProfiler().pushDurationEnd(cmdBuffer);
     cmdBuffer.end();
 
     graphicsCmdBufferSubmits[devIdx] = vk::CommandBufferSubmitInfo(cmdBuffer, this->deviceIndexToDeviceMask(devIdx));
-    semaphoreSignals[devIdx] = vk::SemaphoreSubmitInfo(m_renderDoneSemaphores[devIdx].get(), 0,
-                                                       vk::PipelineStageFlagBits2::eAllCommands, devIdx);
 
     uint32_t semWaitCount = 0;
     vk::SemaphoreSubmitInfo *semWaits = &semaphoreWaits[nextSemWaitIdx];
@@ -421,42 +681,81 @@ void Renderer::renderFrame(Scene &p_scene) {
                                   vk::PipelineStageFlagBits2::eAllCommands, devIdx);
       ++semWaitCount;
     }
+    if (m_poseLatchedSemaphore) {
+      // The whole rendering waits, so the GPU time measured by the resolution governor excludes the wait.
+      semaphoreWaits[nextSemWaitIdx++] = vk::SemaphoreSubmitInfo(
+          m_poseLatchedSemaphore.get(), m_frameIndex + 1, vk::PipelineStageFlagBits2::eAllCommands, devIdx);
+      ++semWaitCount;
+    }
+    if (broadcastInstances) {
+      semaphoreWaits[nextSemWaitIdx++] = vk::SemaphoreSubmitInfo(
+          m_instanceBroadcastSemaphore.get(), m_frameIndex + 1, vk::PipelineStageFlagBits2::eTransfer, devIdx);
+      ++semWaitCount;
+    }
+    if (m_meshUploader->getFinishedValue() != 0) {
+      // Already reached, but makes the meshes the scene considers uploaded visible to the device.
+      semaphoreWaits[nextSemWaitIdx++] = vk::SemaphoreSubmitInfo(
+          m_meshUploader->getSemaphore(), m_meshUploader->getFinishedValue(), meshFetchStages, devIdx);
+      ++semWaitCount;
+    }
     graphicsSubmits.emplace_back(vk::SubmitInfo2({}, semWaitCount, semWaits, 1, &graphicsCmdBufferSubmits[devIdx], 1,
                                                  &semaphoreSignals[devIdx]));
   }
   m_renderQueue.submit2(graphicsSubmits);
 }
 
-void Renderer::buildFinalFrame(const UserInterface::FrameRenderTargets &p_renderTargets) {
+void Renderer::latchPose(Scene &p_scene) {
+  // The rendering of this frame is already submitted, but waits for the host to signal that the camera buffer holds the
+  // latest pose. The host never waits for the GPU here; if the devices are still busy with the previous frame, they
+  // don't wait at all. The relocated views are also the ones submitted with the projection layer.
+  m_userInterface->latchCurrentFrameViews();
+  for (uint32_t devIdx = 0; devIdx < this->getPhysicalDeviceCount(); ++devIdx) {
+    if (this->isDeviceRenderingFrame(devIdx, m_frameIndex)) {
+      m_renderViews[devIdx] = m_userInterface->getCurrentFrameView(m_deviceLayouts[devIdx].viewIndex);
+      p_scene.setCameraView(m_frameIndex, devIdx, m_renderViews[devIdx]);
+    }
+  }
+  m_vkDevice->signalSemaphore({m_poseLatchedSemaphore.get(), m_frameIndex + 1});
+}
+
+bool Renderer::buildFinalFrame(const UserInterface::FrameRenderTargets &p_renderTargets) {
   // The invidual render targets are transferred to the swapchain image. The swapchain image and depth image are then
-  // prepared to be returned to the user interface by transitioning them to their desired layout.
-  std::vector<vk::SemaphoreSubmitInfo> renderDoneWaits(this->getPhysicalDeviceCount() + 1);
-  renderDoneWaits.back() = {m_swapchainImageReadySemaphore ? m_swapchainImageReadySemaphore.get()
-                                                           : m_userInterface->getSwapchainImageReadySemaphore(),
-                            0, vk::PipelineStageFlagBits2::eAllCommands, 0};
-  std::vector<vk::ImageMemoryBarrier2> graphicsToTransferQueueFamilyBarriersEnd = {
-      {vk::PipelineStageFlagBits2::eAllCommands,
-       vk::AccessFlagBits2::eNone,
-       vk::PipelineStageFlagBits2::eTransfer,
-       vk::AccessFlagBits2::eTransferWrite,
-       vk::ImageLayout::eUndefined,
-       vk::ImageLayout::eTransferDstOptimal,
-       VK_QUEUE_FAMILY_IGNORED,
-       VK_QUEUE_FAMILY_IGNORED,
-       p_renderTargets.colorImage,
-       {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1}}};
-  std::vector<vk::ImageMemoryBarrier2> transferToGraphicsQueueFamilyBarriersBegin = {
-      {vk::PipelineStageFlagBits2::eTransfer,
-       vk::AccessFlagBits2::eTransferWrite,
-       vk::PipelineStageFlagBits2::eAllCommands,
-       vk::AccessFlagBits2::eMemoryRead,
-       vk::ImageLayout::eTransferDstOptimal,
-       p_renderTargets.desiredColorImageLayoutOnRelease,
-       m_transferQueueFamily->getIndex(),
-       m_graphicsQueueFamily->getIndex(),
-       p_renderTargets.colorImage,
-       {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1}}};
-  if (p_renderTargets.depthImage) {
+  // prepared to be returned to the user interface by transitioning them to their desired layout. With a compositor,
+  // the color images are transferred to its source images instead and composed into the swapchain image afterwards.
+  vk::SemaphoreSubmitInfo swapchainImageReadyWait(m_swapchainImageReadySemaphore
+                                                      ? m_swapchainImageReadySemaphore.get()
+                                                      : m_userInterface->getSwapchainImageReadySemaphore(),
+                                                  0, vk::PipelineStageFlagBits2::eAllCommands, 0);
+  std::vector<vk::SemaphoreSubmitInfo> renderDoneWaits(this->getPhysicalDeviceCount());
+  std::vector<vk::ImageMemoryBarrier2> graphicsToTransferQueueFamilyBarriersEnd;
+  std::vector<vk::ImageMemoryBarrier2> transferToGraphicsQueueFamilyBarriersBegin;
+  // Foveated or scaled render targets don't have the layout of the swapchain image, and devices skipping frames have no
+  // depth for them, so their depth can't be copied. The depth image is then only transitioned to the layout it is
+  // released in, and the frame is submitted without it.
+  bool copyDepth = p_renderTargets.depthImage && !g_app->getOptions().foveation &&
+                   !g_app->getOptions().dynamicResolution &&
+                   std::ranges::all_of(m_deviceLayouts, [](const DeviceLayout &p_layout) {
+                     return p_layout.updateInterval == 1;
+                   });
+  // Whichever submission writes to the swapchain images first waits for them to be ready.
+  bool transferWaitsForSwapchain = !m_compositor || copyDepth;
+  if (transferWaitsForSwapchain) {
+    renderDoneWaits.emplace_back(swapchainImageReadyWait);
+  }
+  if (!m_compositor) {
+    graphicsToTransferQueueFamilyBarriersEnd.emplace_back(vk::ImageMemoryBarrier2(
+        vk::PipelineStageFlagBits2::eAllCommands, vk::AccessFlagBits2::eNone, vk::PipelineStageFlagBits2::eTransfer,
+        vk::AccessFlagBits2::eTransferWrite, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal,
+        VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, p_renderTargets.colorImage,
+        {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1}));
+    transferToGraphicsQueueFamilyBarriersBegin.emplace_back(vk::ImageMemoryBarrier2(
+        vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
+        vk::PipelineStageFlagBits2::eAllCommands, vk::AccessFlagBits2::eMemoryRead,
+        vk::ImageLayout::eTransferDstOptimal, p_renderTargets.desiredColorImageLayoutOnRelease,
+        m_transferQueueFamily->getIndex(), m_graphicsQueueFamily->getIndex(), p_renderTargets.colorImage,
+        {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1}));
+  }
+  if (copyDepth) {
     graphicsToTransferQueueFamilyBarriersEnd.emplace_back(vk::ImageMemoryBarrier2(
         vk::PipelineStageFlagBits2::eAllCommands, vk::AccessFlagBits2::eNone, vk::PipelineStageFlagBits2::eTransfer,
         vk::AccessFlagBits2::eTransferWrite, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal,
@@ -470,14 +769,26 @@ void Renderer::buildFinalFrame(const UserInterface::FrameRenderTargets &p_render
                                 p_renderTargets.depthImage, {vk::ImageAspectFlagBits::eDepth, 0, 1, 0, 1}));
   }
 
-  std::vector<vk::ImageCopy2> colorRegions(this->getPhysicalDeviceCount());
+  std::vector<std::vector<vk::ImageCopy2>> colorRegions(this->getPhysicalDeviceCount());
   std::vector<vk::ImageCopy2> depthRegions(this->getPhysicalDeviceCount());
   std::vector<vk::CopyImageInfo2> copyImageInfos;
+  std::vector<Compositor::Layer> layers;
   for (uint32_t devIdx = 0; devIdx < this->getPhysicalDeviceCount(); ++devIdx) {
     vk::Image rtColorImage = m_renderTargets[devIdx].getColorResource(m_frameIndex).getImage();
     vk::Image rtDepthImage = m_renderTargets[devIdx].getDepthResource(m_frameIndex).getImage();
+    const vk::Rect2D &imageRect = m_deviceLayouts[devIdx].imageRect;
 
-    renderDoneWaits[devIdx] = {m_renderDoneSemaphores[devIdx].get(), 0, vk::PipelineStageFlagBits2::eAllCommands, 0};
+    renderDoneWaits[devIdx] = {m_renderDoneSemaphores[devIdx].get(), m_frameIndex + 1,
+                               vk::PipelineStageFlagBits2::eAllCommands, 0};
+    if (!this->isDeviceRenderingFrame(devIdx, m_frameIndex)) {
+      // The compositor reads the source image of the last frame the device has rendered, with that frame's regions.
+      uint64_t sourceFrameIndex = m_frameIndex - m_frameIndex % m_deviceLayouts[devIdx].updateInterval;
+      for (const DeviceRegion &region : m_deviceRegions[devIdx]) {
+        layers.emplace_back(
+            createCompositorLayer(devIdx, sourceFrameIndex, imageRect.extent, region.renderArea, region.destRect));
+      }
+      continue;
+    }
     graphicsToTransferQueueFamilyBarriersEnd.emplace_back(vk::ImageMemoryBarrier2(
         vk::PipelineStageFlagBits2::eColorAttachmentOutput, vk::AccessFlagBits2::eColorAttachmentWrite,
         vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferRead,
@@ -491,18 +802,41 @@ void Renderer::buildFinalFrame(const UserInterface::FrameRenderTargets &p_render
         m_graphicsQueueFamily->getIndex(), m_transferQueueFamily->getIndex(), rtDepthImage,
         {vk::ImageAspectFlagBits::eDepth, 0, 1, 0, 1}));
 
-    vk::Offset3D dstOffset((devIdx % 2) * m_resolutionPerPhysicalDevice.width,
-                           (devIdx / 2) * m_resolutionPerPhysicalDevice.height);
-    colorRegions[devIdx] = vk::ImageCopy2(
-        {vk::ImageAspectFlagBits::eColor, 0, 0, 1}, {0, 0, 0}, {vk::ImageAspectFlagBits::eColor, 0, 0, 1}, dstOffset,
-        {m_resolutionPerPhysicalDevice.width, m_resolutionPerPhysicalDevice.height, 1});
-    copyImageInfos.emplace_back(rtColorImage, vk::ImageLayout::eTransferSrcOptimal, p_renderTargets.colorImage,
+    vk::Offset3D dstOffset(imageRect.offset.x, imageRect.offset.y, 0);
+    vk::Image colorDest = p_renderTargets.colorImage;
+    if (m_compositor) {
+      colorDest = m_compositor->getSourceResource(m_frameIndex, devIdx).getImage();
+      graphicsToTransferQueueFamilyBarriersEnd.emplace_back(vk::ImageMemoryBarrier2(
+          vk::PipelineStageFlagBits2::eAllCommands, vk::AccessFlagBits2::eNone, vk::PipelineStageFlagBits2::eTransfer,
+          vk::AccessFlagBits2::eTransferWrite, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal,
+          VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, colorDest, {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1}));
+      transferToGraphicsQueueFamilyBarriersBegin.emplace_back(vk::ImageMemoryBarrier2(
+          vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
+          vk::PipelineStageFlagBits2::eFragmentShader, vk::AccessFlagBits2::eShaderSampledRead,
+          vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal,
+          m_transferQueueFamily->getIndex(), m_graphicsQueueFamily->getIndex(), colorDest,
+          {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1}));
+    }
+    for (const DeviceRegion &region : m_deviceRegions[devIdx]) {
+      // The compositor's source images have the layout of the render targets.
+      vk::Offset2D colorDstOffset = m_compositor ? region.renderArea.offset : region.destRect.offset;
+      colorRegions[devIdx].emplace_back(
+          vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1),
+          vk::Offset3D(region.renderArea.offset.x, region.renderArea.offset.y, 0),
+          vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1),
+          vk::Offset3D(colorDstOffset.x, colorDstOffset.y, 0), vk::Extent3D(region.renderArea.extent, 1));
+      if (m_compositor) {
+        layers.emplace_back(
+            createCompositorLayer(devIdx, m_frameIndex, imageRect.extent, region.renderArea, region.destRect));
+      }
+    }
+    copyImageInfos.emplace_back(rtColorImage, vk::ImageLayout::eTransferSrcOptimal, colorDest,
                                 vk::ImageLayout::eTransferDstOptimal, colorRegions[devIdx]);
 
-    if (p_renderTargets.depthImage) {
+    if (copyDepth) {
       depthRegions[devIdx] = vk::ImageCopy2(
           {vk::ImageAspectFlagBits::eDepth, 0, 0, 1}, {0, 0, 0}, {vk::ImageAspectFlagBits::eDepth, 0, 0, 1}, dstOffset,
-          {m_resolutionPerPhysicalDevice.width, m_resolutionPerPhysicalDevice.height, 1});
+          {imageRect.extent.width, imageRect.extent.height, 1});
       copyImageInfos.emplace_back(rtDepthImage, vk::ImageLayout::eTransferSrcOptimal, p_renderTargets.depthImage,
                                   vk::ImageLayout::eTransferDstOptimal, depthRegions[devIdx]);
     }
@@ -542,50 +876,173 @@ void Renderer::buildFinalFrame(const UserInterface::FrameRenderTargets &p_render
 
   vk::CommandBuffer finalCmdBuffer = m_graphicsQueueFamily->nextCommandBuffer();
   finalCmdBuffer.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
-  std::vector<vk::ImageMemoryBarrier2> finalBarriers = {{vk::PipelineStageFlagBits2::eTransfer,
-                                                         vk::AccessFlagBits2::eTransferWrite,
-                                                         vk::PipelineStageFlagBits2::eAllCommands,
-                                                         vk::AccessFlagBits2::eMemoryRead,
-                                                         vk::ImageLayout::eTransferDstOptimal,
-                                                         p_renderTargets.desiredColorImageLayoutOnRelease,
-                                                         m_transferQueueFamily->getIndex(),
-                                                         m_graphicsQueueFamily->getIndex(),
-                                                         p_renderTargets.colorImage,
-                                                         {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1}}};
-  if (p_renderTargets.depthImage) {
+  std::vector<vk::ImageMemoryBarrier2> finalBarriers;
+  if (m_compositor) {
+    for (uint32_t devIdx = 0; devIdx < this->getPhysicalDeviceCount(); ++devIdx) {
+      if (!this->isDeviceRenderingFrame(devIdx, m_frameIndex)) {
+        continue;
+      }
+      finalBarriers.emplace_back(vk::ImageMemoryBarrier2(
+          vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
+          vk::PipelineStageFlagBits2::eFragmentShader, vk::AccessFlagBits2::eShaderSampledRead,
+          vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal,
+          m_transferQueueFamily->getIndex(), m_graphicsQueueFamily->getIndex(),
+          m_compositor->getSourceResource(m_frameIndex, devIdx).getImage(),
+          {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1}));
+    }
+    finalBarriers.emplace_back(vk::ImageMemoryBarrier2(
+        vk::PipelineStageFlagBits2::eAllCommands, vk::AccessFlagBits2::eNone,
+        vk::PipelineStageFlagBits2::eColorAttachmentOutput, vk::AccessFlagBits2::eColorAttachmentWrite,
+        vk::ImageLayout::eUndefined, vk::ImageLayout::eColorAttachmentOptimal, VK_QUEUE_FAMILY_IGNORED,
+        VK_QUEUE_FAMILY_IGNORED, p_renderTargets.colorImage, {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1}));
+  } else {
+    finalBarriers.emplace_back(vk::ImageMemoryBarrier2(
+        vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
+        vk::PipelineStageFlagBits2::eAllCommands, vk::AccessFlagBits2::eMemoryRead,
+        vk::ImageLayout::eTransferDstOptimal, p_renderTargets.desiredColorImageLayoutOnRelease,
+        m_transferQueueFamily->getIndex(), m_graphicsQueueFamily->getIndex(), p_renderTargets.colorImage,
+        {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1}));
+  }
+  if (copyDepth) {
     finalBarriers.emplace_back(
         vk::ImageMemoryBarrier2(vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
                                 vk::PipelineStageFlagBits2::eAllCommands, vk::AccessFlagBits2::eMemoryRead,
                                 vk::ImageLayout::eTransferDstOptimal, p_renderTargets.desiredDepthImageLayoutOnRelease,
                                 m_transferQueueFamily->getIndex(), m_graphicsQueueFamily->getIndex(),
                                 p_renderTargets.depthImage, {vk::ImageAspectFlagBits::eDepth, 0, 1, 0, 1}));
+  } else if (p_renderTargets.depthImage) {
+    finalBarriers.emplace_back(vk::ImageMemoryBarrier2(
+        vk::PipelineStageFlagBits2::eAllCommands, vk::AccessFlagBits2::eNone, vk::PipelineStageFlagBits2::eAllCommands,
+        vk::AccessFlagBits2::eNone, vk::ImageLayout::eUndefined, p_renderTargets.desiredDepthImageLayoutOnRelease,
+        VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, p_renderTargets.depthImage,
+        {vk::ImageAspectFlagBits::eDepth, 0, 1, 0, 1}));
   }
   finalCmdBuffer.pipelineBarrier2({{}, {}, {}, finalBarriers});
+  if (m_compositor) {
+    vk::Rect2D renderArea;
+    for (const Compositor::Layer &layer : layers) {
+      renderArea.extent.width =
+          std::max(renderArea.extent.width, layer.destRect.offset.x + layer.destRect.extent.width);
+      renderArea.extent.height =
+          std::max(renderArea.extent.height, layer.destRect.offset.y + layer.destRect.extent.height);
+    }
+    g_app->getProfiler().pushDurationBegin("compose", m_frameIndex, 0, finalCmdBuffer);
+    m_compositor->compose(finalCmdBuffer, m_frameIndex, p_renderTargets.colorImage, renderArea, layers);
+    g_app->getProfiler().pushDurationEnd(finalCmdBuffer);
+    vk::ImageMemoryBarrier2 composedBarrier(
+        vk::PipelineStageFlagBits2::eColorAttachmentOutput, vk::AccessFlagBits2::eColorAttachmentWrite,
+        vk::PipelineStageFlagBits2::eAllCommands, vk::AccessFlagBits2::eMemoryRead,
+        vk::ImageLayout::eColorAttachmentOptimal, p_renderTargets.desiredColorImageLayoutOnRelease,
+        VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, p_renderTargets.colorImage,
+        {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1});
+    finalCmdBuffer.pipelineBarrier2({{}, {}, {}, composedBarrier});
+  }
   g_app->getProfiler().pushInstant("finalize", m_frameIndex, 0, finalCmdBuffer);
   finalCmdBuffer.end();
   vk::CommandBufferSubmitInfo finalCmdBufferSubmit(finalCmdBuffer, this->getDeviceMaskFirst());
+  std::vector<vk::SemaphoreSubmitInfo> finalWaits = {transferDoneSignalAndWait};
+  if (!transferWaitsForSwapchain) {
+    finalWaits.emplace_back(swapchainImageReadyWait);
+  }
   std::vector<vk::SemaphoreSubmitInfo> finalSignals = {
       {m_frameIndexSem.get(), m_frameIndex + 1, vk::PipelineStageFlagBits2::eAllCommands, 0}};
   if (vk::Semaphore frameReadySem = m_userInterface->getFrameReadySemaphore(); frameReadySem) {
     finalSignals.emplace_back(frameReadySem, 0, vk::PipelineStageFlagBits2::eAllCommands, 0);
   }
-  m_presentQueue.submit2(vk::SubmitInfo2({}, transferDoneSignalAndWait, finalCmdBufferSubmit, finalSignals));
+  if (g_app->getOptions().timewarp) {
+    // Written before the submission, so they are visible to the composition without further synchronization.
+    XRMG_SCOPED_INSTRUMENT("latch composition");
+    this->latchComposition();
+  }
+  m_presentQueue.submit2(vk::SubmitInfo2({}, finalWaits, finalCmdBufferSubmit, finalSignals));
+  return copyDepth;
 }
 
-Rect2Df Renderer::getDeviceViewport(uint32_t p_physicalDeviceIndex) const {
+void Renderer::latchComposition() {
+  // The reprojection transforms and the views submitted with the projection layer come from the same latch, so the
+  // runtime's own reprojection starts from the pose the final frame was composed for.
+  m_userInterface->latchCurrentFrameViews();
+  uint32_t layerIdx = 0;
+  for (uint32_t devIdx = 0; devIdx < this->getPhysicalDeviceCount(); ++devIdx) {
+    uint32_t viewIdx = m_deviceLayouts[devIdx].viewIndex;
+    const vk::Rect2D &imageRect = m_deviceLayouts[devIdx].imageRect;
+    StereoProjection proj = m_userInterface->getCurrentFrameProjection(viewIdx);
+    Mat4x4f reprojection = Compositor::createReprojection(
+        proj.projectionMatrix, this->getDeviceRelativeViewport(devIdx, proj.relativeViewport), m_renderViews[devIdx],
+        m_userInterface->getCurrentFrameView(viewIdx));
+    // The layers are in the same order as the device regions they were built from in buildFinalFrame.
+    for (const DeviceRegion &region : m_deviceRegions[devIdx]) {
+      auto width = static_cast<float>(imageRect.extent.width);
+      auto height = static_cast<float>(imageRect.extent.height);
+      Mat4x4f regionToImage =
+          Mat4x4f::createTranslation(static_cast<float>(region.destRect.offset.x - imageRect.offset.x) / width,
+                                     static_cast<float>(region.destRect.offset.y - imageRect.offset.y) / height,
+                                     0.0f) *
+          Mat4x4f::createScaling(static_cast<float>(region.destRect.extent.width) / width,
+                                 static_cast<float>(region.destRect.extent.height) / height, 1.0f);
+      m_compositor->setLayerTransform(m_frameIndex, layerIdx++, regionToImage.invert() * reprojection * regionToImage);
+    }
+  }
+}
+
+Rect2Df Renderer::getDeviceRelativeViewport(uint32_t p_physicalDeviceIndex, const Rect2Df &p_viewViewport) const {
   XRMG_ASSERT(p_physicalDeviceIndex < this->getPhysicalDeviceCount(),
               "Phyiscal device index ({}) must be less than the number of physical device ({})", p_physicalDeviceIndex,
               this->getPhysicalDeviceCount());
-  if (this->getPhysicalDeviceCount() == 2) {
-    // Each device renders the full viewport of the left and right eye, respectively.
-    return {.x = 0.0f, .y = 0.0f, .width = 1.0f, .height = 1.0f};
-  } else if (this->getPhysicalDeviceCount() == 4) {
-    // Device 0 and 2 render the left eye, device 1 and 3 render the right eye.
-    return p_physicalDeviceIndex < 2 ? Rect2Df{.x = 0.0f, .y = 0.0f, .width = 1.0f, .height = 0.5f}
-                                     : Rect2Df{.x = 0.0f, .y = 0.5f, .width = 1.0f, .height = 0.5f};
-  }
-  XRMG_FATAL("{} physical devices not supported.", this->getPhysicalDeviceCount());
-  return {};
+  const Rect2Df &deviceViewport = m_deviceLayouts[p_physicalDeviceIndex].viewport;
+  return {.x = p_viewViewport.x - deviceViewport.x / deviceViewport.width,
+          .y = p_viewViewport.y - deviceViewport.y / deviceViewport.height,
+          .width = p_viewViewport.width / deviceViewport.width,
+          .height = p_viewViewport.height / deviceViewport.height};
+}
+
+std::vector<Renderer::DeviceRegion> Renderer::computeDeviceRegions(uint32_t p_physicalDeviceIndex,
+                                                                   const StereoProjection &p_projection,
+                                                                   const Rect2Df &p_deviceViewport) const {
+  const vk::Rect2D &imageRect = m_deviceLayouts[p_physicalDeviceIndex].imageRect;
+  // With dynamic resolution, all regions are rendered at a fraction of their size and upscaled by the compositor.
+  float scale = m_resolutionGovernor ? m_resolutionGovernor->getScale(p_physicalDeviceIndex) : 1.0f;
+  auto scaleExtent = [scale](uint32_t p_width, uint32_t p_height) {
+    return vk::Extent2D(std::max(1u, static_cast<uint32_t>(std::ceil(scale * static_cast<float>(p_width)))),
+                        std::max(1u, static_cast<uint32_t>(std::ceil(scale * static_cast<float>(p_height)))));
+  };
+  const std::optional<Options::FoveationCenter> &foveation = g_app->getOptions().foveation;
+  if (!foveation) {
+    return {{.renderArea = {{0, 0}, scaleExtent(imageRect.extent.width, imageRect.extent.height)},
+             .destRect = imageRect}};
+  }
+
+  // The periphery covers the whole image at reduced resolution. The full resolution inset is rendered next to it.
+  auto width = static_cast<float>(imageRect.extent.width);
+  auto height = static_cast<float>(imageRect.extent.height);
+  vk::Extent2D peripheryExtent = scaleExtent(static_cast<uint32_t>(std::ceil(FOVEATION_PERIPHERY_SCALE * width)),
+                                             static_cast<uint32_t>(std::ceil(FOVEATION_PERIPHERY_SCALE * height)));
+  std::vector<DeviceRegion> regions = {{.renderArea = {{0, 0}, peripheryExtent}, .destRect = imageRect}};
+
+  // The mock gaze wanders around the lens center.
+  Vec2f center = p_projection.getLensCenter();
+  if (foveation.value() == Options::FoveationCenter::MOCK_GAZE) {
+    center.x += 0.4f * std::sin(1.1e-3f * m_runtimeMillis);
+    center.y += 0.3f * std::sin(1.7e-3f * m_runtimeMillis);
+  }
+  float centerX = (p_deviceViewport.x + (0.5f * center.x + 0.5f) * p_deviceViewport.width) * width;
+  float centerY = (p_deviceViewport.y + (0.5f * center.y + 0.5f) * p_deviceViewport.height) * height;
+  float halfInsetWidth = 0.5f * FOVEATION_INSET_SIZE * p_deviceViewport.width * width;
+  float halfInsetHeight = 0.5f * FOVEATION_INSET_SIZE * p_deviceViewport.height * height;
+  auto left = static_cast<uint32_t>(std::clamp(std::floor(centerX - halfInsetWidth), 0.0f, width));
+  auto top = static_cast<uint32_t>(std::clamp(std::floor(centerY - halfInsetHeight), 0.0f, height));
+  auto right = static_cast<uint32_t>(std::clamp(std::ceil(centerX + halfInsetWidth), 0.0f, width));
+  auto bottom = static_cast<uint32_t>(std::clamp(std::ceil(centerY + halfInsetHeight), 0.0f, height));
+  vk::Extent2D insetExtent(std::min(right - left, imageRect.extent.width - peripheryExtent.width), bottom - top);
+  if (insetExtent.width != 0 && insetExtent.height != 0) {
+    regions.emplace_back(DeviceRegion{
+        .renderArea = {{static_cast<int32_t>(peripheryExtent.width), 0},
+                       scaleExtent(insetExtent.width, insetExtent.height)},
+        .destRect = {{imageRect.offset.x + static_cast<int32_t>(left), imageRect.offset.y + static_cast<int32_t>(top)},
+                     insetExtent},
+    });
+  }
+  return regions;
 }
 
 uint32_t Renderer::getPhysicalDeviceCount() const {
@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "ResolutionGovernor.hpp"
+
+#include "Renderer.hpp"
+
+namespace xrmg {
+ResolutionGovernor::ResolutionGovernor(const Renderer &p_renderer)
+    : m_renderer(p_renderer),
+      m_timestampPeriod(p_renderer.getPhysicalDevice(0).getProperties().limits.timestampPeriod),
+      m_scales(p_renderer.getPhysicalDeviceCount(), 1.0f) {
+  // A begin and an end timestamp per frame slot and physical device.
+  m_queryPool = p_renderer.vkDevice().createQueryPoolUnique(
+      {{}, vk::QueryType::eTimestamp, 2 * MAX_QUEUED_FRAMES * p_renderer.getPhysicalDeviceCount()});
+}
+
+uint32_t ResolutionGovernor::getQueryIndex(uint64_t p_frameIndex, uint32_t p_physicalDeviceIndex) const {
+  return 2 * (static_cast<uint32_t>(p_frameIndex % MAX_QUEUED_FRAMES) * m_renderer.getPhysicalDeviceCount() +
+              p_physicalDeviceIndex);
+}
+
+void ResolutionGovernor::writeRenderBegin(vk::CommandBuffer p_cmdBuffer, uint64_t p_frameIndex,
+                                          uint32_t p_physicalDeviceIndex) {
+  uint32_t queryIdx = this->getQueryIndex(p_frameIndex, p_physicalDeviceIndex);
+  p_cmdBuffer.resetQueryPool(m_queryPool.get(), queryIdx, 2);
+  // The frame's semaphore waits, e.g. for the instance broadcast, gate the transfers the rendering starts with at the
+  // latest. A top of pipe timestamp would include the time spent waiting, which isn't the device's rendering time.
+  p_cmdBuffer.writeTimestamp2(vk::PipelineStageFlagBits2::eTransfer, m_queryPool.get(), queryIdx);
+}
+
+void ResolutionGovernor::writeRenderEnd(vk::CommandBuffer p_cmdBuffer, uint64_t p_frameIndex,
+                                        uint32_t p_physicalDeviceIndex) {
+  p_cmdBuffer.writeTimestamp2(vk::PipelineStageFlagBits2::eBottomOfPipe, m_queryPool.get(),
+                              this->getQueryIndex(p_frameIndex, p_physicalDeviceIndex) + 1);
+}
+
+void ResolutionGovernor::update(uint64_t p_frameIndex, std::optional<uint64_t> p_displayPeriodNanos) {
+  float budgetNanos =
+      BUDGET_FRACTION * static_cast<float>(p_displayPeriodNanos.value_or(DEFAULT_DISPLAY_PERIOD_NANOS));
+  for (uint32_t devIdx = 0; devIdx < m_renderer.getPhysicalDeviceCount(); ++devIdx) {
+    if (!m_renderer.isDeviceRenderingFrame(devIdx, p_frameIndex)) {
+      continue;
+    }
+    auto [result, timestamps] = m_renderer.vkDevice().getQueryPoolResults<uint64_t>(
+        m_queryPool.get(), this->getQueryIndex(p_frameIndex, devIdx), 2, 2 * sizeof(uint64_t), sizeof(uint64_t),
+        vk::QueryResultFlagBits::e64);
+    if (result != vk::Result::eSuccess) {
+      XRMG_WARN("Getting render timestamps of physical device {} failed: {}", devIdx, vk::to_string(result));
+      continue;
+    }
+    float gpuNanos = m_timestampPeriod * static_cast<float>(timestamps[1] - timestamps[0]);
+    if (gpuNanos <= 0.0f) {
+      continue;
+    }
+    // The GPU time is roughly proportional to the pixel count, i.e. to the square of the scale. Overloads are corrected
+    // at once to avoid dropped frames, while the resolution is raised slowly to avoid oscillation.
+    float targetScale = std::clamp(m_scales[devIdx] * std::sqrt(budgetNanos / gpuNanos), MIN_SCALE, 1.0f);
+    m_scales[devIdx] =
+        targetScale < m_scales[devIdx] ? targetScale : m_scales[devIdx] + 0.1f * (targetScale - m_scales[devIdx]);
+  }
+}
+} // namespace xrmg
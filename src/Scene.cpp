@@ -19,6 +19,9 @@
 #include "Scene.hpp"
 
 #include "App.hpp"
+#include "DeviceMemoryAllocator.hpp"
+#include "MeshUploader.hpp"
+#include "PipelineStatistics.hpp"
 
 #include "shaders.hpp"
 
@@ -27,17 +30,19 @@ static const std::vector<vk::VertexInputAttributeDescription> g_vertexInputAttri
     {0, 0, vk::Format::eR32G32B32Sfloat, offsetof(TriangleMesh::Vertex, pos)},
     {1, 0, vk::Format::eR32G32B32Sfloat, offsetof(TriangleMesh::Vertex, normal)},
     {2, 0, vk::Format::eR32G32Sfloat, offsetof(TriangleMesh::Vertex, tex)},
-    {3, 1, vk::Format::eR32G32B32A32Sfloat, offsetof(Instance, modelToWorld.rows[0])},
-    {4, 1, vk::Format::eR32G32B32A32Sfloat, offsetof(Instance, modelToWorld.rows[1])},
-    {5, 1, vk::Format::eR32G32B32A32Sfloat, offsetof(Instance, modelToWorld.rows[2])},
-    {6, 1, vk::Format::eR32G32B32A32Sfloat, offsetof(Instance, modelToWorld.rows[3])},
-    {7, 1, vk::Format::eR32G32B32A32Sfloat, offsetof(Instance, modelToWorldIT.rows[0])},
-    {8, 1, vk::Format::eR32G32B32A32Sfloat, offsetof(Instance, modelToWorldIT.rows[1])},
-    {9, 1, vk::Format::eR32G32B32A32Sfloat, offsetof(Instance, modelToWorldIT.rows[2])},
-    {10, 1, vk::Format::eR32G32B32A32Sfloat, offsetof(Instance, modelToWorldIT.rows[3])},
-    {11, 1, vk::Format::eR32Uint, offsetof(Instance, colorHint)},
-    {12, 1, vk::Format::eR32Sfloat, offsetof(Instance, relativeExtrusion)},
-    {13, 1, vk::Format::eR32Sfloat, offsetof(Instance, absoluteExtrusion)},
+    {3, 1, vk::Format::eR32G32B32A32Sfloat, offsetof(Instance, modelToWorld[0])},
+    {4, 1, vk::Format::eR32G32B32A32Sfloat, offsetof(Instance, modelToWorld[1])},
+    {5, 1, vk::Format::eR32G32B32A32Sfloat, offsetof(Instance, modelToWorld[2])},
+    {6, 1, vk::Format::eR32Uint, offsetof(Instance, colorHint)},
+    {7, 1, vk::Format::eR32Sfloat, offsetof(Instance, relativeExtrusion)},
+    {8, 1, vk::Format::eR32Sfloat, offsetof(Instance, absoluteExtrusion)},
+};
+
+// Replace the vertex attributes of g_vertexInputAttributeDescs with --compact-vertices.
+static const std::vector<vk::VertexInputAttributeDescription> g_compactVertexInputAttributeDescs = {
+    {0, 0, vk::Format::eR16G16B16A16Snorm, offsetof(TriangleMesh::CompactVertex, pos)},
+    {1, 0, vk::Format::eR16G16Snorm, offsetof(TriangleMesh::CompactVertex, normal)},
+    {2, 0, vk::Format::eR16G16Unorm, offsetof(TriangleMesh::CompactVertex, tex)},
 };
 
 static const std::vector<vk::VertexInputBindingDescription> g_vertexInputBindingDescs = {
@@ -48,57 +53,228 @@ static const std::vector<vk::VertexInputBindingDescription> g_vertexInputBinding
 struct Camera {
   Mat4x4f view;
   Mat4x4f projection;
+  Vec4f clipBounds;
 };
 
 const uint32_t MAX_TORUS_INSTANCE_COUNT =
     8 * Scene::MAX_BASE_TORUS_COUNT * Scene::MAX_BASE_TORUS_COUNT * Scene::MAX_TORUS_LAYER_COUNT;
+// The torus meshes only hold the instances of the cage; the rest are the planes.
+const uint32_t MAX_VISIBLE_INSTANCE_COUNT = MAX_TORUS_INSTANCE_COUNT + 64;
+// Coarsest torus tessellation of the LOD selection, like the one selectable at runtime.
+const uint32_t MIN_LOD_TESSELATION = 8;
+// Instance storage grows geometrically, starting at this many instances.
+const uint32_t MIN_INSTANCE_CAPACITY = 16;
+
+// Color hint of a torus of the cage, shared by its layers. Derived from the torus index rather than rand(), which
+// isn't meant to be called from several threads.
+static uint32_t hashColorHint(uint32_t p_torusIndex) {
+  uint32_t h = p_torusIndex * 0x9e3779b9u;
+  h = (h ^ (h >> 16)) * 0x85ebca6bu;
+  h = (h ^ (h >> 13)) * 0xc2b2ae35u;
+  return h ^ (h >> 16);
+}
+
+// Writes the layered torus instances of a plane of the cage, torus by torus. Only touches the given instances, so it
+// can run on a worker thread.
+static void createChainMailPlane(Instance *p_instances, uint32_t p_firstTorusIndex, uint32_t p_horizontalTorusCount,
+                                 uint32_t p_verticalTorusCount, uint32_t p_layerCount, float p_maxExtrusion,
+                                 const Mat4x4f &p_transform) {
+  for (uint32_t i = 0; i < p_horizontalTorusCount; ++i) {
+    for (uint32_t j = 0; j < p_verticalTorusCount; ++j) {
+      float x = static_cast<float>(i) - 0.5f * static_cast<float>(p_horizontalTorusCount - 1);
+      float y = static_cast<float>(j) - 0.5f * static_cast<float>(p_verticalTorusCount - 1);
+      Mat4x4f finalTransform =
+          p_transform * Mat4x4f::createTranslation(x + 0.5f * static_cast<float>(j % 2), 0.5f * y, 0.0f) *
+          Mat4x4f::createRotation({}, (2.0f * static_cast<float>(j % 2) - 1.0f) * Angle::deg(20.0f), {});
+      uint32_t torusIdx = i * p_verticalTorusCount + j;
+      uint32_t colorHint = hashColorHint(p_firstTorusIndex + torusIdx);
+      for (uint32_t k = 0; k < p_layerCount; ++k) {
+        Instance &instance = p_instances[torusIdx * p_layerCount + k];
+        instance = {.colorHint = colorHint};
+        instance.setTransform(finalTransform);
+        instance.relativeExtrusion = static_cast<float>(k) / static_cast<float>(p_layerCount);
+        instance.absoluteExtrusion = p_maxExtrusion * instance.relativeExtrusion;
+      }
+    }
+  }
+}
+
+// World space bounding sphere of an instance. The fur layers are extruded along the normals, which grows the bounding
+// sphere by the extrusion.
+static Vec4f computeBoundingSphere(const Vec4f &p_meshSphere, const Instance &p_instance) {
+  Mat4x4f m = p_instance.getTransform();
+  float maxScaleSquared = 0.0f;
+  for (uint32_t j = 0; j < 3; ++j) {
+    maxScaleSquared = std::max(maxScaleSquared, m.v[0][j] * m.v[0][j] + m.v[1][j] * m.v[1][j] + m.v[2][j] * m.v[2][j]);
+  }
+  Vec3f center = m.transformCoord({p_meshSphere.x, p_meshSphere.y, p_meshSphere.z});
+  return {center.x, center.y, center.z, std::sqrt(maxScaleSquared) * (p_meshSphere.w + p_instance.absoluteExtrusion)};
+}
+
+// Grows an instance range, given as first and end instance, to cover another one.
+static void extendRange(std::pair<uint32_t, uint32_t> &p_range, uint32_t p_first, uint32_t p_end) {
+  if (p_range.second <= p_range.first) {
+    p_range = {p_first, p_end};
+  } else {
+    p_range = {std::min(p_range.first, p_first), std::max(p_range.second, p_end)};
+  }
+}
 
 Scene::Scene(const Renderer &p_renderer) : m_renderer(p_renderer), m_currentBufferIndex(0) {
-  vk::UniqueShaderModule layeredMeshModule = p_renderer.vkDevice().createShaderModuleUnique({{}, g_layeredMeshSrc});
+  // With variable rate shading, the vertex shader selects a coarse shading rate for deeply extruded layers. Mesh
+  // shading leaves the per primitive rate at full rate.
+  const std::optional<std::pair<uint32_t, uint32_t>> &variableRateShading = g_app->getOptions().variableRateShading;
+  bool meshShading = g_app->getOptions().meshShading;
+  vk::UniqueShaderModule layeredMeshModule = p_renderer.vkDevice().createShaderModuleUnique(
+      {{},
+       meshShading           ? g_layeredMeshletsSrc
+       : variableRateShading ? g_layeredMeshVrsSrc
+                             : g_layeredMeshSrc});
+  bool compactVertices = g_app->getOptions().compactVertices;
+  struct {
+    float coarseRateExtrusion;
+    vk::Bool32 compactVertices;
+  } specialization = {variableRateShading ? 0.01f * static_cast<float>(variableRateShading.value().second) : 1.0f,
+                      compactVertices};
+  std::array<vk::SpecializationMapEntry, 2> specializationEntries = {
+      vk::SpecializationMapEntry(0, offsetof(decltype(specialization), coarseRateExtrusion), sizeof(float)),
+      vk::SpecializationMapEntry(1, offsetof(decltype(specialization), compactVertices), sizeof(vk::Bool32))};
+  vk::SpecializationInfo geometrySpecialization(static_cast<uint32_t>(specializationEntries.size()),
+                                                specializationEntries.data(), sizeof(specialization), &specialization);
   std::vector<vk::PipelineShaderStageCreateInfo> stages = {
-      {{}, vk::ShaderStageFlagBits::eVertex, layeredMeshModule.get(), "vs"},
+      {{}, vk::ShaderStageFlagBits::eVertex, layeredMeshModule.get(), variableRateShading ? "vsVrs" : "vs",
+       &geometrySpecialization},
       {{}, vk::ShaderStageFlagBits::eFragment, layeredMeshModule.get(), "fs"}};
+  if (meshShading) {
+    stages = {{{}, vk::ShaderStageFlagBits::eTaskEXT, layeredMeshModule.get(), "ts", &geometrySpecialization},
+              {{}, vk::ShaderStageFlagBits::eMeshEXT, layeredMeshModule.get(), "ms", &geometrySpecialization},
+              {{}, vk::ShaderStageFlagBits::eFragment, layeredMeshModule.get(), "fs"}};
+  }
 
-  vk::PipelineVertexInputStateCreateInfo vertexInputState({}, g_vertexInputBindingDescs, g_vertexInputAttributeDescs);
-  vk::PipelineInputAssemblyStateCreateInfo inputAssemblyState({}, vk::PrimitiveTopology::eTriangleStrip, true);
+  std::vector<vk::VertexInputAttributeDescription> vertexInputAttributeDescs = g_vertexInputAttributeDescs;
+  std::vector<vk::VertexInputBindingDescription> vertexInputBindingDescs = g_vertexInputBindingDescs;
+  if (compactVertices) {
+    std::ranges::copy(g_compactVertexInputAttributeDescs, vertexInputAttributeDescs.begin());
+    vertexInputBindingDescs[0].setStride(sizeof(TriangleMesh::CompactVertex));
+  }
+  vk::PipelineVertexInputStateCreateInfo vertexInputState({}, vertexInputBindingDescs, vertexInputAttributeDescs);
+  // Triangle lists don't need the primitive restart, which would require an extra feature for them.
+  bool triangleLists = g_app->getOptions().triangleLists.has_value();
+  vk::PipelineInputAssemblyStateCreateInfo inputAssemblyState(
+      {}, triangleLists ? vk::PrimitiveTopology::eTriangleList : vk::PrimitiveTopology::eTriangleStrip, !triangleLists);
   vk::PipelineViewportStateCreateInfo viewportState({}, 1, nullptr, 1, nullptr);
   vk::PipelineRasterizationStateCreateInfo rasterizationState(
       {}, false, false, vk::PolygonMode::eFill, vk::CullModeFlagBits::eNone, vk::FrontFace::eCounterClockwise, false,
       0.0f, 0.0f, 0.0f, 1.0f);
-  vk::PipelineMultisampleStateCreateInfo multisampleState({}, vk::SampleCountFlagBits::e1);
+  vk::PipelineMultisampleStateCreateInfo multisampleState({}, g_app->getOptions().sampleCount);
   vk::PipelineDepthStencilStateCreateInfo depthStencilState({}, true, true, vk::CompareOp::eLess, false, false);
   vk::PipelineColorBlendAttachmentState blendAttachment(false);
   blendAttachment.setColorWriteMask(vk::FlagTraits<vk::ColorComponentFlagBits>::allFlags);
   vk::PipelineColorBlendStateCreateInfo colorBlendState({}, false, {}, blendAttachment);
   std::vector<vk::DynamicState> dynamicStates = {vk::DynamicState::eViewport, vk::DynamicState::eScissor};
   vk::PipelineDynamicStateCreateInfo dynamicState({}, dynamicStates);
-  std::vector<vk::DescriptorSetLayoutBinding> bindings = {};
-  vk::UniqueDescriptorSetLayout setLayout = p_renderer.vkDevice().createDescriptorSetLayoutUnique({{}, bindings});
-  std::vector<vk::PushConstantRange> pushConstantRanges = {{vk::ShaderStageFlagBits::eVertex, 0, sizeof(Camera)}};
-  m_pipelineLayout = p_renderer.vkDevice().createPipelineLayoutUnique({{}, setLayout.get(), pushConstantRanges});
+  // The camera is read from a host visible uniform buffer instead of push constants, so its view matrix can still be
+  // updated after the command buffers have been recorded (late latching).
+  vk::ShaderStageFlags cameraStages = meshShading
+                                         ? vk::ShaderStageFlagBits::eTaskEXT | vk::ShaderStageFlagBits::eMeshEXT
+                                         : vk::ShaderStageFlagBits::eVertex;
+  std::vector<vk::DescriptorSetLayoutBinding> bindings = {
+      {0, vk::DescriptorType::eUniformBufferDynamic, 1, cameraStages}};
+  m_descriptorSetLayout = p_renderer.vkDevice().createDescriptorSetLayoutUnique({{}, bindings});
+  std::vector<vk::DescriptorSetLayout> setLayouts = {m_descriptorSetLayout.get()};
+  std::vector<vk::PushConstantRange> pushConstantRanges;
+  if (meshShading) {
+    m_meshletRenderer = std::make_unique<MeshletRenderer>(p_renderer);
+    std::ranges::copy(m_meshletRenderer->getDescriptorSetLayouts(), std::back_inserter(setLayouts));
+    pushConstantRanges.push_back(m_meshletRenderer->getPushConstantRange());
+  } else {
+    // The vertex shader decodes compact vertices with the bounds of the mesh being drawn.
+    pushConstantRanges.push_back({vk::ShaderStageFlagBits::eVertex, 0, sizeof(TriangleMesh::PositionBounds)});
+  }
+  m_pipelineLayout = p_renderer.vkDevice().createPipelineLayoutUnique({{}, setLayouts, pushConstantRanges});
+  // The per primitive rate replaces the pipeline's full rate; the coarser of it and the attachment's rate is used.
+  vk::FragmentShadingRateCombinerOpKHR combinerOp = vk::FragmentShadingRateCombinerOpKHR::eMax;
+  if (variableRateShading &&
+      !p_renderer.getPhysicalDevice(0)
+           .getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceFragmentShadingRatePropertiesKHR>()
+           .get<vk::PhysicalDeviceFragmentShadingRatePropertiesKHR>()
+           .fragmentShadingRateNonTrivialCombinerOps) {
+    XRMG_WARN("Shading rate combiner max not supported; the attachment's rate replaces the per primitive rate.");
+    combinerOp = vk::FragmentShadingRateCombinerOpKHR::eReplace;
+  }
   vk::StructureChain pipelineCreateChain(
-      vk::GraphicsPipelineCreateInfo({}, stages, &vertexInputState, &inputAssemblyState, nullptr, &viewportState,
+      vk::GraphicsPipelineCreateInfo({}, stages, meshShading ? nullptr : &vertexInputState,
+                                     meshShading ? nullptr : &inputAssemblyState, nullptr, &viewportState,
                                      &rasterizationState, &multisampleState, &depthStencilState, &colorBlendState,
                                      &dynamicState, m_pipelineLayout.get()),
-      vk::PipelineRenderingCreateInfo(0, g_renderFormat, g_depthFormat));
+      vk::PipelineRenderingCreateInfo(0, g_renderFormat, g_depthFormat),
+      vk::PipelineFragmentShadingRateStateCreateInfoKHR(
+          vk::Extent2D(1, 1), {vk::FragmentShadingRateCombinerOpKHR::eReplace, combinerOp}));
+  if (!variableRateShading) {
+    pipelineCreateChain.unlink<vk::PipelineFragmentShadingRateStateCreateInfoKHR>();
+  }
   auto [createPipelineResult, pipeline] =
       p_renderer.vkDevice().createGraphicsPipelineUnique(p_renderer.getPipelineCache(), pipelineCreateChain.get());
   XRMG_ASSERT(createPipelineResult == vk::Result::eSuccess, "Pipeline creation failed.");
   m_pipeline = std::move(pipeline);
+  // Resolving depth to the nearest sample keeps silhouettes in front for the runtime's depth based reprojection.
+  auto depthStencilResolveProps =
+      p_renderer.getPhysicalDevice(0)
+          .getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceDepthStencilResolveProperties>()
+          .get<vk::PhysicalDeviceDepthStencilResolveProperties>();
+  if (depthStencilResolveProps.supportedDepthResolveModes & vk::ResolveModeFlagBits::eMin) {
+    m_depthResolveMode = vk::ResolveModeFlagBits::eMin;
+  }
 
   std::optional<uint32_t> uploadMemTypeIndex = p_renderer.queryCompatibleMemoryTypeIndex(
       0, vk::MemoryPropertyFlagBits::eHostCached | vk::MemoryPropertyFlagBits::eHostCoherent |
              vk::MemoryPropertyFlagBits::eHostVisible);
   XRMG_ASSERT(uploadMemTypeIndex, "No host cached, visible, and coherent memory type for upload buffers available.");
-  m_uploadMemPool.size = 2ull << 30;
-  m_uploadMemPool.memory =
-      p_renderer.vkDevice().allocateMemoryUnique({m_uploadMemPool.size, uploadMemTypeIndex.value()});
-  m_uploadMemPool.mapped =
-      reinterpret_cast<char *>(p_renderer.vkDevice().mapMemory(m_uploadMemPool.memory.get(), 0, m_uploadMemPool.size));
-  m_uploadBuffer = p_renderer.vkDevice().createBufferUnique(
-      {{}, m_uploadMemPool.size, vk::BufferUsageFlagBits::eTransferSrc, vk::SharingMode::eExclusive, {}});
-  p_renderer.vkDevice().bindBufferMemory(m_uploadBuffer.get(), m_uploadMemPool.memory.get(), 0);
+  m_uploadMemTypeIndex = uploadMemTypeIndex.value();
+
+  // One camera per frame slot and physical device.
+  m_cameraStride = XRMG_ALIGN(sizeof(Camera),
+                              p_renderer.getPhysicalDevice(0).getProperties().limits.minUniformBufferOffsetAlignment);
+  vk::DeviceSize cameraBufferSize = MAX_QUEUED_FRAMES * p_renderer.getPhysicalDeviceCount() * m_cameraStride;
+  m_cameraBuffer = p_renderer.vkDevice().createBufferUnique(
+      {{}, cameraBufferSize, vk::BufferUsageFlagBits::eUniformBuffer, vk::SharingMode::eExclusive, {}});
+  vk::MemoryRequirements cameraMemReqs = p_renderer.vkDevice().getBufferMemoryRequirements(m_cameraBuffer.get());
+  std::optional<uint32_t> cameraMemTypeIndex = p_renderer.queryCompatibleMemoryTypeIndex(
+      0, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+      cameraMemReqs.memoryTypeBits);
+  XRMG_ASSERT(cameraMemTypeIndex, "No host visible and coherent memory type for the camera buffer available.");
+  m_cameraMemory = p_renderer.vkDevice().allocateMemoryUnique({cameraMemReqs.size, cameraMemTypeIndex.value()});
+  m_mappedCameras =
+      reinterpret_cast<char *>(p_renderer.vkDevice().mapMemory(m_cameraMemory.get(), 0, cameraMemReqs.size));
+  p_renderer.vkDevice().bindBufferMemory(m_cameraBuffer.get(), m_cameraMemory.get(), 0);
 
+  vk::DescriptorPoolSize poolSize(vk::DescriptorType::eUniformBufferDynamic, 1);
+  m_descriptorPool = p_renderer.vkDevice().createDescriptorPoolUnique({{}, 1, poolSize});
+  m_cameraDescriptorSet =
+      p_renderer.vkDevice().allocateDescriptorSets({m_descriptorPool.get(), m_descriptorSetLayout.get()}).front();
+  vk::DescriptorBufferInfo cameraBufferInfo(m_cameraBuffer.get(), 0, sizeof(Camera));
+  p_renderer.vkDevice().updateDescriptorSets(
+      vk::WriteDescriptorSet(m_cameraDescriptorSet, 0, 0, vk::DescriptorType::eUniformBufferDynamic, {},
+                             cameraBufferInfo),
+      {});
+  if (g_app->getOptions().gpuCulling) {
+    m_instanceCuller = std::make_unique<InstanceCuller>(p_renderer, m_cameraBuffer.get(), sizeof(Camera));
+    m_depthPyramidFrameIndices.resize(p_renderer.getPhysicalDeviceCount());
+  }
+  if (g_app->getOptions().cpuCulling) {
+    XRMG_WARN_IF(g_app->getOptions().lateLatching,
+                 "CPU culling uses the view at recording time; instances may be missing at the edges of late latched "
+                 "views.");
+    m_visibleUploadRing = std::make_unique<FrameUploadRing>(p_renderer, uploadMemTypeIndex.value(),
+                                                            vk::BufferUsageFlagBits::eTransferSrc);
+    m_cullFrusta.resize(p_renderer.getPhysicalDeviceCount(), {UINT64_MAX, {}});
+  } else {
+    // The broadcast buffer follows the capacity of the instance arenas, see update.
+    m_broadcastingInstances = 1 < p_renderer.getPhysicalDeviceCount();
+  }
+  m_cameraFrameIndices.resize(p_renderer.getPhysicalDeviceCount(), UINT64_MAX);
+
+  m_torusArenaIndex = this->pushInstanceArena(MAX_TORUS_INSTANCE_COUNT);
   this->pushTriangleMeshSingleInstance(&TriangleMesh::createPlaneXZ, Mat4x4f::createScaling(4.0f));
   m_projectionPlane = this->pushTriangleMeshSingleInstance(TriangleMesh::createPlaneXZ, Mat4x4f::IDENTITY);
 
@@ -111,49 +287,114 @@ Scene::TriangleMeshIndex Scene::getTorusMeshIndex(uint32_t p_baseTesselationCoun
   }
   float minorRadius = 0.05f;
   float majorRadius = 0.45f;
-  TriangleMeshIndex idx = this->pushTriangleMesh(
-      [&](const Renderer &p_renderer, uint32_t p_maxInstances, size_t p_sizePerInstance) {
-        return TriangleMesh::createTorusXY(p_renderer, p_maxInstances, p_sizePerInstance, p_baseTesselationCount,
-                                           minorRadius, majorRadius);
+  TriangleMeshIndex idx = this->pushArenaTriangleMesh(
+      [&](const Renderer &p_renderer) {
+        return TriangleMesh::createTorusXY(p_renderer, p_baseTesselationCount, minorRadius, majorRadius);
       },
-      MAX_TORUS_INSTANCE_COUNT);
+      m_torusArenaIndex);
   return m_torusLods.emplace(p_baseTesselationCount, idx).first->second;
 }
 
 void Scene::buildCage(uint32_t p_baseTorusTesselationCount, uint32_t p_baseTorusCount, uint32_t p_torusLayerCount) {
-  uint32_t torusCount = 8 * p_baseTorusCount * p_baseTorusCount * p_torusLayerCount;
-  uint32_t triangleCount = torusCount * 4 * p_baseTorusTesselationCount * p_baseTorusTesselationCount;
+  CageParameters parameters = {p_baseTorusTesselationCount, p_baseTorusCount, p_torusLayerCount};
+  if (m_cageBuild) {
+    m_queuedCage = parameters;
+  } else {
+    this->startCageBuild(parameters);
+  }
+}
+
+void Scene::startCageBuild(const CageParameters &p_parameters) {
+  uint32_t torusCount = 8 * p_parameters.baseTorusCount * p_parameters.baseTorusCount * p_parameters.torusLayerCount;
+  uint32_t triangleCount =
+      torusCount * 4 * p_parameters.baseTorusTesselationCount * p_parameters.baseTorusTesselationCount;
   std::string triangleCountStr =
       triangleCount < 1000000 ? std::to_string(triangleCount) : std::format("{}M", triangleCount / 1000000);
   XRMG_INFO("base torus tesselation: {}, base torus count: {}, torus layer count: {} -> {} instances, {} triangles",
-            p_baseTorusTesselationCount, p_baseTorusCount, p_torusLayerCount, torusCount, triangleCountStr);
-  for (auto &[baseTesselationCount, torusMeshIndex] : m_torusLods) {
-    m_triangleMeshes[torusMeshIndex].instanceCount = 0;
+            p_parameters.baseTorusTesselationCount, p_parameters.baseTorusCount, p_parameters.torusLayerCount,
+            torusCount, triangleCountStr);
+  XRMG_ASSERT(torusCount <= MAX_TORUS_INSTANCE_COUNT, "Too many instances.");
+  CageBuild &build = m_cageBuild.emplace();
+  build.begin = std::chrono::high_resolution_clock::now();
+  // New tessellations start uploading while the instances are generated.
+  build.torusMeshIndex = this->getTorusMeshIndex(p_parameters.baseTorusTesselationCount);
+  if (g_app->getOptions().lodSegmentPixels) {
+    for (uint32_t tesselation = p_parameters.baseTorusTesselationCount;; tesselation /= 2) {
+      build.lodLevels.emplace_back(tesselation, this->getTorusMeshIndex(tesselation));
+      if (tesselation / 2 < MIN_LOD_TESSELATION) {
+        break;
+      }
+    }
   }
-  TriangleMeshIndex torusMeshIndex = this->getTorusMeshIndex(p_baseTorusTesselationCount);
+  build.instances.resize(torusCount);
+  // The planes are generated in parallel, each into its own range of the instances.
+  uint32_t horizontalTorusCount = p_parameters.baseTorusCount;
+  uint32_t verticalTorusCount = 2 * p_parameters.baseTorusCount;
+  uint32_t planeTorusCount = horizontalTorusCount * verticalTorusCount;
   float torusMaxExtrusion = 0.03f;
   for (uint32_t i = 0; i < 4; ++i) {
-    float scaling = 8.0f / static_cast<float>(p_baseTorusCount);
+    float scaling = 8.0f / static_cast<float>(p_parameters.baseTorusCount);
     Mat4x4f transform = Mat4x4f::createRotationY(static_cast<float>(i) * Angle::deg(90.0f)) *
                         Mat4x4f::createTranslation(0.0f, 4.0f, 4.0f) * Mat4x4f::createScaling(scaling);
-    this->createChainMailPlane(torusMeshIndex, p_baseTorusCount, 2 * p_baseTorusCount, p_torusLayerCount,
-                               torusMaxExtrusion, transform);
+    Instance *instances = build.instances.data() + i * planeTorusCount * p_parameters.torusLayerCount;
+    build.planes.push_back(std::async(std::launch::async, createChainMailPlane, instances, i * planeTorusCount,
+                                      horizontalTorusCount, verticalTorusCount, p_parameters.torusLayerCount,
+                                      torusMaxExtrusion, transform));
   }
 }
 
-void Scene::createChainMailPlane(TriangleMeshIndex p_torusMeshIndex, uint32_t p_horizontalTorusCount,
-                                 uint32_t p_verticalTorusCount, uint32_t p_layerCount, float p_maxExtrusion,
-                                 const Mat4x4f &p_transform) {
-  for (uint32_t i = 0; i < p_horizontalTorusCount; ++i) {
-    for (uint32_t j = 0; j < p_verticalTorusCount; ++j) {
-      float x = static_cast<float>(i) - 0.5f * static_cast<float>(p_horizontalTorusCount - 1);
-      float y = static_cast<float>(j) - 0.5f * static_cast<float>(p_verticalTorusCount - 1);
-      Mat4x4f finalTransform =
-          p_transform * Mat4x4f::createTranslation(x + 0.5f * static_cast<float>(j % 2), 0.5f * y, 0.0f) *
-          Mat4x4f::createRotation({}, (2.0f * static_cast<float>(j % 2) - 1.0f) * Angle::deg(20.0f), {});
-      this->pushFurryTriangleMeshInstances(p_torusMeshIndex, p_layerCount, p_maxExtrusion, finalTransform);
+bool Scene::isCageUploaded(const CageBuild &p_build) const {
+  return m_triangleMeshes[p_build.torusMeshIndex].uploaded &&
+         std::ranges::all_of(p_build.lodLevels, [&](const std::pair<uint32_t, TriangleMeshIndex> &p_level) {
+           return m_triangleMeshes[p_level.second].uploaded;
+         });
+}
+
+void Scene::applyCage(CageBuild &p_build) {
+  for (auto &[baseTesselationCount, torusMeshIndex] : m_torusLods) {
+    m_triangleMeshes[torusMeshIndex].instanceCount = 0;
+  }
+  TriangleMeshIndex torusMeshIndex = p_build.torusMeshIndex;
+  m_lodLevels = p_build.lodLevels;
+
+  // However the instances are distributed over the tessellations, the torus arena only needs room for the cage. The
+  // previous cage's instances are replaced as a whole, so none of them need to be kept.
+  auto instanceCount = static_cast<uint32_t>(p_build.instances.size());
+  InstanceArena &torusArena = m_instanceArenas[m_torusArenaIndex];
+  torusArena.instanceCount = 0;
+  if (torusArena.hostInstances.capacity < instanceCount || 2 * instanceCount < torusArena.hostInstances.capacity) {
+    this->resizeInstanceStorage(torusArena, instanceCount);
+  }
+  torusArena.instanceCount = instanceCount;
+  torusArena.lodSelection = !m_lodLevels.empty();
+  if (m_lodLevels.empty()) {
+    TriangleMeshContainer &torus = m_triangleMeshes[torusMeshIndex];
+    torus.firstInstance = 0;
+    torus.instanceCount = instanceCount;
+    std::copy(p_build.instances.begin(), p_build.instances.end(), torusArena.getInstances(m_currentBufferIndex));
+    this->markInstancesDirty(torusArena, 0, instanceCount);
+  } else {
+    // The instances stay in the torus arena, where the LOD selection reorders them by tessellation.
+    const Vec4f &meshSphere = m_triangleMeshes[torusMeshIndex].triMesh.getBoundingSphere();
+    m_lodInstances = std::move(p_build.instances);
+    m_lodSpheres.clear();
+    for (const Instance &instance : m_lodInstances) {
+      m_lodSpheres.push_back(computeBoundingSphere(meshSphere, instance));
+    }
+    std::string tesselations;
+    for (auto [tesselation, lodMeshIndex] : m_lodLevels) {
+      tesselations += std::format("{}{}", tesselations.empty() ? "" : ", ", tesselation);
     }
+    m_lodFrameIndex.reset();
+    XRMG_INFO("Torus LOD tessellations: {}", tesselations);
   }
+
+  size_t instanceStorageSize = torusArena.hostInstances.capacity * sizeof(Instance);
+  XRMG_INFO("Torus instance storage: {} in host memory, {} per physical device",
+            formatByteSize(MAX_QUEUED_FRAMES * instanceStorageSize), formatByteSize(instanceStorageSize));
+  auto buildTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - p_build.begin);
+  XRMG_INFO("Cage built in {:.1f} ms.", buildTime.count());
+  m_renderer.getMemoryAllocator().logStatistics();
 }
 
 void Scene::updateProjectionPlane(const Mat4x4f &p_cameraPose, Angle p_verticalFov, float p_aspectRatio,
@@ -165,23 +406,32 @@ void Scene::updateProjectionPlane(const Mat4x4f &p_cameraPose, Angle p_verticalF
                     Mat4x4f::createRotationX(Angle::deg(90.0f)) * Mat4x4f::createScaling(scaleX, 1.0f, scaleY));
 }
 
-template <typename T> Scene::MemPoolAllocation<T> Scene::VulkanMemPool::allocate(uint32_t p_count) {
-  XRMG_ASSERT(freePtr + p_count * sizeof(T) <= size, "Out of mem pool memory.");
-  auto elements = reinterpret_cast<T *>(mapped + freePtr);
-  size_t memOffset = freePtr;
-  freePtr += p_count * sizeof(T);
-  return {.count = p_count, .elements = elements, .memOffset = memOffset};
+Scene::TriangleMeshIndex Scene::pushTriangleMesh(TriangleMeshCreator p_creator, uint32_t p_maxInstances) {
+  return this->pushArenaTriangleMesh(p_creator, this->pushInstanceArena(p_maxInstances));
 }
 
-Scene::TriangleMeshIndex Scene::pushTriangleMesh(TriangleMeshCreator p_creator, uint32_t p_maxInstances) {
+Scene::InstanceArenaIndex Scene::pushInstanceArena(uint32_t p_maxInstances) {
   XRMG_ASSERT(p_maxInstances < 1u << 24, "Max instances ({}) must be less than {}.", p_maxInstances, 1u << 24);
+  InstanceArena &arena = m_instanceArenas.emplace_back(InstanceArena{.maxInstances = p_maxInstances});
+  arena.staleDeviceRanges.resize(m_renderer.getPhysicalDeviceCount());
+  if (m_instanceCuller) {
+    m_instanceCuller->addInstanceArena();
+  }
+  if (m_meshletRenderer) {
+    m_meshletRenderer->addInstanceArena();
+  }
+  return static_cast<InstanceArenaIndex>(m_instanceArenas.size() - 1);
+}
+
+Scene::TriangleMeshIndex Scene::pushArenaTriangleMesh(TriangleMeshCreator p_creator, InstanceArenaIndex p_arenaIndex) {
+  XRMG_ASSERT(!m_instanceCuller || m_triangleMeshes.size() < InstanceCuller::MAX_TRIANGLE_MESH_COUNT,
+              "Too many triangle meshes for culling.");
   TriangleMeshContainer &triMeshContainer = m_triangleMeshes.emplace_back(
-      TriangleMeshContainer{.triMesh = p_creator(m_renderer, p_maxInstances, sizeof(Instance))});
-  for (uint32_t i = 0; i < MAX_QUEUED_FRAMES; ++i) {
-    triMeshContainer.instances[i] = m_uploadMemPool.allocate<Instance>(p_maxInstances);
+      TriangleMeshContainer{.triMesh = p_creator(m_renderer), .arenaIndex = p_arenaIndex});
+  if (m_meshletRenderer) {
+    m_meshletRenderer->addTriangleMesh(triMeshContainer.triMesh);
   }
-  triMeshContainer.triMesh.upload(m_renderer.vkDevice(), m_renderer.getGraphicsQueueFamilyIndex(),
-                                  m_renderer.getDeviceMaskAll());
+  triMeshContainer.uploadValue = triMeshContainer.triMesh.upload(m_renderer.getMeshUploader());
   return static_cast<TriangleMeshIndex>(m_triangleMeshes.size() - 1);
 }
 
@@ -190,14 +440,23 @@ Scene::TriangleMeshInstanceIndex Scene::pushTriangleMeshInstance(TriangleMeshInd
   XRMG_ASSERT(p_triangleMeshIndex < m_triangleMeshes.size(),
               "Triangle mesh index({}) must be less than number of triangle meshes ({}).", p_triangleMeshIndex,
               m_triangleMeshes.size());
-  XRMG_ASSERT(m_triangleMeshes[p_triangleMeshIndex].instanceCount <
-                  m_triangleMeshes[p_triangleMeshIndex].triMesh.getMaxInstances(),
-              "Too many instances.");
-  auto instanceIdx = static_cast<TriangleMeshInstanceIndex>(m_triangleMeshes[p_triangleMeshIndex].instanceCount++);
-  this->getTriangleMeshIntance(p_triangleMeshIndex,
-                               instanceIdx) = {.modelToWorld = p_modelToWorld,
-                                               .modelToWorldIT = p_modelToWorld.invert().transpose(),
-                                               .colorHint = p_triangleMeshIndex ^ instanceIdx};
+  TriangleMeshContainer &triMeshContainer = m_triangleMeshes[p_triangleMeshIndex];
+  InstanceArena &arena = m_instanceArenas[triMeshContainer.arenaIndex];
+  if (triMeshContainer.instanceCount == 0) {
+    triMeshContainer.firstInstance = arena.instanceCount;
+  }
+  XRMG_ASSERT(triMeshContainer.firstInstance + triMeshContainer.instanceCount == arena.instanceCount,
+              "Instances of triangle mesh ({}) aren't the last ones of its arena.", p_triangleMeshIndex);
+  XRMG_ASSERT(arena.instanceCount < arena.maxInstances, "Too many instances.");
+  if (arena.instanceCount == arena.hostInstances.capacity) {
+    this->resizeInstanceStorage(
+        arena, std::min(std::max(2 * arena.hostInstances.capacity, MIN_INSTANCE_CAPACITY), arena.maxInstances));
+  }
+  ++arena.instanceCount;
+  auto instanceIdx = static_cast<TriangleMeshInstanceIndex>(triMeshContainer.instanceCount++);
+  Instance &instance = this->getTriangleMeshIntance(p_triangleMeshIndex, instanceIdx);
+  instance = {.colorHint = p_triangleMeshIndex ^ instanceIdx};
+  instance.setTransform(p_modelToWorld);
   return instanceIdx;
 }
 
@@ -221,7 +480,127 @@ Instance &Scene::getTriangleMeshIntance(TriangleMeshIndex p_triangleMeshIndex,
   XRMG_ASSERT(p_instanceIndex < m_triangleMeshes[p_triangleMeshIndex].instanceCount,
               "Triangle mesh instance index ({}) must be less than number of instances of triangle mesh ({}).",
               p_instanceIndex, m_triangleMeshes[p_triangleMeshIndex].instanceCount);
-  return m_triangleMeshes[p_triangleMeshIndex].instances[m_currentBufferIndex].elements[p_instanceIndex];
+  const TriangleMeshContainer &triMeshContainer = m_triangleMeshes[p_triangleMeshIndex];
+  InstanceArena &arena = m_instanceArenas[triMeshContainer.arenaIndex];
+  uint32_t arenaInstanceIdx = triMeshContainer.firstInstance + p_instanceIndex;
+  this->markInstancesDirty(arena, arenaInstanceIdx, arenaInstanceIdx + 1);
+  return arena.getInstances(m_currentBufferIndex)[arenaInstanceIdx];
+}
+
+void Scene::resizeInstanceStorage(InstanceArena &p_arena, uint32_t p_capacity) {
+  XRMG_ASSERT(p_arena.instanceCount <= p_capacity, "Instance capacity ({}) below instance count ({}).", p_capacity,
+              p_arena.instanceCount);
+  InstanceStorage storage = {.capacity = p_capacity};
+  if (p_capacity != 0) {
+    vk::DeviceSize size = MAX_QUEUED_FRAMES * p_capacity * sizeof(Instance);
+    storage.buffer = m_renderer.vkDevice().createBufferUnique(
+        {{}, size, vk::BufferUsageFlagBits::eTransferSrc, vk::SharingMode::eExclusive, {}});
+    vk::MemoryRequirements memReqs = m_renderer.vkDevice().getBufferMemoryRequirements(storage.buffer.get());
+    XRMG_ASSERT(memReqs.memoryTypeBits & 1u << m_uploadMemTypeIndex, "Upload memory type not supported for instances.");
+    storage.memory = m_renderer.vkDevice().allocateMemoryUnique({memReqs.size, m_uploadMemTypeIndex});
+    storage.mapped = reinterpret_cast<Instance *>(m_renderer.vkDevice().mapMemory(storage.memory.get(), 0, size));
+    m_renderer.vkDevice().bindBufferMemory(storage.buffer.get(), storage.memory.get(), 0);
+    if (p_arena.instanceCount != 0) {
+      memcpy(storage.mapped + m_currentBufferIndex * p_capacity, p_arena.getInstances(m_currentBufferIndex),
+             p_arena.instanceCount * sizeof(Instance));
+    }
+  }
+  if (p_arena.hostInstances.memory) {
+    m_retiredInstanceStorage.emplace_back(g_app->getCurrentFrameIndex(), std::move(p_arena.hostInstances));
+  }
+  p_arena.hostInstances = std::move(storage);
+  // The other frame slots start out uninitialized.
+  for (uint32_t i = 0; i < MAX_QUEUED_FRAMES; ++i) {
+    if (i != m_currentBufferIndex) {
+      p_arena.staleSlotRanges[i] = {0, p_arena.instanceCount};
+    }
+  }
+}
+
+void Scene::resizeInstanceBuffer(InstanceArenaIndex p_arenaIndex) {
+  InstanceArena &arena = m_instanceArenas[p_arenaIndex];
+  InstanceStorage instanceBuffer = {.capacity = arena.hostInstances.capacity};
+  if (instanceBuffer.capacity != 0) {
+    instanceBuffer.buffer = m_renderer.vkDevice().createBufferUnique(
+        {{},
+         instanceBuffer.capacity * sizeof(Instance),
+         vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst |
+             vk::BufferUsageFlagBits::eStorageBuffer,
+         vk::SharingMode::eExclusive,
+         {}});
+    vk::MemoryRequirements memReqs = m_renderer.vkDevice().getBufferMemoryRequirements(instanceBuffer.buffer.get());
+    std::optional<uint32_t> memTypeIndex =
+        m_renderer.queryCompatibleMemoryTypeIndex(0, vk::MemoryPropertyFlagBits::eDeviceLocal, memReqs.memoryTypeBits);
+    XRMG_ASSERT(memTypeIndex, "No memory type for instance buffer available.");
+    instanceBuffer.memory = m_renderer.vkDevice().allocateMemoryUnique({memReqs.size, memTypeIndex.value()});
+    m_renderer.vkDevice().bindBufferMemory(instanceBuffer.buffer.get(), instanceBuffer.memory.get(), 0);
+  }
+  if (arena.instanceBuffer.memory) {
+    m_retiredInstanceStorage.emplace_back(g_app->getCurrentFrameIndex(), std::move(arena.instanceBuffer));
+  }
+  arena.instanceBuffer = std::move(instanceBuffer);
+  if (m_instanceCuller) {
+    m_instanceCuller->resizeInstanceArena(p_arenaIndex, arena.instanceBuffer.buffer.get(),
+                                          arena.instanceBuffer.capacity);
+  }
+  if (m_meshletRenderer) {
+    m_meshletRenderer->resizeInstanceArena(p_arenaIndex, arena.instanceBuffer.buffer.get(),
+                                           arena.instanceBuffer.capacity);
+  }
+  for (std::pair<uint32_t, uint32_t> &range : arena.staleDeviceRanges) {
+    range = {0, arena.instanceCount};
+  }
+}
+
+void Scene::resizeBroadcastBuffer(uint32_t p_capacity) {
+  InstanceStorage broadcastInstances = {.capacity = p_capacity};
+  if (p_capacity != 0) {
+    broadcastInstances.buffer = m_renderer.vkDevice().createBufferUnique(
+        {{},
+         MAX_QUEUED_FRAMES * p_capacity * sizeof(Instance),
+         vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst,
+         vk::SharingMode::eExclusive,
+         {}});
+    vk::MemoryRequirements memReqs = m_renderer.vkDevice().getBufferMemoryRequirements(broadcastInstances.buffer.get());
+    std::optional<uint32_t> memTypeIndex =
+        m_renderer.queryCompatibleMemoryTypeIndex(0, vk::MemoryPropertyFlagBits::eDeviceLocal, memReqs.memoryTypeBits);
+    XRMG_ASSERT(memTypeIndex, "No device local memory type for the broadcast buffer available.");
+    vk::MemoryAllocateFlagsInfo allocateFlagsInfo(vk::MemoryAllocateFlagBits::eDeviceMask,
+                                                  m_renderer.deviceIndexToDeviceMask(0));
+    broadcastInstances.memory =
+        m_renderer.vkDevice().allocateMemoryUnique({memReqs.size, memTypeIndex.value(), &allocateFlagsInfo});
+    m_renderer.vkDevice().bindBufferMemory(broadcastInstances.buffer.get(), broadcastInstances.memory.get(), 0);
+  }
+  if (m_broadcastInstances.memory) {
+    m_retiredInstanceStorage.emplace_back(g_app->getCurrentFrameIndex(), std::move(m_broadcastInstances));
+  }
+  m_broadcastInstances = std::move(broadcastInstances);
+}
+
+void Scene::releaseRetiredInstanceStorage(uint64_t p_finishedFrameIndex) {
+  std::erase_if(m_retiredInstanceStorage, [&](const std::pair<uint64_t, InstanceStorage> &p_retired) {
+    return p_retired.first <= p_finishedFrameIndex;
+  });
+  if (m_instanceCuller) {
+    m_instanceCuller->releaseRetiredArenas(p_finishedFrameIndex);
+  }
+  if (m_meshletRenderer) {
+    m_meshletRenderer->releaseRetiredArenas(p_finishedFrameIndex);
+  }
+  if (m_visibleUploadRing) {
+    m_visibleUploadRing->release(p_finishedFrameIndex);
+  }
+}
+
+void Scene::markInstancesDirty(InstanceArena &p_arena, uint32_t p_first, uint32_t p_end) {
+  for (uint32_t i = 0; i < MAX_QUEUED_FRAMES; ++i) {
+    if (i != m_currentBufferIndex) {
+      extendRange(p_arena.staleSlotRanges[i], p_first, p_end);
+    }
+  }
+  for (std::pair<uint32_t, uint32_t> &range : p_arena.staleDeviceRanges) {
+    extendRange(range, p_first, p_end);
+  }
 }
 
 std::pair<Scene::TriangleMeshIndex, Scene::TriangleMeshInstanceIndex>
@@ -233,75 +612,462 @@ Scene::pushTriangleMeshSingleInstance(TriangleMeshCreator p_creator, const Mat4x
 }
 
 void Scene::clearTriangleMeshInstances(TriangleMeshIndex p_triMeshIndex) {
-  m_triangleMeshes[p_triMeshIndex].instanceCount = 0;
+  TriangleMeshContainer &triMeshContainer = m_triangleMeshes[p_triMeshIndex];
+  // Instances of other triangle meshes following them in the arena stay where they are.
+  InstanceArena &arena = m_instanceArenas[triMeshContainer.arenaIndex];
+  if (triMeshContainer.firstInstance + triMeshContainer.instanceCount == arena.instanceCount) {
+    arena.instanceCount = triMeshContainer.firstInstance;
+  }
+  triMeshContainer.instanceCount = 0;
 }
 
 void Scene::update(float p_millis) {
   uint32_t prevBufferIndex = m_currentBufferIndex;
   m_currentBufferIndex = (m_currentBufferIndex + 1) % MAX_QUEUED_FRAMES;
+  // Only the instances written since the slot was last current are carried over, as the rest are still up to date.
+  for (InstanceArena &arena : m_instanceArenas) {
+    auto [first, end] = arena.staleSlotRanges[m_currentBufferIndex];
+    end = std::min(end, arena.instanceCount);
+    if (!arena.lodSelection && first < end) {
+      memcpy(arena.getInstances(m_currentBufferIndex) + first, arena.getInstances(prevBufferIndex) + first,
+             (end - first) * sizeof(Instance));
+    }
+    arena.staleSlotRanges[m_currentBufferIndex] = {};
+  }
+  MeshUploader &meshUploader = m_renderer.getMeshUploader();
   for (TriangleMeshContainer &triMeshContainer : m_triangleMeshes) {
-    if (triMeshContainer.enabled && triMeshContainer.instanceCount != 0) {
-      memcpy(triMeshContainer.instances[m_currentBufferIndex].elements,
-             triMeshContainer.instances[prevBufferIndex].elements, triMeshContainer.instanceCount * sizeof(Instance));
+    triMeshContainer.uploaded = meshUploader.isFinished(triMeshContainer.uploadValue);
+  }
+  // A finished cage replaces the previous one at this frame boundary, unless a newer one has been requested meanwhile.
+  // Until the uploads of its torus meshes finish as well, the previous cage keeps being drawn with its tessellations.
+  if (m_cageBuild && std::ranges::all_of(m_cageBuild->planes, [](const std::future<void> &p_plane) {
+        return p_plane.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+      })) {
+    for (std::future<void> &plane : m_cageBuild->planes) {
+      plane.get();
+    }
+    m_cageBuild->planes.clear();
+    if (m_queuedCage) {
+      this->startCageBuild(*m_queuedCage);
+      m_queuedCage.reset();
+    } else if (this->isCageUploaded(*m_cageBuild)) {
+      this->applyCage(*m_cageBuild);
+      m_cageBuild.reset();
+    }
+  }
+  // The instance buffers follow the capacity of the host copies before the frame is recorded, and are filled from
+  // scratch.
+  for (uint32_t i = 0; i < m_instanceArenas.size(); ++i) {
+    if (m_instanceArenas[i].instanceBuffer.capacity != m_instanceArenas[i].hostInstances.capacity) {
+      this->resizeInstanceBuffer(static_cast<InstanceArenaIndex>(i));
+    }
+  }
+  if (m_broadcastingInstances) {
+    uint32_t broadcastCapacity = 0;
+    for (const InstanceArena &arena : m_instanceArenas) {
+      broadcastCapacity += arena.hostInstances.capacity;
+    }
+    if (m_broadcastInstances.capacity != broadcastCapacity) {
+      this->resizeBroadcastBuffer(broadcastCapacity);
     }
   }
   m_triangleMeshes[m_projectionPlane.first].enabled = g_app->getOptions().renderProjectionPlane;
 }
 
-void Scene::render(uint32_t p_physicalDeviceIndex, vk::CommandBuffer p_cmdBuffer, vk::ImageView p_colorDest,
-                   vk::ImageView p_depthDest, const vk::Rect2D &p_renderArea, const vk::Viewport &p_viewport,
-                   const Mat4x4f &p_view, const Mat4x4f &p_projection) {
-  std::vector<vk::BufferMemoryBarrier2> preUploadBarriers;
-  if (g_app->getCurrentFrameIndex() == 0) {
-    preUploadBarriers.emplace_back(vk::PipelineStageFlagBits2::eAllCommands, vk::AccessFlagBits2::eHostWrite,
-                                   vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferRead,
-                                   VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, m_uploadBuffer.get(), 0,
-                                   m_uploadMemPool.size);
+vk::DeviceSize Scene::getCameraOffset(uint64_t p_frameIndex, uint32_t p_physicalDeviceIndex) const {
+  return ((p_frameIndex % MAX_QUEUED_FRAMES) * m_renderer.getPhysicalDeviceCount() + p_physicalDeviceIndex) *
+         m_cameraStride;
+}
+
+void Scene::setCamera(uint64_t p_frameIndex, uint32_t p_physicalDeviceIndex, const Mat4x4f &p_view,
+                      const Mat4x4f &p_projection, const Vec4f &p_clipBounds) {
+  *reinterpret_cast<Camera *>(m_mappedCameras + this->getCameraOffset(p_frameIndex, p_physicalDeviceIndex)) = {
+      .view = p_view, .projection = p_projection, .clipBounds = p_clipBounds};
+  m_cameraFrameIndices[p_physicalDeviceIndex] = p_frameIndex;
+  if (!m_cullFrusta.empty()) {
+    m_cullFrusta[p_physicalDeviceIndex] = {p_frameIndex,
+                                           FrustumCuller::createFrustum(p_projection * p_view, p_clipBounds)};
+  }
+}
+
+void Scene::setCameraView(uint64_t p_frameIndex, uint32_t p_physicalDeviceIndex, const Mat4x4f &p_view) {
+  reinterpret_cast<Camera *>(m_mappedCameras + this->getCameraOffset(p_frameIndex, p_physicalDeviceIndex))->view =
+      p_view;
+}
+
+void Scene::updateBoundingSpheres() {
+  m_frustumCuller.clear();
+  m_firstSphereIndices.clear();
+  for (const TriangleMeshContainer &triMeshContainer : m_triangleMeshes) {
+    m_firstSphereIndices.push_back(m_frustumCuller.getSphereCount());
+    if (!triMeshContainer.enabled || !triMeshContainer.uploaded) {
+      continue;
+    }
+    const Vec4f &meshSphere = triMeshContainer.triMesh.getBoundingSphere();
+    const Instance *instances = m_instanceArenas[triMeshContainer.arenaIndex].getInstances(m_currentBufferIndex) +
+                                triMeshContainer.firstInstance;
+    for (uint32_t i = 0; i < triMeshContainer.instanceCount; ++i) {
+      Vec4f sphere = computeBoundingSphere(meshSphere, instances[i]);
+      m_frustumCuller.pushSphere({sphere.x, sphere.y, sphere.z}, sphere.w);
+    }
+  }
+  m_firstSphereIndices.push_back(m_frustumCuller.getSphereCount());
+}
+
+void Scene::selectTorusLods(uint64_t p_frameIndex) {
+  // Relies on the cameras of all physical devices rendering the frame being set before it is first called for it.
+  if (m_lodFrameIndex == p_frameIndex) {
+    return;
+  }
+  m_lodFrameIndex = p_frameIndex;
+  // View of each physical device rendering the frame along with the projected diameter in pixels of a sphere of
+  // radius 1 at distance 1; the device's image covers its clip bounds at full resolution.
+  std::vector<std::pair<Mat4x4f, float>> views;
+  for (uint32_t devIdx = 0; devIdx < m_cameraFrameIndices.size(); ++devIdx) {
+    if (m_cameraFrameIndices[devIdx] == p_frameIndex) {
+      Camera camera = *reinterpret_cast<const Camera *>(m_mappedCameras + this->getCameraOffset(p_frameIndex, devIdx));
+      float pixelsPerNdc = static_cast<float>(m_renderer.getResolutionPerPhysicalDevice().height) /
+                           (camera.clipBounds.w - camera.clipBounds.y);
+      views.emplace_back(camera.view, 2.0f * std::abs(camera.projection.v[1][1]) * pixelsPerNdc);
+    }
+  }
+
+  std::vector<uint32_t> instanceLevels(m_lodInstances.size());
+  std::vector<uint32_t> lodCounts(m_lodLevels.size(), 0);
+  auto coarsestLevel = static_cast<uint32_t>(m_lodLevels.size() - 1);
+  auto segmentPixels = static_cast<float>(g_app->getOptions().lodSegmentPixels.value());
+  for (uint32_t i = 0; i < m_lodInstances.size(); ++i) {
+    const Vec4f &sphere = m_lodSpheres[i];
+    float maxPixels = 0.0f;
+    for (const auto &[view, pixelScale] : views) {
+      float depth = -(view.v[2][0] * sphere.x + view.v[2][1] * sphere.y + view.v[2][2] * sphere.z + view.v[2][3]);
+      if (-sphere.w < depth) {
+        maxPixels = std::max(maxPixels, pixelScale * sphere.w / std::max(depth, sphere.w));
+      }
+    }
+    // The major circle of a torus is split into as many segments as its tessellation. Without any views, all tori
+    // keep the finest one.
+    float maxTesselation = static_cast<float>(M_PI) * maxPixels / segmentPixels;
+    uint32_t level = 0;
+    while (!views.empty() && level < coarsestLevel &&
+           maxTesselation < static_cast<float>(m_lodLevels[level].first)) {
+      ++level;
+    }
+    instanceLevels[i] = level;
+    ++lodCounts[level];
+  }
+
+  // Each tessellation draws a contiguous range of the torus arena, from fine to coarse.
+  std::vector<uint32_t> lodEnds;
+  uint32_t firstInstance = 0;
+  for (uint32_t level = 0; level < m_lodLevels.size(); ++level) {
+    TriangleMeshContainer &triMeshContainer = m_triangleMeshes[m_lodLevels[level].second];
+    triMeshContainer.firstInstance = firstInstance;
+    triMeshContainer.instanceCount = lodCounts[level];
+    lodEnds.push_back(firstInstance);
+    firstInstance += lodCounts[level];
+  }
+  InstanceArena &torusArena = m_instanceArenas[m_torusArenaIndex];
+  Instance *instances = torusArena.getInstances(m_currentBufferIndex);
+  for (uint32_t i = 0; i < m_lodInstances.size(); ++i) {
+    instances[lodEnds[instanceLevels[i]]++] = m_lodInstances[i];
+  }
+  this->markInstancesDirty(torusArena, 0, firstInstance);
+  if (g_app->getProfiler().isEnabled()) {
+    std::string distribution;
+    for (uint32_t level = 0; level < m_lodLevels.size(); ++level) {
+      distribution += std::format("{}{}: {}", level == 0 ? "" : ", ", m_lodLevels[level].first, lodCounts[level]);
+    }
+    g_app->getProfiler().pushCpuInstant(std::format("torus LODs: {}", distribution), p_frameIndex);
+  }
+}
+
+Scene::PackedInstances Scene::packVisibleInstances(const FrustumCuller::Planes &p_planes) {
+  m_visibleSphereIndices.clear();
+  m_frustumCuller.cull(p_planes, m_visibleSphereIndices);
+  XRMG_ASSERT(m_visibleSphereIndices.size() <= MAX_VISIBLE_INSTANCE_COUNT, "Too many visible instances ({}).",
+              m_visibleSphereIndices.size());
+  FrameUploadRing::Allocation allocation = m_visibleUploadRing->allocate(
+      g_app->getCurrentFrameIndex(), m_visibleSphereIndices.size() * sizeof(Instance), sizeof(Vec4f));
+  auto packed = reinterpret_cast<Instance *>(allocation.mapped);
+  // The sphere indices are sorted by mesh.
+  PackedInstances visibleInstances = {
+      .buffer = allocation.buffer,
+      .meshRanges = std::vector<std::pair<size_t, uint32_t>>(m_triangleMeshes.size(), {allocation.offset, 0})};
+  uint32_t meshIdx = 0;
+  for (uint32_t i = 0; i < m_visibleSphereIndices.size(); ++i) {
+    uint32_t sphereIdx = m_visibleSphereIndices[i];
+    while (m_firstSphereIndices[meshIdx + 1] <= sphereIdx) {
+      visibleInstances.meshRanges[++meshIdx].first = allocation.offset + i * sizeof(Instance);
+    }
+    const TriangleMeshContainer &triMeshContainer = m_triangleMeshes[meshIdx];
+    packed[i] = m_instanceArenas[triMeshContainer.arenaIndex].getInstances(
+        m_currentBufferIndex)[triMeshContainer.firstInstance + sphereIdx - m_firstSphereIndices[meshIdx]];
+    ++visibleInstances.meshRanges[meshIdx].second;
+  }
+  return visibleInstances;
+}
+
+void Scene::render(uint32_t p_physicalDeviceIndex, vk::CommandBuffer p_cmdBuffer,
+                   const RenderAttachments &p_attachments, const std::vector<RenderRegion> &p_regions) {
+  uint64_t frameIndex = g_app->getCurrentFrameIndex();
+  if (!m_lodLevels.empty()) {
+    this->selectTorusLods(frameIndex);
   }
+  // First instance and count of the instances drawn for each triangle mesh, along with the source buffer,
+  // destination buffer, and region of the copies to the instance buffers.
+  std::vector<std::pair<uint32_t, uint32_t>> draws;
+  std::vector<std::tuple<vk::Buffer, vk::Buffer, vk::BufferCopy>> copies;
+  if (m_visibleUploadRing) {
+    bool stereo = g_app->getOptions().cpuCulling.value() == Options::CullingFrustum::STEREO;
+    if (m_boundingSpheresFrameIndex != frameIndex) {
+      this->updateBoundingSpheres();
+      m_boundingSpheresFrameIndex = frameIndex;
+      if (stereo) {
+        // Relies on the cameras of all physical devices rendering this frame being set before the first one renders.
+        std::vector<FrustumCuller::Frustum> frusta;
+        for (const auto &[cameraFrameIndex, frustum] : m_cullFrusta) {
+          if (cameraFrameIndex == frameIndex) {
+            frusta.push_back(frustum);
+          }
+        }
+        m_sharedVisibleInstances = this->packVisibleInstances(FrustumCuller::createUnion(frusta));
+      }
+    }
+    PackedInstances uploads = stereo ? m_sharedVisibleInstances
+                                     : this->packVisibleInstances(m_cullFrusta[p_physicalDeviceIndex].second.planes);
+    // The packed instances differ per frame, so the instance buffers never hold the ones of the frame slots. The
+    // visible instances of each triangle mesh are copied to the start of its range.
+    for (uint32_t i = 0; i < m_triangleMeshes.size(); ++i) {
+      const TriangleMeshContainer &triMeshContainer = m_triangleMeshes[i];
+      const auto &[memOffset, count] = uploads.meshRanges[i];
+      draws.emplace_back(triMeshContainer.firstInstance, count);
+      if (count != 0) {
+        copies.emplace_back(uploads.buffer,
+                            m_instanceArenas[triMeshContainer.arenaIndex].instanceBuffer.buffer.get(),
+                            vk::BufferCopy(memOffset, triMeshContainer.firstInstance * sizeof(Instance),
+                                           count * sizeof(Instance)));
+      }
+    }
+  } else {
+    // The instance buffer of the physical device only needs the instances written since it was last uploaded to.
+    for (uint32_t i = 0; i < m_instanceArenas.size(); ++i) {
+      InstanceArena &arena = m_instanceArenas[i];
+      std::pair<uint32_t, uint32_t> &staleRange = arena.staleDeviceRanges[p_physicalDeviceIndex];
+      uint32_t end = std::min(staleRange.second, arena.instanceCount);
+      if (staleRange.first < end) {
+        vk::Buffer source = arena.hostInstances.buffer.get();
+        vk::BufferCopy copy(arena.getInstancesOffset(m_currentBufferIndex) + staleRange.first * sizeof(Instance),
+                            staleRange.first * sizeof(Instance), (end - staleRange.first) * sizeof(Instance));
+        if (m_broadcastingInstances) {
+          // The stale range lies within the one broadcast for this frame.
+          const auto &[broadcastFirst, broadcastOffset] = m_broadcastRanges[i];
+          source = m_broadcastInstances.buffer.get();
+          copy.srcOffset = broadcastOffset + (staleRange.first - broadcastFirst) * sizeof(Instance);
+        }
+        copies.emplace_back(source, arena.instanceBuffer.buffer.get(), copy);
+      }
+      // Instances beyond the count are marked again once they are written.
+      staleRange = {};
+    }
+    for (const TriangleMeshContainer &triMeshContainer : m_triangleMeshes) {
+      bool drawn = triMeshContainer.enabled && triMeshContainer.uploaded;
+      draws.emplace_back(triMeshContainer.firstInstance, drawn ? triMeshContainer.instanceCount : 0);
+    }
+  }
+
+  // Host writes before the submission are visible to it without a barrier. Mesh shading reads the instances from
+  // storage buffers.
+  vk::PipelineStageFlags2 instanceStages =
+      m_meshletRenderer ? vk::PipelineStageFlagBits2::eTaskShaderEXT | vk::PipelineStageFlagBits2::eMeshShaderEXT
+                        : vk::PipelineStageFlagBits2::eVertexInput;
+  vk::AccessFlags2 instanceAccess =
+      m_meshletRenderer ? vk::AccessFlagBits2::eShaderStorageRead : vk::AccessFlagBits2::eVertexAttributeRead;
+  std::vector<vk::BufferMemoryBarrier2> preUploadBarriers;
   std::vector<vk::BufferMemoryBarrier2> postUploadBarriers;
-  for (TriangleMeshContainer &triMeshContainer : m_triangleMeshes) {
-    if (triMeshContainer.enabled && triMeshContainer.instanceCount != 0) {
-      preUploadBarriers.emplace_back(
-          vk::PipelineStageFlagBits2::eAllCommands, vk::AccessFlagBits2::eNone, vk::PipelineStageFlagBits2::eTransfer,
-          vk::AccessFlagBits2::eTransferWrite, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
-          triMeshContainer.triMesh.getInstanceBuffer(), 0, triMeshContainer.instanceCount * sizeof(Instance));
-      postUploadBarriers.emplace_back(vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
-                                      vk::PipelineStageFlagBits2::eVertexInput,
-                                      vk::AccessFlagBits2::eVertexAttributeRead, VK_QUEUE_FAMILY_IGNORED,
-                                      VK_QUEUE_FAMILY_IGNORED, triMeshContainer.triMesh.getInstanceBuffer(), 0,
-                                      triMeshContainer.instanceCount * sizeof(Instance));
+  for (const auto &[source, dest, copy] : copies) {
+    preUploadBarriers.emplace_back(vk::PipelineStageFlagBits2::eAllCommands, vk::AccessFlagBits2::eNone,
+                                   vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
+                                   VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, dest, copy.dstOffset, copy.size);
+    postUploadBarriers.emplace_back(vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
+                                    instanceStages, instanceAccess, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+                                    dest, copy.dstOffset, copy.size);
+  }
+  if (!preUploadBarriers.empty()) {
+    p_cmdBuffer.pipelineBarrier2({{}, {}, preUploadBarriers});
+  }
+  PipelineStatistics *pipelineStatistics = m_renderer.getPipelineStatistics();
+  if (pipelineStatistics) {
+    pipelineStatistics->writeInstanceUploadBegin(p_cmdBuffer, frameIndex, p_physicalDeviceIndex);
+  }
+  vk::DeviceSize uploadSize = 0;
+  for (const auto &[source, dest, copy] : copies) {
+    p_cmdBuffer.copyBuffer(source, dest, copy);
+    uploadSize += copy.size;
+  }
+  if (pipelineStatistics) {
+    pipelineStatistics->writeInstanceUploadEnd(p_cmdBuffer, frameIndex, p_physicalDeviceIndex, uploadSize);
+  }
+  if (!postUploadBarriers.empty()) {
+    p_cmdBuffer.pipelineBarrier2({{}, {}, postUploadBarriers});
+  }
+  auto cameraOffset = static_cast<uint32_t>(this->getCameraOffset(frameIndex, p_physicalDeviceIndex));
+  if (!m_instanceCuller) {
+    this->drawTriangleMeshes(p_cmdBuffer, p_attachments, p_regions, draws, cameraOffset, false, false);
+    return;
+  }
+
+  std::vector<InstanceCuller::Batch> batches;
+  for (uint32_t i = 0; i < m_triangleMeshes.size(); ++i) {
+    if (draws[i].second != 0) {
+      batches.emplace_back(InstanceCuller::Batch{.triMeshIndex = i,
+                                                 .triMesh = &m_triangleMeshes[i].triMesh,
+                                                 .arenaIndex = m_triangleMeshes[i].arenaIndex,
+                                                 .firstInstance = draws[i].first,
+                                                 .instanceCount = draws[i].second});
     }
   }
-  p_cmdBuffer.pipelineBarrier2({{}, {}, preUploadBarriers});
-  for (TriangleMeshContainer &triMeshContainer : m_triangleMeshes) {
-    if (triMeshContainer.enabled && triMeshContainer.instanceCount != 0) {
-      p_cmdBuffer.copyBuffer(m_uploadBuffer.get(), triMeshContainer.triMesh.getInstanceBuffer(),
-                             vk::BufferCopy(triMeshContainer.instances[m_currentBufferIndex].memOffset, 0,
-                                            triMeshContainer.instanceCount * sizeof(Instance)));
+  // The depth pyramid covers the whole image, so it only serves renderings in a single full resolution region. It
+  // stays usable as long as the camera it has been rendered with is still in its frame slot.
+  DepthPyramid &depthPyramid = m_instanceCuller->getDepthPyramid();
+  bool occlusionCulling = g_app->getOptions().occlusionCulling && p_regions.size() == 1 &&
+                          p_regions.front().renderArea == vk::Rect2D({0, 0}, depthPyramid.getDepthExtent());
+  std::optional<uint64_t> &pyramidFrameIndex = m_depthPyramidFrameIndices[p_physicalDeviceIndex];
+  bool twoPhases = occlusionCulling && pyramidFrameIndex && frameIndex - pyramidFrameIndex.value() < MAX_QUEUED_FRAMES;
+  auto occlusionCameraOffset =
+      twoPhases ? static_cast<uint32_t>(this->getCameraOffset(pyramidFrameIndex.value(), p_physicalDeviceIndex))
+                : cameraOffset;
+  m_instanceCuller->cull(p_cmdBuffer, twoPhases ? InstanceCuller::Phase::EARLY : InstanceCuller::Phase::FRUSTUM,
+                         cameraOffset, occlusionCameraOffset, batches);
+  this->drawTriangleMeshes(p_cmdBuffer, p_attachments, p_regions, draws, cameraOffset, false, twoPhases);
+  if (occlusionCulling) {
+    depthPyramid.build(p_cmdBuffer, p_attachments.depthImage, p_attachments.depth);
+    pyramidFrameIndex = frameIndex;
+  }
+  if (twoPhases) {
+    m_instanceCuller->cull(p_cmdBuffer, InstanceCuller::Phase::LATE, cameraOffset, cameraOffset, batches);
+    vk::MemoryBarrier2 attachmentBarrier(
+        vk::PipelineStageFlagBits2::eLateFragmentTests | vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+        vk::AccessFlagBits2::eDepthStencilAttachmentWrite | vk::AccessFlagBits2::eColorAttachmentWrite,
+        vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+        vk::AccessFlagBits2::eDepthStencilAttachmentRead | vk::AccessFlagBits2::eDepthStencilAttachmentWrite |
+            vk::AccessFlagBits2::eColorAttachmentRead | vk::AccessFlagBits2::eColorAttachmentWrite);
+    p_cmdBuffer.pipelineBarrier2({{}, attachmentBarrier});
+    this->drawTriangleMeshes(p_cmdBuffer, p_attachments, p_regions, draws, cameraOffset, true, false);
+  }
+  if (g_app->getProfiler().isEnabled()) {
+    m_instanceCuller->writeStatistics(p_cmdBuffer, frameIndex, p_physicalDeviceIndex, batches);
+  }
+}
+
+void Scene::broadcastInstances(vk::CommandBuffer p_cmdBuffer, const std::vector<uint32_t> &p_physicalDeviceIndices) {
+  uint64_t frameIndex = g_app->getCurrentFrameIndex();
+  if (!m_lodLevels.empty()) {
+    this->selectTorusLods(frameIndex);
+  }
+  // Each arena's stale instances of all physical devices rendering the frame are packed into the frame slot's region.
+  size_t regionSize = m_broadcastInstances.capacity * sizeof(Instance);
+  size_t regionOffset = m_currentBufferIndex * regionSize;
+  size_t packedSize = 0;
+  m_broadcastRanges.assign(m_instanceArenas.size(), {0, 0});
+  for (uint32_t i = 0; i < m_instanceArenas.size(); ++i) {
+    const InstanceArena &arena = m_instanceArenas[i];
+    std::pair<uint32_t, uint32_t> range = {};
+    for (uint32_t devIdx : p_physicalDeviceIndices) {
+      const auto &[first, end] = arena.staleDeviceRanges[devIdx];
+      if (first < end) {
+        extendRange(range, first, end);
+      }
+    }
+    range.second = std::min(range.second, arena.instanceCount);
+    if (range.second <= range.first) {
+      continue;
     }
+    size_t size = (range.second - range.first) * sizeof(Instance);
+    m_broadcastRanges[i] = {range.first, regionOffset + packedSize};
+    XRMG_ASSERT(packedSize + size <= regionSize, "Too many instances to broadcast ({} bytes of {}).", packedSize + size,
+                regionSize);
+    // The host writes preceding the submission are visible to it without a barrier.
+    p_cmdBuffer.copyBuffer(
+        arena.hostInstances.buffer.get(), m_broadcastInstances.buffer.get(),
+        vk::BufferCopy(arena.getInstancesOffset(m_currentBufferIndex) + range.first * sizeof(Instance),
+                       regionOffset + packedSize, size));
+    packedSize += size;
   }
-  p_cmdBuffer.pipelineBarrier2({{}, {}, postUploadBarriers});
+}
 
+void Scene::drawTriangleMeshes(vk::CommandBuffer p_cmdBuffer, const RenderAttachments &p_attachments,
+                               const std::vector<RenderRegion> &p_regions,
+                               const std::vector<std::pair<uint32_t, uint32_t>> &p_draws, uint32_t p_cameraOffset,
+                               bool p_late, bool p_keepMultisample) {
+  vk::AttachmentLoadOp loadOp = p_late ? vk::AttachmentLoadOp::eLoad : vk::AttachmentLoadOp::eClear;
   vk::RenderingAttachmentInfo colorAttachment(
-      p_colorDest, vk::ImageLayout::eColorAttachmentOptimal, vk::ResolveModeFlagBits::eNone, nullptr,
-      vk::ImageLayout::eUndefined, vk::AttachmentLoadOp::eClear, vk::AttachmentStoreOp::eStore, g_clearValues);
-  vk::RenderingAttachmentInfo depthAttachment(p_depthDest, vk::ImageLayout::eDepthAttachmentOptimal, {}, {}, {},
-                                              vk::AttachmentLoadOp::eClear, vk::AttachmentStoreOp::eStore,
+      p_attachments.color, vk::ImageLayout::eColorAttachmentOptimal, vk::ResolveModeFlagBits::eNone, nullptr,
+      vk::ImageLayout::eUndefined, loadOp, vk::AttachmentStoreOp::eStore, g_clearValues);
+  vk::RenderingAttachmentInfo depthAttachment(p_attachments.depth, vk::ImageLayout::eDepthAttachmentOptimal, {}, {},
+                                              {}, loadOp, vk::AttachmentStoreOp::eStore,
                                               vk::ClearValue(vk::ClearDepthStencilValue(1.0f, 0)));
-  p_cmdBuffer.beginRendering(vk::RenderingInfo({}, p_renderArea, 1, 0, colorAttachment, &depthAttachment, nullptr));
-  p_cmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_pipeline.get());
-  p_cmdBuffer.setViewport(0, p_viewport);
-  p_cmdBuffer.setScissor(0, p_renderArea);
-  p_cmdBuffer.pushConstants(m_pipelineLayout.get(), vk::ShaderStageFlagBits::eVertex, offsetof(Camera, view),
-                            sizeof(Mat4x4f), &p_view);
-  p_cmdBuffer.pushConstants(m_pipelineLayout.get(), vk::ShaderStageFlagBits::eVertex, offsetof(Camera, projection),
-                            sizeof(Mat4x4f), &p_projection);
-  for (TriangleMeshContainer &triMeshContainer : m_triangleMeshes) {
-    if (triMeshContainer.enabled && triMeshContainer.instanceCount != 0) {
-      triMeshContainer.triMesh.bind(p_cmdBuffer);
-      triMeshContainer.triMesh.draw(p_cmdBuffer, triMeshContainer.instanceCount);
+  if (p_attachments.multisampleColor) {
+    // Only the resolved images are kept, so the multisampled ones never need to be written to memory unless a late
+    // pass follows.
+    vk::AttachmentStoreOp multisampleStoreOp =
+        p_keepMultisample ? vk::AttachmentStoreOp::eStore : vk::AttachmentStoreOp::eDontCare;
+    colorAttachment.setImageView(p_attachments.multisampleColor)
+        .setStoreOp(multisampleStoreOp)
+        .setResolveMode(vk::ResolveModeFlagBits::eAverage)
+        .setResolveImageView(p_attachments.color)
+        .setResolveImageLayout(vk::ImageLayout::eColorAttachmentOptimal);
+    depthAttachment.setImageView(p_attachments.multisampleDepth)
+        .setStoreOp(multisampleStoreOp)
+        .setResolveMode(m_depthResolveMode)
+        .setResolveImageView(p_attachments.depth)
+        .setResolveImageLayout(vk::ImageLayout::eDepthAttachmentOptimal);
+  }
+  vk::RenderingFragmentShadingRateAttachmentInfoKHR shadingRateAttachment(
+      p_attachments.shadingRate, vk::ImageLayout::eFragmentShadingRateAttachmentOptimalKHR,
+      p_attachments.shadingRateTexelSize);
+  for (const RenderRegion &region : p_regions) {
+    vk::RenderingInfo renderingInfo({}, region.renderArea, 1, 0, colorAttachment, &depthAttachment, nullptr);
+    if (p_attachments.shadingRate) {
+      renderingInfo.setPNext(&shadingRateAttachment);
+    }
+    p_cmdBuffer.beginRendering(renderingInfo);
+    p_cmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_pipeline.get());
+    p_cmdBuffer.setViewport(0, region.viewport);
+    p_cmdBuffer.setScissor(0, region.renderArea);
+    p_cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_pipelineLayout.get(), 0, m_cameraDescriptorSet,
+                                   p_cameraOffset);
+    for (uint32_t i = 0; i < m_triangleMeshes.size(); ++i) {
+      if (p_draws[i].second == 0) {
+        continue;
+      }
+      const TriangleMeshContainer &triMeshContainer = m_triangleMeshes[i];
+      if (m_meshletRenderer) {
+        m_meshletRenderer->draw(p_cmdBuffer, m_pipelineLayout.get(), i, triMeshContainer.triMesh,
+                                triMeshContainer.arenaIndex, p_draws[i].first, p_draws[i].second);
+        continue;
+      }
+      p_cmdBuffer.pushConstants(m_pipelineLayout.get(), vk::ShaderStageFlagBits::eVertex, 0,
+                                sizeof(TriangleMesh::PositionBounds), &triMeshContainer.triMesh.getPositionBounds());
+      if (m_instanceCuller) {
+        triMeshContainer.triMesh.bind(p_cmdBuffer,
+                                      m_instanceCuller->getVisibleInstanceBuffer(triMeshContainer.arenaIndex));
+        triMeshContainer.triMesh.drawIndirect(
+            p_cmdBuffer, m_instanceCuller->getDrawCommandBuffer(),
+            m_instanceCuller->getDrawCommandOffset(i) + (p_late ? InstanceCuller::LATE_DRAW_COMMAND_OFFSET : 0));
+      } else {
+        triMeshContainer.triMesh.bind(p_cmdBuffer,
+                                      m_instanceArenas[triMeshContainer.arenaIndex].instanceBuffer.buffer.get());
+        triMeshContainer.triMesh.draw(p_cmdBuffer, p_draws[i].second, p_draws[i].first);
+      }
     }
+    p_cmdBuffer.endRendering();
+  }
+}
+
+void Scene::logCullingStatistics(uint64_t p_frameIndex) const {
+  if (m_instanceCuller && g_app->getProfiler().isEnabled()) {
+    m_instanceCuller->logStatistics(p_frameIndex);
   }
-  p_cmdBuffer.endRendering();
 }
 } // namespace xrmg
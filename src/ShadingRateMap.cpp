@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "ShadingRateMap.hpp"
+
+#include "App.hpp"
+
+namespace xrmg {
+// Fragment sizes as encoded in the attachment: log2 of the width in bits 2 and 3, log2 of the height in bits 0 and 1.
+static const uint8_t g_fullShadingRate = 0x0;
+static const uint8_t g_coarseShadingRate = 0x5;
+
+ShadingRateMap::ShadingRateMap(const Renderer &p_renderer)
+    : m_uploaded(p_renderer.getPhysicalDeviceCount(), false) {
+  m_texelSize = p_renderer.getPhysicalDevice(0)
+                    .getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceFragmentShadingRatePropertiesKHR>()
+                    .get<vk::PhysicalDeviceFragmentShadingRatePropertiesKHR>()
+                    .minFragmentShadingRateAttachmentTexelSize;
+  const vk::Extent2D &resolution = p_renderer.getResolutionPerPhysicalDevice();
+  m_extent = vk::Extent2D((resolution.width + m_texelSize.width - 1) / m_texelSize.width,
+                          (resolution.height + m_texelSize.height - 1) / m_texelSize.height);
+  XRMG_INFO("Shading rate images of {} x {} texels with {} x {} pixels each.", m_extent.width, m_extent.height,
+            m_texelSize.width, m_texelSize.height);
+
+  vk::ImageCreateInfo imageCreateInfo(
+      {}, vk::ImageType::e2D, vk::Format::eR8Uint, vk::Extent3D(m_extent, 1), 1, 1, vk::SampleCountFlagBits::e1,
+      vk::ImageTiling::eOptimal,
+      vk::ImageUsageFlagBits::eFragmentShadingRateAttachmentKHR | vk::ImageUsageFlagBits::eTransferDst,
+      vk::SharingMode::eExclusive, {}, vk::ImageLayout::eUndefined);
+  vk::ImageViewCreateInfo imageViewCreateInfo({}, {}, vk::ImageViewType::e2D, vk::Format::eR8Uint, {},
+                                              {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1});
+  for (uint32_t devIdx = 0; devIdx < p_renderer.getPhysicalDeviceCount(); ++devIdx) {
+    m_imageResources.emplace_back(p_renderer, devIdx, imageCreateInfo, imageViewCreateInfo);
+  }
+
+  vk::DeviceSize stagingSize = p_renderer.getPhysicalDeviceCount() * m_extent.width * m_extent.height;
+  m_stagingBuffer = p_renderer.vkDevice().createBufferUnique(
+      {{}, stagingSize, vk::BufferUsageFlagBits::eTransferSrc, vk::SharingMode::eExclusive, {}});
+  vk::MemoryRequirements stagingMemReqs = p_renderer.vkDevice().getBufferMemoryRequirements(m_stagingBuffer.get());
+  std::optional<uint32_t> stagingMemTypeIndex = p_renderer.queryCompatibleMemoryTypeIndex(
+      0, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+      stagingMemReqs.memoryTypeBits);
+  XRMG_ASSERT(stagingMemTypeIndex, "No host visible and coherent memory type for the shading rate staging buffer.");
+  m_stagingMemory = p_renderer.vkDevice().allocateMemoryUnique({stagingMemReqs.size, stagingMemTypeIndex.value()});
+  m_mappedStaging =
+      reinterpret_cast<uint8_t *>(p_renderer.vkDevice().mapMemory(m_stagingMemory.get(), 0, stagingMemReqs.size));
+  p_renderer.vkDevice().bindBufferMemory(m_stagingBuffer.get(), m_stagingMemory.get(), 0);
+}
+
+void ShadingRateMap::upload(vk::CommandBuffer p_cmdBuffer, uint32_t p_physicalDeviceIndex,
+                            const Rect2Df &p_deviceViewport, const Vec2f &p_lensCenter,
+                            const vk::Extent2D &p_imageExtent) {
+  if (m_uploaded[p_physicalDeviceIndex]) {
+    return;
+  }
+  m_uploaded[p_physicalDeviceIndex] = true;
+
+  // The radius is measured in normalized device coordinates, so it is relative to half the view size.
+  float radius = 0.01f * static_cast<float>(g_app->getOptions().variableRateShading.value().first);
+  vk::DeviceSize offset = p_physicalDeviceIndex * m_extent.width * m_extent.height;
+  uint8_t *texels = m_mappedStaging + offset;
+  for (uint32_t y = 0; y < m_extent.height; ++y) {
+    for (uint32_t x = 0; x < m_extent.width; ++x) {
+      float u = (static_cast<float>(x) + 0.5f) * static_cast<float>(m_texelSize.width) /
+                static_cast<float>(p_imageExtent.width);
+      float v = (static_cast<float>(y) + 0.5f) * static_cast<float>(m_texelSize.height) /
+                static_cast<float>(p_imageExtent.height);
+      float dx = 2.0f * (u - p_deviceViewport.x) / p_deviceViewport.width - 1.0f - p_lensCenter.x;
+      float dy = 2.0f * (v - p_deviceViewport.y) / p_deviceViewport.height - 1.0f - p_lensCenter.y;
+      texels[y * m_extent.width + x] = dx * dx + dy * dy <= radius * radius ? g_fullShadingRate : g_coarseShadingRate;
+    }
+  }
+
+  vk::Image image = m_imageResources[p_physicalDeviceIndex].getImage();
+  vk::ImageMemoryBarrier2 preCopyBarrier(vk::PipelineStageFlagBits2::eNone, vk::AccessFlagBits2::eNone,
+                                         vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
+                                         vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal,
+                                         VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, image,
+                                         {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1});
+  p_cmdBuffer.pipelineBarrier2({{}, {}, {}, preCopyBarrier});
+  p_cmdBuffer.copyBufferToImage(m_stagingBuffer.get(), image, vk::ImageLayout::eTransferDstOptimal,
+                                vk::BufferImageCopy(offset, 0, 0, {vk::ImageAspectFlagBits::eColor, 0, 0, 1}, {},
+                                                    vk::Extent3D(m_extent, 1)));
+  vk::ImageMemoryBarrier2 postCopyBarrier(
+      vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
+      vk::PipelineStageFlagBits2::eFragmentShadingRateAttachmentKHR,
+      vk::AccessFlagBits2::eFragmentShadingRateAttachmentReadKHR, vk::ImageLayout::eTransferDstOptimal,
+      vk::ImageLayout::eFragmentShadingRateAttachmentOptimalKHR, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+      image, {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1});
+  p_cmdBuffer.pipelineBarrier2({{}, {}, {}, postCopyBarrier});
+}
+} // namespace xrmg
@@ -51,6 +51,10 @@ StereoProjection StereoProjection::create(Eye p_eye, float p_ipd, float p_projec
   return StereoProjection::create(left, right, up, down, p_zNear, p_zFar);
 }
 
+Vec2f StereoProjection::getLensCenter() const {
+  return {projectionMatrix.v[0][2] / projectionMatrix.v[3][2], projectionMatrix.v[1][2] / projectionMatrix.v[3][2]};
+}
+
 Mat4x4f StereoProjection::createStereoEyeTranslation(Eye p_eye, float p_ipd) {
   return Mat4x4f::createTranslation((static_cast<float>(p_eye) - 0.5f) * p_ipd, 0.0f, 0.0f);
 }
@@ -19,13 +19,397 @@
 #include "TriangleMesh.hpp"
 
 #include "App.hpp"
+#include "MeshUploader.hpp"
+
+#include <numeric>
 
-#define ALIGN(_value, _alignment) ((((_value) + (_alignment) - 1) / (_alignment)) * (_alignment))
 #define PRIMITIVE_RESTART 0xffffffff
 
 namespace xrmg {
-TriangleMesh TriangleMesh::createUnitCube(const Renderer &p_renderer, uint32_t p_maxInstances,
-                                          size_t p_sizePerInstance) {
+struct MeshletData {
+  std::vector<TriangleMesh::Meshlet> meshlets;
+  std::vector<uint32_t> vertexIndices;
+  std::vector<uint32_t> triangles;
+};
+
+static Vec3f subtract(const Vec3f &p_left, const Vec3f &p_right) {
+  return {p_left.x - p_right.x, p_left.y - p_right.y, p_left.z - p_right.z};
+}
+
+static float dot(const Vec3f &p_left, const Vec3f &p_right) {
+  return p_left.x * p_right.x + p_left.y * p_right.y + p_left.z * p_right.z;
+}
+
+static Vec3f cross(const Vec3f &p_left, const Vec3f &p_right) {
+  return {p_left.y * p_right.z - p_left.z * p_right.y, p_left.z * p_right.x - p_left.x * p_right.z,
+          p_left.x * p_right.y - p_left.y * p_right.x};
+}
+
+static int16_t quantizeSnorm16(float p_value) {
+  return static_cast<int16_t>(std::round(std::clamp(p_value, -1.0f, 1.0f) * 32767.0f));
+}
+
+static uint16_t quantizeUnorm16(float p_value) {
+  return static_cast<uint16_t>(std::round(std::clamp(p_value, 0.0f, 1.0f) * 65535.0f));
+}
+
+// Projects the normal onto the octahedron and unfolds its lower half onto the square of the upper one.
+static std::array<int16_t, 2> encodeOctahedral(const Vec3f &p_normal) {
+  float l1Norm = std::abs(p_normal.x) + std::abs(p_normal.y) + std::abs(p_normal.z);
+  float x = p_normal.x / l1Norm;
+  float y = p_normal.y / l1Norm;
+  if (p_normal.z < 0.0f) {
+    float foldedX = (1.0f - std::abs(y)) * (0.0f <= x ? 1.0f : -1.0f);
+    float foldedY = (1.0f - std::abs(x)) * (0.0f <= y ? 1.0f : -1.0f);
+    x = foldedX;
+    y = foldedY;
+  }
+  return {quantizeSnorm16(x), quantizeSnorm16(y)};
+}
+
+static TriangleMesh::CompactVertex compactVertex(const TriangleMesh::Vertex &p_vertex,
+                                                 const TriangleMesh::PositionBounds &p_bounds) {
+  XRMG_ASSERT(0.0f <= p_vertex.tex.x && p_vertex.tex.x <= 1.0f && 0.0f <= p_vertex.tex.y && p_vertex.tex.y <= 1.0f,
+              "Compact vertices require texture coordinates within [0, 1].");
+  TriangleMesh::CompactVertex compact = {};
+  const float pos[3] = {p_vertex.pos.x, p_vertex.pos.y, p_vertex.pos.z};
+  for (uint32_t i = 0; i < 3; ++i) {
+    // Flat meshes like the planes keep 0 along their flat axis.
+    if (p_bounds.halfExtent.values[i] != 0.0f) {
+      compact.pos[i] = quantizeSnorm16((pos[i] - p_bounds.center.values[i]) / p_bounds.halfExtent.values[i]);
+    }
+  }
+  compact.normal = encodeOctahedral(p_vertex.normal);
+  compact.tex = {quantizeUnorm16(p_vertex.tex.x), quantizeUnorm16(p_vertex.tex.y)};
+  return compact;
+}
+
+// Twice the area times the triangle's unit normal, oriented like the vertex normals regardless of the winding.
+static Vec3f computeOutwardNormal(const TriangleMesh::Vertex *p_vertices, const std::array<uint32_t, 3> &p_triangle) {
+  const TriangleMesh::Vertex &a = p_vertices[p_triangle[0]];
+  const TriangleMesh::Vertex &b = p_vertices[p_triangle[1]];
+  const TriangleMesh::Vertex &c = p_vertices[p_triangle[2]];
+  Vec3f normal = cross(subtract(b.pos, a.pos), subtract(c.pos, a.pos));
+  Vec3f vertexNormalSum = a.normal;
+  vertexNormalSum += b.normal;
+  vertexNormalSum += c.normal;
+  return (dot(normal, vertexNormalSum) < 0.0f ? -1.0f : 1.0f) * normal;
+}
+
+// Every second triangle of a strip is flipped to keep the winding of the first one; degenerate triangles are dropped.
+static std::vector<std::array<uint32_t, 3>> unpackTriangleStrips(const std::vector<uint32_t> &p_indices) {
+  std::vector<std::array<uint32_t, 3>> triangles;
+  uint32_t stripLength = 0;
+  for (size_t i = 0; i < p_indices.size(); ++i) {
+    if (p_indices[i] == PRIMITIVE_RESTART) {
+      stripLength = 0;
+      continue;
+    }
+    if (2 <= stripLength) {
+      std::array<uint32_t, 3> triangle = {p_indices[i - 2], p_indices[i - 1], p_indices[i]};
+      if (stripLength % 2 != 0) {
+        std::swap(triangle[0], triangle[1]);
+      }
+      if (triangle[0] != triangle[1] && triangle[1] != triangle[2] && triangle[2] != triangle[0]) {
+        triangles.push_back(triangle);
+      }
+    }
+    ++stripLength;
+  }
+  return triangles;
+}
+
+// Size of the LRU cache simulated by the vertex cache optimization; hardware caches are about as large or smaller.
+static const uint32_t g_vertexCacheSize = 32;
+
+// Vertices get higher scores the more recently they were used and the fewer triangles they have left, so the latter
+// are finished instead of being left behind as isolated triangles.
+static float scoreVertex(std::optional<uint32_t> p_cachePosition, uint32_t p_remainingTriangleCount) {
+  if (p_remainingTriangleCount == 0) {
+    return -1.0f;
+  }
+  float score = 0.0f;
+  if (p_cachePosition && p_cachePosition.value() < 3) {
+    // The vertices of the last triangle score equally, since their order within it doesn't matter.
+    score = 0.75f;
+  } else if (p_cachePosition) {
+    score = std::pow(1.0f - static_cast<float>(p_cachePosition.value() - 3) / static_cast<float>(g_vertexCacheSize - 3),
+                     1.5f);
+  }
+  return score + 2.0f / std::sqrt(static_cast<float>(p_remainingTriangleCount));
+}
+
+// Forsyth's linear-speed vertex cache optimization: greedily emits the triangle of the cached vertices whose vertices
+// score highest, and continues with the first triangle left whenever the cached vertices have none left.
+static std::vector<std::array<uint32_t, 3>> optimizeVertexCache(const std::vector<std::array<uint32_t, 3>> &p_triangles,
+                                                                uint32_t p_vertexCount) {
+  std::vector<std::vector<uint32_t>> vertexTriangles(p_vertexCount);
+  for (uint32_t i = 0; i < p_triangles.size(); ++i) {
+    for (uint32_t vertexIdx : p_triangles[i]) {
+      vertexTriangles[vertexIdx].push_back(i);
+    }
+  }
+  std::vector<float> vertexScores(p_vertexCount);
+  for (uint32_t i = 0; i < p_vertexCount; ++i) {
+    vertexScores[i] = scoreVertex(std::nullopt, static_cast<uint32_t>(vertexTriangles[i].size()));
+  }
+  std::vector<float> triangleScores(p_triangles.size());
+  for (uint32_t i = 0; i < p_triangles.size(); ++i) {
+    for (uint32_t vertexIdx : p_triangles[i]) {
+      triangleScores[i] += vertexScores[vertexIdx];
+    }
+  }
+  std::vector<bool> emitted(p_triangles.size(), false);
+  std::vector<uint32_t> cache;
+  std::vector<std::array<uint32_t, 3>> optimized;
+  optimized.reserve(p_triangles.size());
+  uint32_t firstLeft = 0;
+  uint32_t next = UINT32_MAX;
+  while (optimized.size() < p_triangles.size()) {
+    if (next == UINT32_MAX) {
+      while (emitted[firstLeft]) {
+        ++firstLeft;
+      }
+      next = firstLeft;
+    }
+    const std::array<uint32_t, 3> &triangle = p_triangles[next];
+    emitted[next] = true;
+    optimized.push_back(triangle);
+    std::vector<uint32_t> newCache(triangle.begin(), triangle.end());
+    for (uint32_t vertexIdx : cache) {
+      if (std::ranges::find(triangle, vertexIdx) == triangle.end()) {
+        newCache.push_back(vertexIdx);
+      }
+    }
+    for (uint32_t vertexIdx : triangle) {
+      std::erase(vertexTriangles[vertexIdx], next);
+    }
+    // Rescores the cached vertices, including the ones just pushed out, along with their triangles left.
+    for (uint32_t i = 0; i < newCache.size(); ++i) {
+      uint32_t vertexIdx = newCache[i];
+      float score = scoreVertex(i < g_vertexCacheSize ? std::optional<uint32_t>(i) : std::nullopt,
+                                static_cast<uint32_t>(vertexTriangles[vertexIdx].size()));
+      for (uint32_t triangleIdx : vertexTriangles[vertexIdx]) {
+        triangleScores[triangleIdx] += score - vertexScores[vertexIdx];
+      }
+      vertexScores[vertexIdx] = score;
+    }
+    newCache.resize(std::min<size_t>(newCache.size(), g_vertexCacheSize));
+    cache = std::move(newCache);
+    next = UINT32_MAX;
+    for (uint32_t vertexIdx : cache) {
+      for (uint32_t triangleIdx : vertexTriangles[vertexIdx]) {
+        if (next == UINT32_MAX || triangleScores[next] < triangleScores[triangleIdx]) {
+          next = triangleIdx;
+        }
+      }
+    }
+  }
+  return optimized;
+}
+
+// Vertex cache misses per triangle the overdraw optimization may add, relative to the cache optimized order.
+static const float g_overdrawCacheThreshold = 1.05f;
+
+// Returns the vertices of the triangle missing the simulated FIFO cache and pushes them into it.
+static uint32_t simulateVertexCache(std::vector<uint32_t> &p_fifo, const std::array<uint32_t, 3> &p_triangle) {
+  uint32_t missCount = 0;
+  for (uint32_t vertexIdx : p_triangle) {
+    if (std::ranges::find(p_fifo, vertexIdx) == p_fifo.end()) {
+      ++missCount;
+      p_fifo.push_back(vertexIdx);
+    }
+  }
+  if (g_vertexCacheSize < p_fifo.size()) {
+    p_fifo.erase(p_fifo.begin(), p_fifo.end() - g_vertexCacheSize);
+  }
+  return missCount;
+}
+
+// Splits the cache optimized triangles into clusters and sorts them so the ones lying and facing farthest out come
+// first; from most viewpoints, those occlude the others and save their shading. A cluster ends as soon as its cache
+// misses, starting from an empty cache, are within the threshold of the whole mesh's. See Sander et al., "Fast
+// Triangle Reordering for Vertex Locality and Reduced Overdraw". Like the normal cones of the meshlets, this treats the
+// mesh as a closed surface.
+static std::vector<std::array<uint32_t, 3>> optimizeOverdraw(const std::vector<std::array<uint32_t, 3>> &p_triangles,
+                                                             const TriangleMesh::Vertex *p_vertices) {
+  std::vector<uint32_t> fifo;
+  uint32_t missCount = 0;
+  for (const std::array<uint32_t, 3> &triangle : p_triangles) {
+    missCount += simulateVertexCache(fifo, triangle);
+  }
+  float maxMissesPerTriangle =
+      g_overdrawCacheThreshold * static_cast<float>(missCount) / static_cast<float>(p_triangles.size());
+  std::vector<std::pair<uint32_t, uint32_t>> clusters;
+  fifo.clear();
+  uint32_t clusterMissCount = 0;
+  for (uint32_t i = 0; i < p_triangles.size(); ++i) {
+    if (fifo.empty()) {
+      clusters.emplace_back(i, i);
+    }
+    clusterMissCount += simulateVertexCache(fifo, p_triangles[i]);
+    uint32_t clusterSize = ++clusters.back().second - clusters.back().first;
+    if (static_cast<float>(clusterMissCount) <= maxMissesPerTriangle * static_cast<float>(clusterSize)) {
+      fifo.clear();
+      clusterMissCount = 0;
+    }
+  }
+
+  // Centroids of the clusters and the mesh, weighted by the triangles' areas.
+  std::vector<std::pair<Vec3f, Vec3f>> clusterCentroidsAndNormals;
+  Vec3f meshCentroidSum = {};
+  float meshWeightSum = 0.0f;
+  for (auto [first, end] : clusters) {
+    Vec3f centroidSum = {};
+    Vec3f normalSum = {};
+    float weightSum = 0.0f;
+    for (uint32_t i = first; i < end; ++i) {
+      Vec3f normal = computeOutwardNormal(p_vertices, p_triangles[i]);
+      float weight = std::sqrt(dot(normal, normal));
+      Vec3f center = p_vertices[p_triangles[i][0]].pos;
+      center += p_vertices[p_triangles[i][1]].pos;
+      center += p_vertices[p_triangles[i][2]].pos;
+      centroidSum += weight / 3.0f * center;
+      normalSum += normal;
+      weightSum += weight;
+    }
+    meshCentroidSum += centroidSum;
+    meshWeightSum += weightSum;
+    clusterCentroidsAndNormals.emplace_back(0.0f < weightSum ? centroidSum / weightSum : centroidSum, normalSum);
+  }
+  Vec3f meshCentroid = 0.0f < meshWeightSum ? meshCentroidSum / meshWeightSum : meshCentroidSum;
+  std::vector<float> outwardness(clusters.size(), 0.0f);
+  for (uint32_t i = 0; i < clusters.size(); ++i) {
+    const auto &[centroid, normalSum] = clusterCentroidsAndNormals[i];
+    float normalLength = std::sqrt(dot(normalSum, normalSum));
+    if (0.0f < normalLength) {
+      outwardness[i] = dot(subtract(centroid, meshCentroid), normalSum) / normalLength;
+    }
+  }
+
+  std::vector<uint32_t> order(clusters.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::ranges::stable_sort(order, [&](uint32_t p_left, uint32_t p_right) {
+    return outwardness[p_right] < outwardness[p_left];
+  });
+  std::vector<std::array<uint32_t, 3>> sorted;
+  sorted.reserve(p_triangles.size());
+  for (uint32_t clusterIdx : order) {
+    sorted.insert(sorted.end(), p_triangles.begin() + clusters[clusterIdx].first,
+                  p_triangles.begin() + clusters[clusterIdx].second);
+  }
+  return sorted;
+}
+
+// Grows each meshlet from the first triangle not taken yet, always adding the adjacent triangle that brings the fewest
+// new vertices, which keeps the meshlets compact enough for their normal cones to be useful.
+static MeshletData buildMeshlets(uint32_t p_vertexCount, const TriangleMesh::Vertex *p_vertices,
+                                 const std::vector<std::array<uint32_t, 3>> &p_triangles) {
+  std::vector<std::vector<uint32_t>> vertexTriangles(p_vertexCount);
+  for (uint32_t i = 0; i < p_triangles.size(); ++i) {
+    for (uint32_t vertexIdx : p_triangles[i]) {
+      vertexTriangles[vertexIdx].push_back(i);
+    }
+  }
+  std::vector<bool> taken(p_triangles.size(), false);
+  // Index of each vertex within the meshlet being built.
+  std::vector<uint32_t> localIndices(p_vertexCount, UINT32_MAX);
+  std::vector<uint32_t> meshletTriangles;
+  std::vector<uint32_t> candidates;
+  MeshletData data;
+  for (uint32_t seed = 0; seed < p_triangles.size(); ++seed) {
+    if (taken[seed]) {
+      continue;
+    }
+    TriangleMesh::Meshlet meshlet = {.firstVertex = static_cast<uint32_t>(data.vertexIndices.size()),
+                                     .firstTriangle = static_cast<uint32_t>(data.triangles.size()),
+                                     .vertexCount = 0,
+                                     .triangleCount = 0};
+    meshletTriangles.clear();
+    candidates.clear();
+    for (uint32_t next = seed; next != UINT32_MAX;) {
+      taken[next] = true;
+      meshletTriangles.push_back(next);
+      uint32_t packed = 0;
+      for (uint32_t k = 0; k < 3; ++k) {
+        uint32_t vertexIdx = p_triangles[next][k];
+        if (localIndices[vertexIdx] == UINT32_MAX) {
+          localIndices[vertexIdx] = meshlet.vertexCount++;
+          data.vertexIndices.push_back(vertexIdx);
+          candidates.insert(candidates.end(), vertexTriangles[vertexIdx].begin(), vertexTriangles[vertexIdx].end());
+        }
+        packed |= localIndices[vertexIdx] << (8 * k);
+      }
+      data.triangles.push_back(packed);
+      if (++meshlet.triangleCount == TriangleMesh::MAX_MESHLET_TRIANGLE_COUNT) {
+        break;
+      }
+      std::erase_if(candidates, [&](uint32_t p_triangleIdx) { return taken[p_triangleIdx]; });
+      next = UINT32_MAX;
+      // Adjacent triangles share at least one vertex with the meshlet.
+      uint32_t minNewVertexCount = 3;
+      for (uint32_t candidate : candidates) {
+        uint32_t newVertexCount = 0;
+        for (uint32_t vertexIdx : p_triangles[candidate]) {
+          newVertexCount += localIndices[vertexIdx] == UINT32_MAX ? 1 : 0;
+        }
+        if (newVertexCount < minNewVertexCount &&
+            meshlet.vertexCount + newVertexCount <= TriangleMesh::MAX_MESHLET_VERTEX_COUNT) {
+          next = candidate;
+          minNewVertexCount = newVertexCount;
+          if (newVertexCount == 0) {
+            break;
+          }
+        }
+      }
+    }
+
+    // The sphere is centered at the center of the vertices' bounding box, like the one of the whole mesh.
+    std::vector<uint32_t> vertexIndices(data.vertexIndices.begin() + meshlet.firstVertex, data.vertexIndices.end());
+    Vec3f boxMin = p_vertices[vertexIndices.front()].pos;
+    Vec3f boxMax = boxMin;
+    for (uint32_t vertexIdx : vertexIndices) {
+      const Vec3f &pos = p_vertices[vertexIdx].pos;
+      boxMin = {std::min(boxMin.x, pos.x), std::min(boxMin.y, pos.y), std::min(boxMin.z, pos.z)};
+      boxMax = {std::max(boxMax.x, pos.x), std::max(boxMax.y, pos.y), std::max(boxMax.z, pos.z)};
+      localIndices[vertexIdx] = UINT32_MAX;
+    }
+    Vec3f center = 0.5f * Vec3f{boxMin.x + boxMax.x, boxMin.y + boxMax.y, boxMin.z + boxMax.z};
+    float radiusSquared = 0.0f;
+    for (uint32_t vertexIdx : vertexIndices) {
+      Vec3f offset = subtract(p_vertices[vertexIdx].pos, center);
+      radiusSquared = std::max(radiusSquared, dot(offset, offset));
+    }
+    meshlet.boundingSphere = {center.x, center.y, center.z, std::sqrt(radiusSquared)};
+
+    std::vector<Vec3f> normals;
+    Vec3f normalSum = {};
+    for (uint32_t triangleIdx : meshletTriangles) {
+      Vec3f normal = computeOutwardNormal(p_vertices, p_triangles[triangleIdx]);
+      float length = std::sqrt(dot(normal, normal));
+      if (length == 0.0f) {
+        continue;
+      }
+      normal = 1.0f / length * normal;
+      normals.push_back(normal);
+      normalSum += normal;
+    }
+    meshlet.cone = {0.0f, 0.0f, 0.0f, 1.0f};
+    float axisLength = std::sqrt(dot(normalSum, normalSum));
+    if (0.0f < axisLength) {
+      Vec3f axis = normalSum / axisLength;
+      float minDot = 1.0f;
+      for (const Vec3f &normal : normals) {
+        minDot = std::min(minDot, dot(normal, axis));
+      }
+      meshlet.cone = {axis.x, axis.y, axis.z, 0.0f < minDot ? std::sqrt(1.0f - minDot * minDot) : 1.0f};
+    }
+    data.meshlets.push_back(meshlet);
+  }
+  return data;
+}
+
+TriangleMesh TriangleMesh::createUnitCube(const Renderer &p_renderer) {
   std::vector<Vertex> vertices = {
       {{-0.5f, -0.5f, -0.5f}, {0.0f, 0.0f, -1.0f}, {0.0f, 0.0f}},
       {{+0.5f, -0.5f, -0.5f}, {0.0f, 0.0f, -1.0f}, {1.0f, 0.0f}},
@@ -61,14 +445,12 @@ TriangleMesh TriangleMesh::createUnitCube(const Renderer &p_renderer, uint32_t p
       0,  1,  2,  3,  PRIMITIVE_RESTART, 4,  5,  6,  7,  PRIMITIVE_RESTART, 8,  9,  10, 11, PRIMITIVE_RESTART,
       12, 13, 14, 15, PRIMITIVE_RESTART, 16, 17, 18, 19, PRIMITIVE_RESTART, 20, 21, 22, 23,
   };
-  return {p_renderer,        p_maxInstances,
-          p_sizePerInstance, static_cast<uint32_t>(vertices.size()),
-          vertices.data(),   static_cast<uint32_t>(indices.size()),
+  return {p_renderer, static_cast<uint32_t>(vertices.size()), vertices.data(), static_cast<uint32_t>(indices.size()),
           indices.data()};
 }
 
-TriangleMesh TriangleMesh::createTorusXY(const Renderer &p_renderer, uint32_t p_maxInstances, size_t p_sizePerInstance,
-                                         uint32_t p_subdivisionCount, float p_minorRadius, float p_majorRadius) {
+TriangleMesh TriangleMesh::createTorusXY(const Renderer &p_renderer, uint32_t p_subdivisionCount, float p_minorRadius,
+                                         float p_majorRadius) {
   std::vector<Vertex> vertices;
   vertices.reserve((p_subdivisionCount + 1) * (p_subdivisionCount + 1));
   std::vector<uint32_t> indices;
@@ -99,12 +481,11 @@ TriangleMesh TriangleMesh::createTorusXY(const Renderer &p_renderer, uint32_t p_
       indices.emplace_back(PRIMITIVE_RESTART);
     }
   }
-  return TriangleMesh(p_renderer, p_maxInstances, p_sizePerInstance, static_cast<uint32_t>(vertices.size()),
-                      vertices.data(), static_cast<uint32_t>(indices.size()), indices.data());
+  return TriangleMesh(p_renderer, static_cast<uint32_t>(vertices.size()), vertices.data(),
+                      static_cast<uint32_t>(indices.size()), indices.data());
 }
 
-TriangleMesh TriangleMesh::createPlaneXZ(const Renderer &p_renderer, uint32_t p_maxInstances,
-                                         size_t p_sizePerInstance) {
+TriangleMesh TriangleMesh::createPlaneXZ(const Renderer &p_renderer) {
   std::vector<Vertex> vertices = {
       {{-1.0f, 0.0f, -1.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f}},
       {{+1.0f, 0.0f, -1.0f}, {0.0f, 1.0f, 0.0f}, {1.0f, 0.0f}},
@@ -112,87 +493,151 @@ TriangleMesh TriangleMesh::createPlaneXZ(const Renderer &p_renderer, uint32_t p_
       {{+1.0f, 0.0f, +1.0f}, {0.0f, 1.0f, 0.0f}, {1.0f, 1.0f}},
   };
   std::vector<uint32_t> indices = {0, 1, 2, 3};
-  return {p_renderer,        p_maxInstances,
-          p_sizePerInstance, static_cast<uint32_t>(vertices.size()),
-          vertices.data(),   static_cast<uint32_t>(indices.size()),
+  return {p_renderer, static_cast<uint32_t>(vertices.size()), vertices.data(), static_cast<uint32_t>(indices.size()),
           indices.data()};
 }
 
-TriangleMesh::TriangleMesh(const Renderer &p_renderer, uint32_t p_maxInstances, size_t p_sizePerInstance,
-                           uint32_t p_vertexCount, const Vertex *p_vertices, uint32_t p_indexCount,
-                           const uint32_t *p_indices)
-    : m_vertexCount(p_vertexCount), m_indexCount(p_indexCount), m_maxInstances(p_maxInstances) {
-  std::optional<uint32_t> uploadMemTypeIdx =
-      p_renderer.queryCompatibleMemoryTypeIndex(0, vk::MemoryPropertyFlagBits::eHostVisible);
-  vk::DeviceSize uploadMemSize = m_vertexCount * sizeof(Vertex) + m_indexCount * sizeof(uint32_t);
-  m_uploadMem = p_renderer.vkDevice().allocateMemoryUnique({uploadMemSize, uploadMemTypeIdx.value()});
-  char *mapped = reinterpret_cast<char *>(p_renderer.vkDevice().mapMemory(m_uploadMem.get(), 0, uploadMemSize));
-  memcpy(mapped, p_vertices, m_vertexCount * sizeof(Vertex));
-  if (this->hasIndices()) {
-    memcpy(mapped + m_vertexCount * sizeof(Vertex), p_indices, m_indexCount * sizeof(uint32_t));
+TriangleMesh::TriangleMesh(const Renderer &p_renderer, uint32_t p_vertexCount, const Vertex *p_vertices,
+                           uint32_t p_indexCount, const uint32_t *p_indices)
+    : m_vertexCount(p_vertexCount), m_indexCount(p_indexCount) {
+  // The sphere is centered at the center of the vertices' bounding box, which is tight enough for the meshes used.
+  Vec3f boxMin = p_vertices[0].pos;
+  Vec3f boxMax = p_vertices[0].pos;
+  for (uint32_t i = 1; i < m_vertexCount; ++i) {
+    boxMin = {std::min(boxMin.x, p_vertices[i].pos.x), std::min(boxMin.y, p_vertices[i].pos.y),
+              std::min(boxMin.z, p_vertices[i].pos.z)};
+    boxMax = {std::max(boxMax.x, p_vertices[i].pos.x), std::max(boxMax.y, p_vertices[i].pos.y),
+              std::max(boxMax.z, p_vertices[i].pos.z)};
+  }
+  Vec3f center = 0.5f * Vec3f{boxMin.x + boxMax.x, boxMin.y + boxMax.y, boxMin.z + boxMax.z};
+  float radiusSquared = 0.0f;
+  for (uint32_t i = 0; i < m_vertexCount; ++i) {
+    float dx = p_vertices[i].pos.x - center.x;
+    float dy = p_vertices[i].pos.y - center.y;
+    float dz = p_vertices[i].pos.z - center.z;
+    radiusSquared = std::max(radiusSquared, dx * dx + dy * dy + dz * dz);
+  }
+  m_boundingSphere = {center.x, center.y, center.z, std::sqrt(radiusSquared)};
+  m_positionBounds = {.center = {center.x, center.y, center.z, 0.0f},
+                      .halfExtent = {0.5f * (boxMax.x - boxMin.x), 0.5f * (boxMax.y - boxMin.y),
+                                     0.5f * (boxMax.z - boxMin.z), 0.0f}};
+
+  const std::optional<Options::TriangleOrder> &triangleLists = g_app->getOptions().triangleLists;
+  bool meshShading = g_app->getOptions().meshShading;
+  std::vector<std::array<uint32_t, 3>> triangles;
+  if (triangleLists || meshShading) {
+    // Without indices, the vertices form a single strip.
+    std::vector<uint32_t> stripIndices(p_indices, p_indices + m_indexCount);
+    if (!this->hasIndices()) {
+      stripIndices.resize(m_vertexCount);
+      std::iota(stripIndices.begin(), stripIndices.end(), 0);
+    }
+    triangles = unpackTriangleStrips(stripIndices);
+  }
+  // The strips are replaced by a list of their triangles, reordered for the post-transform cache.
+  const uint32_t *indices = p_indices;
+  std::vector<uint32_t> listIndices;
+  if (triangleLists) {
+    triangles = optimizeVertexCache(triangles, m_vertexCount);
+    if (triangleLists.value() == Options::TriangleOrder::OVERDRAW) {
+      triangles = optimizeOverdraw(triangles, p_vertices);
+    }
+    for (const std::array<uint32_t, 3> &triangle : triangles) {
+      listIndices.insert(listIndices.end(), triangle.begin(), triangle.end());
+    }
+    indices = listIndices.data();
+    m_indexCount = static_cast<uint32_t>(listIndices.size());
+  }
+
+  bool compactVertices = g_app->getOptions().compactVertices;
+  m_vertexSize = compactVertices ? sizeof(CompactVertex) : sizeof(Vertex);
+  m_indexType = m_vertexCount <= UINT16_MAX ? vk::IndexType::eUint16 : vk::IndexType::eUint32;
+  m_uploadData.resize(this->getVertexDataSize() + this->getIndexDataSize());
+  if (compactVertices) {
+    std::vector<CompactVertex> compact(m_vertexCount);
+    for (uint32_t i = 0; i < m_vertexCount; ++i) {
+      compact[i] = compactVertex(p_vertices[i], m_positionBounds);
+    }
+    memcpy(m_uploadData.data(), compact.data(), this->getVertexDataSize());
+  } else {
+    memcpy(m_uploadData.data(), p_vertices, this->getVertexDataSize());
+  }
+  if (this->hasIndices() && m_indexType == vk::IndexType::eUint16) {
+    std::vector<uint16_t> shortIndices(m_indexCount);
+    for (uint32_t i = 0; i < m_indexCount; ++i) {
+      shortIndices[i] = indices[i] == PRIMITIVE_RESTART ? UINT16_MAX : static_cast<uint16_t>(indices[i]);
+    }
+    memcpy(m_uploadData.data() + this->getVertexDataSize(), shortIndices.data(), this->getIndexDataSize());
+  } else if (this->hasIndices()) {
+    memcpy(m_uploadData.data() + this->getVertexDataSize(), indices, this->getIndexDataSize());
+  }
+  if (meshShading) {
+    MeshletData meshlets = buildMeshlets(m_vertexCount, p_vertices, triangles);
+    m_meshletCount = static_cast<uint32_t>(meshlets.meshlets.size());
+    m_meshletVertexOffset = m_meshletCount * sizeof(Meshlet);
+    m_meshletTriangleOffset = m_meshletVertexOffset + meshlets.vertexIndices.size() * sizeof(uint32_t);
+    size_t meshletDataOffset = m_uploadData.size();
+    m_uploadData.resize(meshletDataOffset + m_meshletTriangleOffset + meshlets.triangles.size() * sizeof(uint32_t));
+    char *meshletData = m_uploadData.data() + meshletDataOffset;
+    memcpy(meshletData, meshlets.meshlets.data(), m_meshletVertexOffset);
+    memcpy(meshletData + m_meshletVertexOffset, meshlets.vertexIndices.data(),
+           meshlets.vertexIndices.size() * sizeof(uint32_t));
+    memcpy(meshletData + m_meshletTriangleOffset, meshlets.triangles.data(),
+           meshlets.triangles.size() * sizeof(uint32_t));
   }
-  p_renderer.vkDevice().unmapMemory(m_uploadMem.get());
-  m_uploadBuffer = p_renderer.vkDevice().createBufferUnique(
-      {{}, uploadMemSize, vk::BufferUsageFlagBits::eTransferSrc, vk::SharingMode::eExclusive});
-  p_renderer.vkDevice().bindBufferMemory(m_uploadBuffer.get(), m_uploadMem.get(), 0);
 
+  // Written on the transfer queue and read on the graphics queue, without transferring ownership.
+  std::array<uint32_t, 2> queueFamilyIndices = {p_renderer.getGraphicsQueueFamilyIndex(),
+                                                p_renderer.getTransferQueueFamilyIndex()};
+  // Mesh shaders fetch the vertices from a storage buffer.
   vk::BufferCreateInfo vertexBufferCreateInfo(
-      {}, m_vertexCount * sizeof(Vertex),
-      vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst, vk::SharingMode::eExclusive);
+      {}, this->getVertexDataSize(),
+      vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst |
+          (meshShading ? vk::BufferUsageFlagBits::eStorageBuffer : vk::BufferUsageFlags()),
+      vk::SharingMode::eConcurrent, queueFamilyIndices);
   m_vertexBuffer = p_renderer.vkDevice().createBufferUnique(vertexBufferCreateInfo);
   vk::MemoryRequirements vertexBufferMemReqs = p_renderer.vkDevice().getBufferMemoryRequirements(m_vertexBuffer.get());
   std::optional<uint32_t> vertexBufferMemTypeIdx = p_renderer.queryCompatibleMemoryTypeIndex(
       0, vk::MemoryPropertyFlagBits::eDeviceLocal, vertexBufferMemReqs.memoryTypeBits);
   XRMG_ASSERT(vertexBufferMemTypeIdx, "No memory type for vertex buffer available.");
-
-  vk::DeviceSize geoBufferSize = vertexBufferMemReqs.size;
-  vk::DeviceSize indexBufferOffset = 0;
-  vk::DeviceSize instanceBufferOffset = 0;
+  m_vertexMemory = p_renderer.getMemoryAllocator().allocateBufferMemory(
+      m_vertexBuffer.get(), vertexBufferMemTypeIdx.value(), p_renderer.getDeviceMaskAll());
 
   if (this->hasIndices()) {
     vk::BufferCreateInfo indexBufferCreateInfo(
-        {}, m_indexCount * sizeof(uint32_t),
-        vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst, vk::SharingMode::eExclusive);
+        {}, this->getIndexDataSize(),
+        vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst, vk::SharingMode::eConcurrent,
+        queueFamilyIndices);
     m_indexBuffer = p_renderer.vkDevice().createBufferUnique(indexBufferCreateInfo);
     vk::MemoryRequirements indexBufferMemReqs = p_renderer.vkDevice().getBufferMemoryRequirements(m_indexBuffer.get());
     std::optional<uint32_t> indexBufferMemTypeIdx = p_renderer.queryCompatibleMemoryTypeIndex(
         0, vk::MemoryPropertyFlagBits::eDeviceLocal, indexBufferMemReqs.memoryTypeBits);
     XRMG_ASSERT(indexBufferMemTypeIdx, "No memory type for index buffer available.");
-    XRMG_ASSERT(vertexBufferMemTypeIdx.value() == indexBufferMemTypeIdx.value(),
-                "Memory types of index and vertex buffer do not match.");
-
-    indexBufferOffset = ALIGN(geoBufferSize, indexBufferMemReqs.alignment);
-    geoBufferSize = indexBufferOffset + indexBufferMemReqs.size;
-  }
-
-  vk::BufferCreateInfo instanceBufferCreateInfo(
-      {}, p_maxInstances * p_sizePerInstance,
-      vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst, vk::SharingMode::eExclusive, {});
-  m_instanceBuffer = p_renderer.vkDevice().createBufferUnique(instanceBufferCreateInfo);
-  vk::MemoryRequirements instanceBufferMemReqs =
-      p_renderer.vkDevice().getBufferMemoryRequirements(m_instanceBuffer.get());
-  std::optional<uint32_t> instanceBufferMemTypeIndex = p_renderer.queryCompatibleMemoryTypeIndex(
-      0, vk::MemoryPropertyFlagBits::eDeviceLocal, instanceBufferMemReqs.memoryTypeBits);
-  XRMG_ASSERT(instanceBufferMemTypeIndex, "No memory type for instance buffer available.");
-  XRMG_ASSERT(vertexBufferMemTypeIdx.value() == instanceBufferMemTypeIndex.value(),
-              "Memory types of instance and vertex buffer do not match.");
-
-  instanceBufferOffset = ALIGN(geoBufferSize, instanceBufferMemReqs.alignment);
-  geoBufferSize = instanceBufferOffset + instanceBufferMemReqs.size;
-
-  m_geoMem = p_renderer.vkDevice().allocateMemoryUnique({geoBufferSize, vertexBufferMemTypeIdx.value()});
-  p_renderer.vkDevice().bindBufferMemory(m_vertexBuffer.get(), m_geoMem.get(), 0);
-  if (this->hasIndices()) {
-    p_renderer.vkDevice().bindBufferMemory(m_indexBuffer.get(), m_geoMem.get(), indexBufferOffset);
+    m_indexMemory = p_renderer.getMemoryAllocator().allocateBufferMemory(
+        m_indexBuffer.get(), indexBufferMemTypeIdx.value(), p_renderer.getDeviceMaskAll());
+  }
+
+  if (this->hasMeshlets()) {
+    vk::BufferCreateInfo meshletBufferCreateInfo(
+        {}, m_uploadData.size() - (this->getVertexDataSize() + this->getIndexDataSize()),
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, vk::SharingMode::eConcurrent,
+        queueFamilyIndices);
+    m_meshletBuffer = p_renderer.vkDevice().createBufferUnique(meshletBufferCreateInfo);
+    vk::MemoryRequirements meshletBufferMemReqs =
+        p_renderer.vkDevice().getBufferMemoryRequirements(m_meshletBuffer.get());
+    std::optional<uint32_t> meshletBufferMemTypeIdx = p_renderer.queryCompatibleMemoryTypeIndex(
+        0, vk::MemoryPropertyFlagBits::eDeviceLocal, meshletBufferMemReqs.memoryTypeBits);
+    XRMG_ASSERT(meshletBufferMemTypeIdx, "No memory type for meshlet buffer available.");
+    m_meshletMemory = p_renderer.getMemoryAllocator().allocateBufferMemory(
+        m_meshletBuffer.get(), meshletBufferMemTypeIdx.value(), p_renderer.getDeviceMaskAll());
   }
-  p_renderer.vkDevice().bindBufferMemory(m_instanceBuffer.get(), m_geoMem.get(), instanceBufferOffset);
 }
 
-void TriangleMesh::bind(vk::CommandBuffer p_cmdBuffer) const {
+void TriangleMesh::bind(vk::CommandBuffer p_cmdBuffer, vk::Buffer p_instanceBuffer) const {
   XRMG_WARN_UNLESS(m_uploaded, "Binding triangle mesh before it was uploaded.");
-  p_cmdBuffer.bindVertexBuffers(0, {m_vertexBuffer.get(), m_instanceBuffer.get()}, {0, 0});
+  p_cmdBuffer.bindVertexBuffers(0, {m_vertexBuffer.get(), p_instanceBuffer}, {0, 0});
   if (this->hasIndices()) {
-    p_cmdBuffer.bindIndexBuffer(m_indexBuffer.get(), 0, vk::IndexType::eUint32);
+    p_cmdBuffer.bindIndexBuffer(m_indexBuffer.get(), 0, m_indexType);
   }
 }
 
@@ -205,43 +650,30 @@ void TriangleMesh::draw(vk::CommandBuffer p_cmdBuffer, uint32_t p_instanceCount,
   }
 }
 
-void TriangleMesh::upload(vk::Device p_vkDevice, uint32_t p_queueFamilyIndex, uint32_t p_deviceMask) {
-  XRMG_WARN_IF(m_uploaded, "Triangle mesh already uploaded.");
-  vk::UniqueCommandPool cmdPool = p_vkDevice.createCommandPoolUnique({{}, p_queueFamilyIndex});
-  vk::UniqueCommandBuffer cmdBuffer =
-      std::move(p_vkDevice.allocateCommandBuffersUnique({cmdPool.get(), vk::CommandBufferLevel::ePrimary, 1}).front());
-
-  vk::DeviceSize vbSize = m_vertexCount * sizeof(Vertex);
-  vk::DeviceSize ibSize = m_indexCount * sizeof(uint32_t);
-  std::vector<vk::BufferMemoryBarrier2> preUploadBarriers = {
-      {vk::PipelineStageFlagBits2::eNone, vk::AccessFlagBits2::eNone, vk::PipelineStageFlagBits2::eTransfer,
-       vk::AccessFlagBits2::eTransferWrite, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, m_vertexBuffer.get(), 0,
-       vbSize},
-  };
-  std::vector<vk::BufferMemoryBarrier2> postUploadBarriers = {
-      {vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
-       vk::PipelineStageFlagBits2::eVertexAttributeInput, vk::AccessFlagBits2::eVertexAttributeRead,
-       VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, m_vertexBuffer.get(), 0, vbSize}};
+void TriangleMesh::drawIndirect(vk::CommandBuffer p_cmdBuffer, vk::Buffer p_drawCommandBuffer,
+                                vk::DeviceSize p_offset) const {
+  XRMG_WARN_UNLESS(m_uploaded, "Drawing triangle mesh before it was uploaded.");
   if (this->hasIndices()) {
-    preUploadBarriers.emplace_back(vk::PipelineStageFlagBits2::eNone, vk::AccessFlagBits2::eNone,
-                                   vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
-                                   VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, m_indexBuffer.get(), 0, ibSize);
-    postUploadBarriers.emplace_back(vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
-                                    vk::PipelineStageFlagBits2::eIndexInput, vk::AccessFlagBits2::eIndexRead,
-                                    VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, m_indexBuffer.get(), 0, ibSize);
+    p_cmdBuffer.drawIndexedIndirect(p_drawCommandBuffer, p_offset, 1, sizeof(vk::DrawIndexedIndirectCommand));
+  } else {
+    p_cmdBuffer.drawIndirect(p_drawCommandBuffer, p_offset, 1, sizeof(vk::DrawIndirectCommand));
   }
+}
 
-  cmdBuffer->begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
-  cmdBuffer->pipelineBarrier2(vk::DependencyInfo({}, {}, preUploadBarriers));
-  cmdBuffer->copyBuffer(m_uploadBuffer.get(), m_vertexBuffer.get(), {{0, 0, vbSize}});
+uint64_t TriangleMesh::upload(MeshUploader &p_uploader) {
+  XRMG_WARN_IF(m_uploaded, "Triangle mesh already uploaded.");
+  vk::DeviceSize vbSize = this->getVertexDataSize();
+  vk::DeviceSize ibSize = this->getIndexDataSize();
+  uint64_t uploadValue = p_uploader.upload(m_vertexBuffer.get(), m_uploadData.data(), vbSize);
   if (this->hasIndices()) {
-    cmdBuffer->copyBuffer(m_uploadBuffer.get(), m_indexBuffer.get(), {{vbSize, 0, ibSize}});
+    uploadValue = p_uploader.upload(m_indexBuffer.get(), m_uploadData.data() + vbSize, ibSize);
+  }
+  if (this->hasMeshlets()) {
+    uploadValue = p_uploader.upload(m_meshletBuffer.get(), m_uploadData.data() + vbSize + ibSize,
+                                    m_uploadData.size() - (vbSize + ibSize));
   }
-  cmdBuffer->pipelineBarrier2(vk::DependencyInfo({}, {}, postUploadBarriers));
-  cmdBuffer->end();
-  vk::CommandBufferSubmitInfo cmdBufferSubmit(cmdBuffer.get(), p_deviceMask);
-  p_vkDevice.getQueue(p_queueFamilyIndex, 0).submit2(vk::SubmitInfo2({}, {}, cmdBufferSubmit));
-  p_vkDevice.getQueue(p_queueFamilyIndex, 0).waitIdle();
+  m_uploadData = {};
   m_uploaded = true;
+  return uploadValue;
 }
 } // namespace xrmg
\ No newline at end of file
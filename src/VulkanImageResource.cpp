@@ -26,16 +26,20 @@ VulkanImageResource::VulkanImageResource(const Renderer &p_renderer, uint32_t p_
                                          std::optional<vk::ImageViewCreateInfo> p_imageViewCreateInfo) {
   m_image = p_renderer.vkDevice().createImageUnique(p_imageCreateInfo);
   vk::MemoryRequirements memReqs = p_renderer.vkDevice().getImageMemoryRequirements(m_image.get());
-  std::optional<uint32_t> memTypeIdx = p_renderer.queryCompatibleMemoryTypeIndex(
-      p_physicalDeviceIndex, vk::MemoryPropertyFlagBits::eDeviceLocal, memReqs.memoryTypeBits);
+  std::optional<uint32_t> memTypeIdx;
+  if (p_imageCreateInfo.usage & vk::ImageUsageFlagBits::eTransientAttachment) {
+    // Transient attachments never leave the tile memory on some GPUs, so they don't need to be backed by memory there.
+    memTypeIdx = p_renderer.queryCompatibleMemoryTypeIndex(
+        p_physicalDeviceIndex, vk::MemoryPropertyFlagBits::eDeviceLocal | vk::MemoryPropertyFlagBits::eLazilyAllocated,
+        memReqs.memoryTypeBits);
+  }
+  if (!memTypeIdx) {
+    memTypeIdx = p_renderer.queryCompatibleMemoryTypeIndex(
+        p_physicalDeviceIndex, vk::MemoryPropertyFlagBits::eDeviceLocal, memReqs.memoryTypeBits);
+  }
   XRMG_ASSERT(memTypeIdx.has_value(), "No compatible memory type found.");
-  vk::MemoryAllocateFlagsInfo alllocateFlagsInfo(vk::MemoryAllocateFlagBits::eDeviceMask,
-                                                 p_renderer.deviceIndexToDeviceMask(p_physicalDeviceIndex));
-
-  vk::MemoryAllocateInfo allocateInfo(memReqs.size, memTypeIdx.value(), &alllocateFlagsInfo);
-  m_memory = p_renderer.vkDevice().allocateMemoryUnique(allocateInfo);
-  vk::BindImageMemoryInfo bindInfo = {m_image.get(), m_memory.get()};
-  p_renderer.vkDevice().bindImageMemory2(bindInfo);
+  m_memory = p_renderer.getMemoryAllocator().allocateImageMemory(
+      m_image.get(), memTypeIdx.value(), p_renderer.deviceIndexToDeviceMask(p_physicalDeviceIndex));
   vk::ImageAspectFlags imageAspectFlags;
   if (p_imageViewCreateInfo) {
     vk::ImageViewCreateInfo imageViewCreateInfo = p_imageViewCreateInfo.value();
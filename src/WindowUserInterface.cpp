@@ -78,6 +78,11 @@ vk::Extent2D WindowUserInterface::getResolutionPerEye() {
   return {m_window.getSwapchainImageSize().width / 2, m_window.getSwapchainImageSize().height};
 }
 
+vk::Rect2D WindowUserInterface::getViewImageRect(uint32_t p_viewIndex) {
+  vk::Extent2D resolution = this->getResolutionPerEye();
+  return {{static_cast<int32_t>(p_viewIndex * resolution.width), 0}, resolution};
+}
+
 UserInterface::FrameInfo WindowUserInterface::beginFrame() {
   auto now = std::chrono::high_resolution_clock::now();
   if (!m_lastBeginFrame) {
@@ -97,7 +102,7 @@ vk::Semaphore WindowUserInterface::getSwapchainImageReadySemaphore() {
   return m_swapchainImageReadySemaphores[m_swapchainImageReadySemaphoreIndex].get();
 }
 
-void WindowUserInterface::releaseSwapchainImage() {
+void WindowUserInterface::releaseSwapchainImage(bool p_depthWritten) {
   m_swapchainImageReadySemaphoreIndex = (m_swapchainImageReadySemaphoreIndex + 1) % MAX_QUEUED_FRAMES;
 }
 
@@ -180,7 +185,7 @@ void WindowUserInterface::buildProjections() {
       StereoProjection::Eye::RIGHT, m_ipd, m_projectionPlaneDistance, VERTICAL_FOV, aspectRatio, 1e-2f, 1e2f);
 }
 
-Mat4x4f WindowUserInterface::getCurrentFrameView(StereoProjection::Eye p_eye) {
+Mat4x4f WindowUserInterface::getCurrentFrameView(uint32_t p_viewIndex) {
   Mat4x4f cameraPose = Mat4x4f::createTranslation(m_camPos) * Mat4x4f::createRotation({}, m_camPitch, m_camYaw);
   if (!g_app->isPaused()) {
     Mat4x4f rotation = Mat4x4f::createRotation({}, Angle::deg(-30.0f), Angle::deg(45.0f * 1e-4f * m_runtimeMillis));
@@ -191,12 +196,13 @@ Mat4x4f WindowUserInterface::getCurrentFrameView(StereoProjection::Eye p_eye) {
   g_app->getScene().updateProjectionPlane(cameraPose, VERTICAL_FOV, this->getAspectRatioPerEye(),
                                           m_projectionPlaneDistance);
 
-  Mat4x4f eyeTranslation = StereoProjection::createStereoEyeTranslation(p_eye, m_ipd);
+  Mat4x4f eyeTranslation =
+      StereoProjection::createStereoEyeTranslation(static_cast<StereoProjection::Eye>(p_viewIndex), m_ipd);
   return (cameraPose * eyeTranslation).invert();
 }
 
-StereoProjection WindowUserInterface::getCurrentFrameProjection(StereoProjection::Eye p_eye) {
-  return m_projections[p_eye];
+StereoProjection WindowUserInterface::getCurrentFrameProjection(uint32_t p_viewIndex) {
+  return m_projections[static_cast<StereoProjection::Eye>(p_viewIndex)];
 }
 
 void WindowUserInterface::endFrame(vk::Queue p_presentGraphicsQueue) {
@@ -20,6 +20,7 @@
 
 #include "App.hpp"
 
+#include <cstring>
 #include <thread>
 
 namespace xrmg {
@@ -37,23 +38,41 @@ PFN_xrGetVulkanGraphicsRequirements2KHR xrGetVulkanGraphicsRequirements2KHR;
 PFN_xrGetVulkanGraphicsDevice2KHR xrGetVulkanGraphicsDevice2KHR;
 PFN_xrCreateVulkanInstanceKHR xrCreateVulkanInstanceKHR;
 
-XrUserInterface::XrUserInterface(bool p_enableCoreValidation) : m_resolutionPerEye(0, 0) {
+XrUserInterface::XrUserInterface(bool p_enableCoreValidation) {
   std::vector<const char *> enabledLayers = {};
   if (p_enableCoreValidation) {
     enabledLayers.emplace_back("XR_APILAYER_LUNARG_core_validation");
   }
   std::vector<const char *> enabledExtensions = {"XR_KHR_vulkan_enable2"};
+  if (g_app->getOptions().quadViews) {
+    // Quad views are core since OpenXR 1.1; OpenXR 1.0 runtimes may still provide them through XR_VARJO_quad_views.
+    uint32_t extensionCount;
+    XRMG_ASSERT_XR(xrEnumerateInstanceExtensionProperties(nullptr, 0, &extensionCount, nullptr));
+    std::vector<XrExtensionProperties> extensionProps(extensionCount, {.type = XR_TYPE_EXTENSION_PROPERTIES});
+    XRMG_ASSERT_XR(
+        xrEnumerateInstanceExtensionProperties(nullptr, extensionCount, &extensionCount, extensionProps.data()));
+    if (std::any_of(extensionProps.begin(), extensionProps.end(), [](const XrExtensionProperties &p_props) {
+          return strcmp(p_props.extensionName, XR_VARJO_QUAD_VIEWS_EXTENSION_NAME) == 0;
+        })) {
+      enabledExtensions.emplace_back(XR_VARJO_QUAD_VIEWS_EXTENSION_NAME);
+    }
+  }
   XrInstanceCreateInfo instanceCreateInfo = {.type = XR_TYPE_INSTANCE_CREATE_INFO,
                                              .applicationInfo = {.applicationName = SAMPLE_NAME,
                                                                  .applicationVersion = 1,
                                                                  .engineName = SAMPLE_NAME,
                                                                  .engineVersion = 1,
-                                                                 .apiVersion = XR_API_VERSION_1_0},
+                                                                 .apiVersion = XR_API_VERSION_1_1},
                                              .enabledApiLayerCount = static_cast<uint32_t>(enabledLayers.size()),
                                              .enabledApiLayerNames = enabledLayers.data(),
                                              .enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size()),
                                              .enabledExtensionNames = enabledExtensions.data()};
   XrResult r = xrCreateInstance(&instanceCreateInfo, &m_instance);
+  if (r == XR_ERROR_API_VERSION_UNSUPPORTED) {
+    XRMG_WARN("OpenXR 1.1 not supported by the runtime; falling back to OpenXR 1.0.");
+    instanceCreateInfo.applicationInfo.apiVersion = XR_API_VERSION_1_0;
+    r = xrCreateInstance(&instanceCreateInfo, &m_instance);
+  }
   XRMG_ASSERT(r == XrResult::XR_SUCCESS, "OpenXR instance creation failed.");
   XRMG_SET_XR_FUNCTION(xrGetVulkanGraphicsRequirements2KHR);
   XRMG_SET_XR_FUNCTION(xrGetVulkanGraphicsDevice2KHR);
@@ -75,6 +94,18 @@ XrUserInterface::XrUserInterface(bool p_enableCoreValidation) : m_resolutionPerE
   XRMG_ASSERT_XR(xrEnumerateViewConfigurations(m_instance, m_systemId, viewConfigurationCount, &viewConfigurationCount,
                                                viewConfiurationTypes.data()));
 
+  if (g_app->getOptions().quadViews) {
+    // Views 0 and 1 are the wide left and right views, views 2 and 3 the high resolution insets.
+    if (std::find(viewConfiurationTypes.begin(), viewConfiurationTypes.end(),
+                  XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO_WITH_FOVEATED_INSET) != viewConfiurationTypes.end()) {
+      m_viewConfigurationType = XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO_WITH_FOVEATED_INSET;
+      m_viewCount = 4;
+      XRMG_INFO("Using primary stereo with foveated inset view configuration.");
+    } else {
+      XRMG_WARN("Quad views not supported by the OpenXR runtime; falling back to primary stereo.");
+    }
+  }
+
   std::stringstream log;
   log << "XR view configurations" << std::endl;
   for (uint32_t i = 0; i < viewConfigurationCount; ++i) {
@@ -110,24 +141,36 @@ XrUserInterface::XrUserInterface(bool p_enableCoreValidation) : m_resolutionPerE
                  j, view.maxImageRectWidth, view.maxImageRectHeight, view.maxSwapchainSampleCount,
                  view.recommendedImageRectWidth, view.recommendedImageRectHeight, view.recommendedSwapchainSampleCount)
           << std::endl;
-      if (viewConfiurationTypes[i] == XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO) {
-        if (j == 0) {
-          m_resolutionPerEye = vk::Extent2D(view.recommendedImageRectWidth, view.recommendedImageRectHeight);
-        } else if (j == 1) {
-          XRMG_WARN_UNLESS(m_resolutionPerEye.width == view.recommendedImageRectWidth &&
-                               m_resolutionPerEye.height == view.recommendedImageRectHeight,
-                           "Recommended image rect sizes differ between views.");
-        }
-      }
     }
   }
   XRMG_INFO("{}", log.str());
   XRMG_ASSERT(std::find(viewConfiurationTypes.begin(), viewConfiurationTypes.end(),
                         XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO) != viewConfiurationTypes.end(),
               "Primary stereo view configuration type is not supported.");
+  this->updateViewResolutions();
+}
+
+void XrUserInterface::updateViewResolutions() {
+  uint32_t viewCount;
+  XRMG_ASSERT_XR(
+      xrEnumerateViewConfigurationViews(m_instance, m_systemId, m_viewConfigurationType, 0, &viewCount, nullptr));
+  std::vector<XrViewConfigurationView> views(viewCount, {.type = XR_TYPE_VIEW_CONFIGURATION_VIEW});
+  XRMG_ASSERT_XR(xrEnumerateViewConfigurationViews(m_instance, m_systemId, m_viewConfigurationType, viewCount,
+                                                   &viewCount, views.data()));
+  XRMG_ASSERT(m_viewCount <= viewCount, "Expected at least {} views, but got {}.", m_viewCount, viewCount);
+  for (uint32_t i = 0; i < m_viewCount; ++i) {
+    if (i % 2 == 0) {
+      m_viewResolutions[i] = vk::Extent2D(views[i].recommendedImageRectWidth, views[i].recommendedImageRectHeight);
+    } else {
+      XRMG_WARN_UNLESS(m_viewResolutions[i - 1].width == views[i].recommendedImageRectWidth &&
+                           m_viewResolutions[i - 1].height == views[i].recommendedImageRectHeight,
+                       "Recommended image rect sizes differ between views.");
+      m_viewResolutions[i] = m_viewResolutions[i - 1];
+    }
+  }
   if (g_app->getOptions().xrResolutionPerEye) {
-    m_resolutionPerEye = g_app->getOptions().xrResolutionPerEye.value();
-    XRMG_INFO("Overriding resolution per eye to: {}x{}", m_resolutionPerEye.width, m_resolutionPerEye.height);
+    m_viewResolutions[0] = m_viewResolutions[1] = g_app->getOptions().xrResolutionPerEye.value();
+    XRMG_INFO("Overriding resolution per eye to: {}x{}", m_viewResolutions[0].width, m_viewResolutions[0].height);
   }
 }
 
@@ -185,6 +228,15 @@ std::optional<uint32_t> XrUserInterface::queryMainPhysicalDevice(vk::Instance p_
   });
   XRMG_ASSERT(findIt != p_candidates + p_candidateCount, "No compatible main physical device found for OpenXR.");
   m_mainPhysicalDevice = *findIt;
+  // The four views are distributed one per physical device, so fewer or more devices render primary stereo.
+  uint32_t physicalDeviceCount = g_app->getOptions().simulatedPhysicalDeviceCount.value_or(p_candidateCount);
+  if (m_viewCount == 4 && physicalDeviceCount != 4) {
+    XRMG_WARN("Quad views require 4 physical devices, but {} are used; falling back to primary stereo.",
+              physicalDeviceCount);
+    m_viewConfigurationType = XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO;
+    m_viewCount = 2;
+    this->updateViewResolutions();
+  }
   return static_cast<uint32_t>(findIt - p_candidates);
 }
 
@@ -209,17 +261,24 @@ void XrUserInterface::initialize(const Renderer &p_renderer, uint32_t p_presentQ
     this->handleEvents();
   } while (m_sessionState != XR_SESSION_STATE_READY);
   XrSessionBeginInfo sessionBeginInfo = {.type = XR_TYPE_SESSION_BEGIN_INFO,
-                                         .primaryViewConfigurationType = XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO};
+                                         .primaryViewConfigurationType = m_viewConfigurationType};
   XRMG_ASSERT_XR(xrBeginSession(m_session, &sessionBeginInfo));
 
+  // All views share one swapchain; see getViewImageRect for the layout.
+  vk::Extent2D swapchainSize(0, 0);
+  for (uint32_t i = 0; i < m_viewCount; ++i) {
+    vk::Rect2D viewImageRect = this->getViewImageRect(i);
+    swapchainSize.width = std::max(swapchainSize.width, viewImageRect.offset.x + viewImageRect.extent.width);
+    swapchainSize.height = std::max(swapchainSize.height, viewImageRect.offset.y + viewImageRect.extent.height);
+  }
   XrSwapchainCreateInfo swapchainCreateInfo = {
       .type = XR_TYPE_SWAPCHAIN_CREATE_INFO,
       .createFlags = 0,
       .usageFlags = XR_SWAPCHAIN_USAGE_TRANSFER_DST_BIT | XR_SWAPCHAIN_USAGE_COLOR_ATTACHMENT_BIT,
       .format = static_cast<uint64_t>(g_renderFormat),
       .sampleCount = 1,
-      .width = 2 * m_resolutionPerEye.width,
-      .height = m_resolutionPerEye.height,
+      .width = swapchainSize.width,
+      .height = swapchainSize.height,
       .faceCount = 1,
       .arraySize = 1,
       .mipCount = 1,
@@ -236,6 +295,16 @@ void XrUserInterface::initialize(const Renderer &p_renderer, uint32_t p_presentQ
   XRMG_ASSERT_XR(xrCreateReferenceSpace(m_session, &spaceCreateInfo, &m_space));
 }
 
+vk::Rect2D XrUserInterface::getViewImageRect(uint32_t p_viewIndex) {
+  // The left views are in the first column, the right views in the second one. The insets are below the wide views.
+  XRMG_ASSERT(p_viewIndex < m_viewCount, "View index ({}) must be less than the view count ({}).", p_viewIndex,
+              m_viewCount);
+  uint32_t columnWidth = std::max(m_viewResolutions[0].width, m_viewResolutions[m_viewCount - 1].width);
+  return {{static_cast<int32_t>((p_viewIndex % 2) * columnWidth),
+           static_cast<int32_t>((p_viewIndex / 2) * m_viewResolutions[0].height)},
+          m_viewResolutions[p_viewIndex]};
+}
+
 XrUserInterface::Swapchain XrUserInterface::createSwapchain(const XrSwapchainCreateInfo &p_createInfo) const {
   XrSwapchain swapchain;
   XRMG_ASSERT_XR(xrCreateSwapchain(m_session, &p_createInfo, &swapchain));
@@ -264,32 +333,44 @@ XrUserInterface::FrameInfo XrUserInterface::beginFrame() {
     XRMG_ASSERT_XR(xrWaitFrame(m_session, &frameWaitInfo, &frameState));
   }
   m_currentFramePredictedDisplayTime = frameState.predictedDisplayTime;
-  XrViewLocateInfo viewLocateInfo = {.type = XR_TYPE_VIEW_LOCATE_INFO,
-                                     .viewConfigurationType = XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO,
-                                     .displayTime = frameState.predictedDisplayTime,
-                                     .space = m_space};
-  XrViewState viewState = {.type = XR_TYPE_VIEW_STATE};
-  uint32_t viewCount;
-  XRMG_ASSERT_XR(xrLocateViews(m_session, &viewLocateInfo, &viewState, 0, &viewCount, nullptr));
-  XRMG_ASSERT(viewCount == VIEW_COUNT, "Expected view count: {}, actual: {}", VIEW_COUNT, viewCount);
-  XRMG_ASSERT_XR(xrLocateViews(m_session, &viewLocateInfo, &viewState, viewCount, &viewCount, m_locatedViews.data()));
+  this->locateViews();
   {
     XRMG_SCOPED_INSTRUMENT("xrBeginFrame");
     XRMG_ASSERT_XR(xrBeginFrame(m_session, nullptr));
   }
   m_swapchainImageState = SwapchainImageState::UNTOUCHED;
-  return frameState.shouldRender ? FrameInfo{.predictedDisplayTimeNanos = frameState.predictedDisplayTime}
+  return frameState.shouldRender ? FrameInfo{.predictedDisplayTimeNanos = frameState.predictedDisplayTime,
+                                             .predictedDisplayPeriodNanos = frameState.predictedDisplayPeriod}
                                  : FrameInfo{};
 }
 
-Mat4x4f XrUserInterface::getCurrentFrameView(StereoProjection::Eye p_eye) {
-  const XrQuaternionf &q = m_locatedViews[p_eye == StereoProjection::Eye::LEFT ? 0 : 1].pose.orientation;
-  const XrVector3f &p = m_locatedViews[p_eye == StereoProjection::Eye::LEFT ? 0 : 1].pose.position;
+void XrUserInterface::locateViews() {
+  XrViewLocateInfo viewLocateInfo = {.type = XR_TYPE_VIEW_LOCATE_INFO,
+                                     .viewConfigurationType = m_viewConfigurationType,
+                                     .displayTime = m_currentFramePredictedDisplayTime,
+                                     .space = m_space};
+  XrViewState viewState = {.type = XR_TYPE_VIEW_STATE};
+  uint32_t viewCount;
+  XRMG_ASSERT_XR(xrLocateViews(m_session, &viewLocateInfo, &viewState, 0, &viewCount, nullptr));
+  XRMG_ASSERT(viewCount == m_viewCount, "Expected view count: {}, actual: {}", m_viewCount, viewCount);
+  XRMG_ASSERT_XR(xrLocateViews(m_session, &viewLocateInfo, &viewState, viewCount, &viewCount, m_locatedViews.data()));
+}
+
+void XrUserInterface::latchCurrentFrameViews() {
+  // The predicted display time stays the same, but the closer we get to it, the more accurate the runtime's prediction
+  // becomes. The relocated poses are also the ones submitted with the projection layer in endFrame.
+  XRMG_SCOPED_INSTRUMENT("xrLocateViews");
+  this->locateViews();
+}
+
+Mat4x4f XrUserInterface::getCurrentFrameView(uint32_t p_viewIndex) {
+  const XrQuaternionf &q = m_locatedViews[p_viewIndex].pose.orientation;
+  const XrVector3f &p = m_locatedViews[p_viewIndex].pose.position;
   return Mat4x4f::createRotation(-q.x, -q.y, -q.z, q.w) * Mat4x4f::createTranslation(-p.x, -p.y, -p.z);
 }
 
-StereoProjection XrUserInterface::getCurrentFrameProjection(StereoProjection::Eye p_eye) {
-  const XrFovf &fov = m_locatedViews[p_eye == StereoProjection::Eye::LEFT ? 0 : 1].fov;
+StereoProjection XrUserInterface::getCurrentFrameProjection(uint32_t p_viewIndex) {
+  const XrFovf &fov = m_locatedViews[p_viewIndex].fov;
   Angle hFov = Angle::rad(fov.angleRight - fov.angleLeft);
   Angle vFov = Angle::rad(fov.angleUp - fov.angleDown);
   XRMG_WARN_IF(hFov.rad() < 0.0f || vFov.rad() < 0.0f, "Image flipping not yet supported.");
@@ -311,11 +392,12 @@ XrUserInterface::FrameRenderTargets XrUserInterface::acquireSwapchainImages(vk::
           m_depthSwapchain.images[depthSwapchainImageIndex], vk::ImageLayout::eDepthStencilAttachmentOptimal};
 }
 
-void XrUserInterface::releaseSwapchainImage() {
+void XrUserInterface::releaseSwapchainImage(bool p_depthWritten) {
   XrSwapchainImageReleaseInfo releaseInfo = {.type = XR_TYPE_SWAPCHAIN_IMAGE_RELEASE_INFO};
   XRMG_ASSERT_XR(xrReleaseSwapchainImage(m_colorSwapchain.swapchain, &releaseInfo));
   XRMG_ASSERT_XR(xrReleaseSwapchainImage(m_depthSwapchain.swapchain, &releaseInfo));
   m_swapchainImageState = SwapchainImageState::RELEASED;
+  m_depthWritten = p_depthWritten;
 }
 
 void XrUserInterface::endFrame(vk::Queue p_presentGraphicsQueue) {
@@ -323,12 +405,13 @@ void XrUserInterface::endFrame(vk::Queue p_presentGraphicsQueue) {
                     m_sessionState == XR_SESSION_STATE_STOPPING,
                 "Illegal call to endFrame.");
 
-  std::vector<XrCompositionLayerProjectionView> projectionViews(VIEW_COUNT);
-  std::vector<XrCompositionLayerDepthInfoKHR> depthViews(VIEW_COUNT);
-  for (uint32_t i = 0; i < VIEW_COUNT; ++i) {
-    XrRect2Di imageRect = {
-        .offset = {static_cast<int32_t>((i % 2) * m_resolutionPerEye.width), 0},
-        .extent = {static_cast<int32_t>(m_resolutionPerEye.width), static_cast<int32_t>(m_resolutionPerEye.height)}};
+  std::vector<XrCompositionLayerProjectionView> projectionViews(m_viewCount);
+  std::vector<XrCompositionLayerDepthInfoKHR> depthViews(m_viewCount);
+  for (uint32_t i = 0; i < m_viewCount; ++i) {
+    vk::Rect2D viewImageRect = this->getViewImageRect(i);
+    XrRect2Di imageRect = {.offset = {viewImageRect.offset.x, viewImageRect.offset.y},
+                           .extent = {static_cast<int32_t>(viewImageRect.extent.width),
+                                      static_cast<int32_t>(viewImageRect.extent.height)}};
     depthViews[i] = {
         .type = XR_TYPE_COMPOSITION_LAYER_DEPTH_INFO_KHR,
         .subImage = {.swapchain = m_depthSwapchain.swapchain, .imageRect = imageRect, .imageArrayIndex = 0},
@@ -338,7 +421,8 @@ void XrUserInterface::endFrame(vk::Queue p_presentGraphicsQueue) {
         .farZ = 1e2f};
     projectionViews[i] = {
         .type = XR_TYPE_COMPOSITION_LAYER_PROJECTION_VIEW,
-        .next = &depthViews[i],
+        // Depth the renderer didn't produce would make the runtime reproject the whole scene as if at the far plane.
+        .next = m_depthWritten ? &depthViews[i] : nullptr,
         .pose = m_locatedViews[i].pose,
         .fov = m_locatedViews[i].fov,
         .subImage = {.swapchain = m_colorSwapchain.swapchain, .imageRect = imageRect, .imageArrayIndex = 0}};